@@ -3,4 +3,4 @@ set -ex
 
 ccache -s || echo "CCache is not available."
 mkdir build && cd build
-cmake ..
+cmake -DBUILD_TESTS=ON ..
@@ -66,6 +66,8 @@ bool portable_mode = false;
 static bool multi = false;
 static bool log_verbose = false;
 static bool unfiltered_log = false;
+static bool buffered_profiler = false;
+static bool profiler_timeline = false;
 bool opt_start_streaming = false;
 bool opt_start_recording = false;
 bool opt_studio_mode = false;
@@ -939,7 +941,13 @@ static bool StartupOBS(const char *locale, profiler_name_store_t *store)
 	if (GetConfigPath(path, sizeof(path), "obs-studio/plugin_config") <= 0)
 		return false;
 
-	return obs_startup(locale, path, store);
+	if (!obs_startup(locale, path, store))
+		return false;
+
+	if (GetConfigPath(path, sizeof(path), "obs-studio/shader_cache") > 0)
+		obs_set_shader_cache_path(path);
+
+	return true;
 }
 
 bool OBSApp::OBSInit()
@@ -1323,6 +1331,7 @@ static void SaveProfilerData(const ProfilerSnapshot &snap)
 	ostringstream dst;
 	dst.write(LITERAL_SIZE("obs-studio/profiler_data/"));
 	dst.write(currentLogFile.c_str(), pos);
+	string base = dst.str();
 	dst.write(LITERAL_SIZE(".csv.gz"));
 #undef LITERAL_SIZE
 
@@ -1330,6 +1339,15 @@ static void SaveProfilerData(const ProfilerSnapshot &snap)
 	if (!profiler_snapshot_dump_csv_gz(snap.get(), path))
 		blog(LOG_WARNING, "Could not save profiler data to '%s'",
 				static_cast<const char*>(path));
+
+	if (!profiler_timeline)
+		return;
+
+	BPtr<char> trace_path = GetConfigPathPtr(
+			(base + ".trace.json").c_str());
+	if (!profiler_timeline_dump_json(trace_path))
+		blog(LOG_WARNING, "Could not save profiler timeline to '%s'",
+				static_cast<const char*>(trace_path));
 }
 
 static auto ProfilerFree = [](void *)
@@ -1338,6 +1356,11 @@ static auto ProfilerFree = [](void *)
 
 	auto snap = GetSnapshot();
 
+	if (buffered_profiler)
+		blog(LOG_INFO, "Profiler events dropped: %llu",
+				(unsigned long long)
+				profiler_buffered_dropped_events());
+
 	profiler_print(snap.get());
 	profiler_print_time_between_calls(snap.get());
 
@@ -1357,7 +1380,12 @@ static int run_program(fstream &logFile, int argc, char *argv[])
 		prof_release(static_cast<void*>(&ProfilerFree),
 				ProfilerFree);
 
-	profiler_start();
+	if (buffered_profiler)
+		profiler_start_buffered();
+	else
+		profiler_start();
+	if (profiler_timeline)
+		profiler_timeline_start();
 	profile_register_root(run_program_init, 0);
 
 	ScopeProfiler prof{run_program_init};
@@ -1914,6 +1942,19 @@ int main(int argc, char *argv[])
 		} else if (arg_is(argv[i], "--unfiltered_log", nullptr)) {
 			unfiltered_log = true;
 
+		} else if (arg_is(argv[i], "--profiler-buffered", nullptr)) {
+			buffered_profiler = true;
+
+		} else if (arg_is(argv[i], "--profiler-timeline", nullptr)) {
+			buffered_profiler = true;
+			profiler_timeline = true;
+
+		} else if (arg_is(argv[i], "--track-allocations", nullptr)) {
+			bmem_enable_tracking();
+
+		} else if (arg_is(argv[i], "--pool-allocator", nullptr)) {
+			bmem_enable_pool();
+
 		} else if (arg_is(argv[i], "--startstreaming", nullptr)) {
 			opt_start_streaming = true;
 
@@ -1958,6 +1999,14 @@ int main(int argc, char *argv[])
 			"--verbose: Make log more verbose.\n" <<
 			"--always-on-top: Start in 'always on top' mode.\n\n" <<
 			"--unfiltered_log: Make log unfiltered.\n\n" <<
+			"--profiler-buffered: Record profiler events in "
+				<< "per-thread buffers.\n" <<
+			"--profiler-timeline: Save a Chrome trace of profiler "
+				<< "events on exit.\n" <<
+			"--track-allocations: Log memory usage per allocation "
+				<< "site on exit.\n" <<
+			"--pool-allocator: Recycle small allocations through "
+				<< "per-thread size-class pools.\n\n" <<
 			"--allow-opengl: Allow OpenGL on Windows.\n\n" <<
 			"--version, -V: Get current version.\n";
 
@@ -1988,6 +2037,8 @@ int main(int argc, char *argv[])
 	int ret = run_program(logFile, argc, argv);
 
 	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	bmem_tracking_log_top_sites(LOG_INFO, 20);
+	bmem_pool_log_stats(LOG_INFO);
 	base_set_log_handler(nullptr, nullptr);
 	return ret;
 }
@@ -47,7 +47,6 @@ gs_vertex_shader::gs_vertex_shader(gs_device_t *device, const char *file,
 	  nTexUnits   (0)
 {
 	ShaderProcessor    processor(device);
-	ComPtr<ID3D10Blob> shaderBlob;
 	string             outputString;
 	HRESULT            hr;
 
@@ -58,10 +57,7 @@ gs_vertex_shader::gs_vertex_shader(gs_device_t *device, const char *file,
 	GetBuffersExpected(layoutData);
 	BuildConstantBuffer();
 
-	Compile(outputString.c_str(), file, "vs_4_0", shaderBlob.Assign());
-
-	data.resize(shaderBlob->GetBufferSize());
-	memcpy(&data[0], shaderBlob->GetBufferPointer(), data.size());
+	Compile(outputString.c_str(), file, "vs_4_0", data);
 
 	hr = device->device->CreateVertexShader(data.data(), data.size(),
 			NULL, shader.Assign());
@@ -83,7 +79,6 @@ gs_pixel_shader::gs_pixel_shader(gs_device_t *device, const char *file,
 	: gs_shader(device, gs_type::gs_pixel_shader, GS_SHADER_PIXEL)
 {
 	ShaderProcessor    processor(device);
-	ComPtr<ID3D10Blob> shaderBlob;
 	string             outputString;
 	HRESULT            hr;
 
@@ -93,10 +88,7 @@ gs_pixel_shader::gs_pixel_shader(gs_device_t *device, const char *file,
 	processor.BuildSamplers(samplers);
 	BuildConstantBuffer();
 
-	Compile(outputString.c_str(), file, "ps_4_0", shaderBlob.Assign());
-
-	data.resize(shaderBlob->GetBufferSize());
-	memcpy(&data[0], shaderBlob->GetBufferPointer(), data.size());
+	Compile(outputString.c_str(), file, "ps_4_0", data);
 
 	hr = device->device->CreatePixelShader(data.data(), data.size(),
 			NULL, shader.Assign());
@@ -185,19 +177,36 @@ void gs_shader::BuildConstantBuffer()
 		gs_shader_set_default(&params[i]);
 }
 
+/* the cache key includes the compile flags, so changing them invalidates
+ * previously cached shaders */
+#define SHADER_COMPILE_FLAGS D3D10_SHADER_OPTIMIZATION_LEVEL1
+
 void gs_shader::Compile(const char *shaderString, const char *file,
-		const char *target, ID3D10Blob **shader)
+		const char *target, vector<uint8_t> &data)
 {
+	ComPtr<ID3D10Blob> shader;
 	ComPtr<ID3D10Blob> errorsBlob;
+	uint8_t *cachedData;
+	size_t cachedSize;
+	char cacheTarget[64];
 	HRESULT hr;
 
 	if (!shaderString)
 		throw "No shader string specified";
 
+	snprintf(cacheTarget, sizeof(cacheTarget), "d3d11 %s %X", target,
+			(unsigned int)SHADER_COMPILE_FLAGS);
+
+	if (gs_shader_cache_load(shaderString, cacheTarget, &cachedData,
+				&cachedSize)) {
+		data.assign(cachedData, cachedData + cachedSize);
+		bfree(cachedData);
+		return;
+	}
+
 	hr = device->d3dCompile(shaderString, strlen(shaderString), file, NULL,
-			NULL, "main", target,
-			D3D10_SHADER_OPTIMIZATION_LEVEL1, 0,
-			shader, errorsBlob.Assign());
+			NULL, "main", target, SHADER_COMPILE_FLAGS, 0,
+			shader.Assign(), errorsBlob.Assign());
 	if (FAILED(hr)) {
 		if (errorsBlob != NULL && errorsBlob->GetBufferSize())
 			throw ShaderError(errorsBlob, hr);
@@ -205,14 +214,20 @@ void gs_shader::Compile(const char *shaderString, const char *file,
 			throw HRError("Failed to compile shader", hr);
 	}
 
+	data.resize(shader->GetBufferSize());
+	memcpy(&data[0], shader->GetBufferPointer(), data.size());
+
+	gs_shader_cache_store(shaderString, cacheTarget, data.data(),
+			data.size());
+
 #ifdef DISASSEMBLE_SHADERS
 	ComPtr<ID3D10Blob> asmBlob;
 
 	if (!device->d3dDisassemble)
 		return;
 
-	hr = device->d3dDisassemble((*shader)->GetBufferPointer(),
-			(*shader)->GetBufferSize(), 0, nullptr, &asmBlob);
+	hr = device->d3dDisassemble(shader->GetBufferPointer(),
+			shader->GetBufferSize(), 0, nullptr, &asmBlob);
 
 	if (SUCCEEDED(hr) && !!asmBlob && asmBlob->GetBufferSize()) {
 		blog(LOG_INFO, "=============================================");
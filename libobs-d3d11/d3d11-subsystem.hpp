@@ -494,7 +494,7 @@ struct gs_shader : gs_obj {
 
 	void BuildConstantBuffer();
 	void Compile(const char *shaderStr, const char *file,
-			const char *target, ID3D10Blob **shader);
+			const char *target, vector<uint8_t> &data);
 
 	inline gs_shader(gs_device_t *device, gs_type obj_type,
 			gs_shader_type type)
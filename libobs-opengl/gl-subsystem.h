@@ -440,6 +440,15 @@ struct gs_stage_surface {
 	GLuint               pack_buffer;
 };
 
+struct gs_upload_buffer {
+	gs_device_t          *device;
+
+	GLuint               buffer;
+	size_t               size;
+	uint8_t              *data;
+	GLsync               fence;
+};
+
 struct gs_zstencil_buffer {
 	gs_device_t          *device;
 	GLuint               buffer;
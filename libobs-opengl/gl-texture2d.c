@@ -226,6 +226,55 @@ failed:
 	blog(LOG_ERROR, "gs_texture_unmap (GL) failed");
 }
 
+bool device_texture_set_image_rect(gs_device_t *device, gs_texture_t *tex,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy,
+		const uint8_t *data, uint32_t linesize)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+	uint32_t bpp;
+
+	if (!is_texture_2d(tex, "device_texture_set_image_rect"))
+		return false;
+
+	bpp = gs_get_format_bpp(tex->format) / 8;
+	if (!bpp || linesize % bpp != 0 || linesize / bpp < cx ||
+	    x + cx > tex2d->width || y + cy > tex2d->height) {
+		blog(LOG_ERROR, "device_texture_set_image_rect (GL) failed:  "
+		                "Rectangle does not fit the texture");
+		return false;
+	}
+
+	if (!cx || !cy)
+		return true;
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0))
+		goto fail;
+	if (!gl_bind_texture(GL_TEXTURE_2D, tex->texture))
+		goto fail;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / bpp);
+
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, cx, cy,
+			tex->gl_format, tex->gl_type, data);
+	if (!gl_success("glTexSubImage2D"))
+		goto fail;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+
+	UNUSED_PARAMETER(device);
+	return true;
+
+fail:
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+	blog(LOG_ERROR, "device_texture_set_image_rect (GL) failed");
+	return false;
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d*)tex;
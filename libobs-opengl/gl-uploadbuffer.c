@@ -0,0 +1,177 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Project contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "gl-subsystem.h"
+
+/* async video filters may read the frame data, so the buffer is mapped
+ * readable and kept in client memory */
+static const GLbitfield map_flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT |
+	GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+bool device_upload_buffers_available(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+}
+
+static bool create_persistent_buffer(struct gs_upload_buffer *buf)
+{
+	bool success = true;
+
+	if (!gl_gen_buffers(1, &buf->buffer))
+		return false;
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, buf->buffer))
+		return false;
+
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, buf->size, NULL,
+			map_flags | GL_CLIENT_STORAGE_BIT);
+	if (!gl_success("glBufferStorage"))
+		success = false;
+
+	if (success) {
+		buf->data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+				buf->size, map_flags);
+		if (!gl_success("glMapBufferRange") || !buf->data)
+			success = false;
+	}
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0))
+		success = false;
+
+	return success;
+}
+
+gs_upload_buffer_t *device_upload_buffer_create(gs_device_t *device,
+		size_t size)
+{
+	struct gs_upload_buffer *buf;
+
+	if (!device_upload_buffers_available(device)) {
+		blog(LOG_ERROR, "device_upload_buffer_create (GL) failed: "
+		                "persistent buffer mapping not supported");
+		return NULL;
+	}
+
+	buf = bzalloc(sizeof(struct gs_upload_buffer));
+	buf->device = device;
+	buf->size   = size;
+
+	if (!create_persistent_buffer(buf)) {
+		blog(LOG_ERROR, "device_upload_buffer_create (GL) failed");
+		gs_upload_buffer_destroy(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+void gs_upload_buffer_destroy(gs_upload_buffer_t *buf)
+{
+	if (!buf)
+		return;
+
+	if (buf->fence)
+		glDeleteSync(buf->fence);
+
+	if (buf->buffer) {
+		if (buf->data && gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER,
+					buf->buffer)) {
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+
+		gl_delete_buffers(1, &buf->buffer);
+	}
+
+	bfree(buf);
+}
+
+uint8_t *gs_upload_buffer_get_data(gs_upload_buffer_t *buf)
+{
+	return buf->data;
+}
+
+bool gs_upload_buffer_busy(gs_upload_buffer_t *buf)
+{
+	GLenum result;
+
+	if (!buf->fence)
+		return false;
+
+	result = glClientWaitSync(buf->fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+		return true;
+
+	glDeleteSync(buf->fence);
+	buf->fence = NULL;
+	return false;
+}
+
+void device_texture_set_image_from_buffer(gs_device_t *device,
+		gs_texture_t *tex, gs_upload_buffer_t *buf, uint32_t linesize)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+	uint32_t bpp;
+
+	if (tex->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "device_texture_set_image_from_buffer (GL) "
+		                "failed:  Not a 2D texture");
+		return;
+	}
+
+	bpp = gs_get_format_bpp(tex->format) / 8;
+	if (!bpp || linesize % bpp != 0 ||
+	    (size_t)linesize * tex2d->height > buf->size) {
+		blog(LOG_ERROR, "device_texture_set_image_from_buffer (GL) "
+		                "failed:  Buffer does not match the texture");
+		return;
+	}
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, buf->buffer))
+		goto fail;
+	if (!gl_bind_texture(tex->gl_target, tex->texture))
+		goto fail;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / bpp);
+
+	glTexSubImage2D(tex->gl_target, 0, 0, 0, tex2d->width, tex2d->height,
+			tex->gl_format, tex->gl_type, 0);
+	if (!gl_success("glTexSubImage2D"))
+		goto fail;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (buf->fence)
+		glDeleteSync(buf->fence);
+	buf->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	gl_bind_texture(tex->gl_target, 0);
+
+	UNUSED_PARAMETER(device);
+	return;
+
+fail:
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	gl_bind_texture(tex->gl_target, 0);
+	blog(LOG_ERROR, "device_texture_set_image_from_buffer (GL) failed");
+}
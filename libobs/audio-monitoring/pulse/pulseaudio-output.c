@@ -1,9 +1,18 @@
+#include <emmintrin.h>
+
 #include "obs-internal.h"
 #include "pulseaudio-wrapper.h"
 
 #define PULSE_DATA(voidptr) struct audio_monitor *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-am: " msg, ##__VA_ARGS__)
 
+/* stream latency used when no target latency is set */
+#define DEFAULT_LATENCY_US 25000
+
+/* audio waiting to be written to the stream is limited to this much when no
+ * target latency is set, and to twice the target latency otherwise */
+#define DEFAULT_MAX_BUFFERED_US 1000000
+
 struct audio_monitor {
 	obs_source_t 		*source;
 	pa_stream    		*stream;
@@ -17,12 +26,18 @@ struct audio_monitor {
 
 	uint_fast32_t 		packets;
 	uint_fast64_t 		frames;
+	uint_fast64_t 		written_frames;
+	uint_fast64_t 		dropped_frames;
+	uint_fast32_t 		underruns;
 
+	/* filled from the audio thread, and written to the stream whenever
+	 * the server has requested data */
 	struct circlebuf  	new_data;
+	size_t            	max_buffered;
 	audio_resampler_t 	*resampler;
-	size_t            	buffer_size;
 	size_t            	bytesRemaining;
 	size_t          	bytes_per_channel;
+	uint32_t          	target_latency_ms;
 
 	bool 			ignore;
 	pthread_mutex_t 	playback_mutex;
@@ -127,20 +142,38 @@ static void process_byte(void *p, size_t frames, size_t channels, float vol)
 
 static void process_short(void *p, size_t frames, size_t channels, float vol)
 {
-	register short *cur = (short *) p;
-	register short *end = cur + frames * channels;
+	short *cur = (short *) p;
+	size_t count = frames * channels;
+	const __m128 vol4 = _mm_set1_ps(vol);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i s  = _mm_loadu_si128((__m128i *) (cur + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+
+		lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), vol4));
+		hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), vol4));
+		_mm_storeu_si128((__m128i *) (cur + i),
+				_mm_packs_epi32(lo, hi));
+	}
 
-	while (cur < end)
-		*(cur++) *= vol;
+	for (; i < count; i++)
+		cur[i] *= vol;
 }
 
 static void process_float(void *p, size_t frames, size_t channels, float vol)
 {
-	register float *cur = (float *) p;
-	register float *end = cur + frames * channels;
+	float *cur = (float *) p;
+	size_t count = frames * channels;
+	const __m128 vol4 = _mm_set1_ps(vol);
+	size_t i = 0;
 
-	while (cur < end)
-		*(cur++) *= vol;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(cur + i, _mm_mul_ps(_mm_loadu_ps(cur + i), vol4));
+
+	for (; i < count; i++)
+		cur[i] *= vol;
 }
 
 void process_volume(const struct audio_monitor *monitor, float vol,
@@ -162,38 +195,57 @@ void process_volume(const struct audio_monitor *monitor, float vol,
 	}
 }
 
-static void do_stream_write(void *param)
+/* must be called with the mainloop lock and playback mutex held */
+static void write_to_stream(struct audio_monitor *monitor)
 {
-	PULSE_DATA(param);
-	uint8_t *buffer = NULL;
-
-	while (data->new_data.size >= data->buffer_size &&
-			data->bytesRemaining > 0) {
-		size_t bytesToFill = data->buffer_size;
+	while (monitor->bytesRemaining > 0 && monitor->new_data.size > 0) {
+		size_t bytes = monitor->bytesRemaining;
+		uint8_t *buffer = NULL;
 
-		if (bytesToFill > data->bytesRemaining)
-			bytesToFill = data->bytesRemaining;
+		if (bytes > monitor->new_data.size)
+			bytes = monitor->new_data.size;
 
-		pa_stream_begin_write(data->stream, (void **) &buffer,
-				&bytesToFill);
+		if (pa_stream_begin_write(monitor->stream, (void **) &buffer,
+					&bytes) < 0 || !buffer || !bytes)
+			break;
 
-		circlebuf_pop_front(&data->new_data, buffer, bytesToFill);
+		if (bytes > monitor->new_data.size)
+			bytes = monitor->new_data.size;
 
-		pulseaudio_lock();
-		pa_stream_write(data->stream, buffer, bytesToFill, NULL,
+		circlebuf_pop_front(&monitor->new_data, buffer, bytes);
+		pa_stream_write(monitor->stream, buffer, bytes, NULL,
 				0LL, PA_SEEK_RELATIVE);
-		pulseaudio_unlock();
+		monitor->written_frames += bytes / monitor->bytes_per_frame;
 
-		data->bytesRemaining -= bytesToFill;
+		monitor->bytesRemaining -= bytes < monitor->bytesRemaining ?
+			bytes : monitor->bytesRemaining;
 	}
 }
 
+/* keeps the audio waiting to be written within max_buffered by dropping the
+ * oldest audio, so a stalled stream can't build up latency */
+static void limit_buffered(struct audio_monitor *monitor)
+{
+	size_t excess;
+
+	if (monitor->new_data.size <= monitor->max_buffered)
+		return;
+
+	excess = monitor->new_data.size - monitor->max_buffered;
+	excess += monitor->bytes_per_frame - 1;
+	excess -= excess % monitor->bytes_per_frame;
+
+	circlebuf_pop_front(&monitor->new_data, NULL, excess);
+	monitor->dropped_frames += excess / monitor->bytes_per_frame;
+}
+
 static void on_audio_playback(void *param, obs_source_t *source,
 		const struct audio_data *audio_data, bool muted)
 {
 	struct audio_monitor *monitor = param;
 	float vol = source->user_volume;
 	size_t bytes;
+	bool write;
 
 	uint8_t *resample_data[MAX_AV_PLANES];
 	uint32_t resample_frames;
@@ -226,14 +278,27 @@ static void on_audio_playback(void *param, obs_source_t *source,
 	}
 
 	circlebuf_push_back(&monitor->new_data, resample_data[0], bytes);
+	limit_buffered(monitor);
 	monitor->packets++;
 	monitor->frames += resample_frames;
 
 unlock:
+	write = monitor->bytesRemaining > 0 && monitor->new_data.size > 0;
 	pthread_mutex_unlock(&monitor->playback_mutex);
-	do_stream_write(param);
+
+	/* the server has already asked for more data than was available, so
+	 * write it now rather than waiting for the next request */
+	if (write) {
+		pulseaudio_lock();
+		pthread_mutex_lock(&monitor->playback_mutex);
+		if (monitor->stream)
+			write_to_stream(monitor);
+		pthread_mutex_unlock(&monitor->playback_mutex);
+		pulseaudio_unlock();
+	}
 }
 
+/* called from the mainloop thread, with the mainloop lock held */
 static void pulseaudio_stream_write(pa_stream *p, size_t nbytes, void *userdata)
 {
 	UNUSED_PARAMETER(p);
@@ -241,6 +306,7 @@ static void pulseaudio_stream_write(pa_stream *p, size_t nbytes, void *userdata)
 
 	pthread_mutex_lock(&data->playback_mutex);
 	data->bytesRemaining += nbytes;
+	write_to_stream(data);
 	pthread_mutex_unlock(&data->playback_mutex);
 
 	pulseaudio_signal(0);
@@ -252,10 +318,17 @@ static void pulseaudio_underflow(pa_stream *p, void *userdata)
 	PULSE_DATA(userdata);
 
 	pthread_mutex_lock(&data->playback_mutex);
-	if (obs_source_active(data->source))
-		data->attr.tlength = (data->attr.tlength * 3) / 2;
+	data->underruns++;
+
+	/* with an explicit target latency the buffer size is left alone, the
+	 * underruns are reported instead */
+	if (!data->target_latency_ms) {
+		if (obs_source_active(data->source))
+			data->attr.tlength = (data->attr.tlength * 3) / 2;
 
-	pa_stream_set_buffer_attr(data->stream, &data->attr, NULL, NULL);
+		pa_stream_set_buffer_attr(data->stream, &data->attr,
+				NULL, NULL);
+	}
 	pthread_mutex_unlock(&data->playback_mutex);
 
 	pulseaudio_signal(0);
@@ -322,17 +395,24 @@ skip:
 static void pulseaudio_stop_playback(struct audio_monitor *monitor)
 {
 	if (monitor->stream) {
+		pulseaudio_lock();
 		pa_stream_disconnect(monitor->stream);
 		pa_stream_unref(monitor->stream);
 		monitor->stream = NULL;
+		pulseaudio_unlock();
 	}
 
 	blog(LOG_INFO, "Stopped Monitoring in '%s'", monitor->device);
 	blog(LOG_INFO, "Got %"PRIuFAST32" packets with %"PRIuFAST64" frames",
 			monitor->packets, monitor->frames);
+	blog(LOG_INFO, "%"PRIuFAST32" underruns, %"PRIuFAST64" frames dropped",
+			monitor->underruns, monitor->dropped_frames);
 
 	monitor->packets = 0;
 	monitor->frames = 0;
+	monitor->written_frames = 0;
+	monitor->underruns = 0;
+	monitor->dropped_frames = 0;
 }
 
 static bool audio_monitor_init(struct audio_monitor *monitor,
@@ -434,17 +514,39 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 		return false;
 	}
 
+	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
+			PA_STREAM_AUTO_TIMING_UPDATE;
+
+	monitor->target_latency_ms = obs->audio.monitoring_latency_ms;
 	monitor->attr.fragsize = (uint32_t) -1;
 	monitor->attr.maxlength = (uint32_t) -1;
-	monitor->attr.minreq = (uint32_t) -1;
-	monitor->attr.prebuf = (uint32_t) -1;
-	monitor->attr.tlength = pa_usec_to_bytes(25000, &spec);
 
-	monitor->buffer_size = monitor->bytes_per_frame *
-			pa_usec_to_bytes(5000, &spec);
+	if (monitor->target_latency_ms) {
+		pa_usec_t target = monitor->target_latency_ms * PA_USEC_PER_MSEC;
+
+		/* request in quarters of the target, and start playing once
+		 * half of it is buffered */
+		monitor->attr.tlength = (uint32_t) pa_usec_to_bytes(target, &spec);
+		monitor->attr.minreq = (uint32_t) pa_usec_to_bytes(target / 4,
+				&spec);
+		monitor->attr.prebuf = (uint32_t) pa_usec_to_bytes(target / 2,
+				&spec);
+		monitor->max_buffered = 2 * monitor->attr.tlength;
+		flags |= PA_STREAM_ADJUST_LATENCY;
+
+		blog(LOG_INFO, "Target latency: %"PRIu32" ms",
+				monitor->target_latency_ms);
+	} else {
+		monitor->attr.minreq = (uint32_t) -1;
+		monitor->attr.prebuf = (uint32_t) -1;
+		monitor->attr.tlength = (uint32_t) pa_usec_to_bytes(
+				DEFAULT_LATENCY_US, &spec);
+		monitor->max_buffered = pa_usec_to_bytes(
+				DEFAULT_MAX_BUFFERED_US, &spec);
+	}
 
-	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
-			PA_STREAM_AUTO_TIMING_UPDATE;
+	circlebuf_reserve(&monitor->new_data, monitor->max_buffered +
+			pa_usec_to_bytes(DEFAULT_LATENCY_US, &spec));
 
 	if (pthread_mutex_init(&monitor->playback_mutex, NULL) != 0) {
 		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
@@ -498,6 +600,46 @@ static inline void audio_monitor_free(struct audio_monitor *monitor)
 	bfree(monitor->device);
 }
 
+/* both values come from the stream's timing info: the stream time is the
+ * position of the audio currently coming out of the sink, so everything
+ * written after that position, plus what is still waiting to be written,
+ * plays before audio that arrives now */
+bool audio_monitor_get_stats(struct audio_monitor *monitor,
+		struct obs_audio_monitoring_stats *stats)
+{
+	pa_usec_t stream_time = 0;
+	uint64_t played;
+	uint64_t queued;
+
+	if (!monitor || monitor->ignore || !monitor->stream)
+		return false;
+
+	pulseaudio_lock();
+	pthread_mutex_lock(&monitor->playback_mutex);
+
+	if (pa_stream_get_time(monitor->stream, &stream_time) < 0)
+		stream_time = 0;
+
+	/* silence played during underruns isn't audio that was written */
+	played = (uint64_t)stream_time * monitor->samples_per_sec / 1000000;
+	if (played > monitor->written_frames)
+		played = monitor->written_frames;
+
+	queued = monitor->written_frames - played +
+		monitor->new_data.size / monitor->bytes_per_frame;
+
+	stats->frames = played;
+	stats->dropped_frames = monitor->dropped_frames;
+	stats->underruns = monitor->underruns;
+
+	pthread_mutex_unlock(&monitor->playback_mutex);
+	pulseaudio_unlock();
+
+	stats->latency_ns = audio_frames_to_ns(monitor->samples_per_sec,
+			queued);
+	return true;
+}
+
 struct audio_monitor *audio_monitor_create(obs_source_t *source)
 {
 	struct audio_monitor monitor = {0};
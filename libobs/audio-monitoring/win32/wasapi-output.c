@@ -438,3 +438,11 @@ void audio_monitor_destroy(struct audio_monitor *monitor)
 		bfree(monitor);
 	}
 }
+
+bool audio_monitor_get_stats(struct audio_monitor *monitor,
+		struct obs_audio_monitoring_stats *stats)
+{
+	UNUSED_PARAMETER(monitor);
+	UNUSED_PARAMETER(stats);
+	return false;
+}
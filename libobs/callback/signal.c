@@ -20,39 +20,417 @@
 #include "decl.h"
 #include "signal.h"
 
+/*
+ * Callbacks are stored in immutable, reference counted lists.  Emitters only
+ * take a list reference (a very short critical section) and then invoke the
+ * callbacks without holding any lock, so a slow callback can never block
+ * another thread emitting the same signal.  Connecting or disconnecting
+ * publishes a new copy of the list; old lists are freed when their last
+ * emitter releases them.
+ *
+ * Each emit registers a frame with the callback set, recording which callback
+ * it is currently running, so that disconnecting can wait for other threads
+ * that are still running the callback being removed.
+ */
+
 struct signal_callback {
-	signal_callback_t callback;
-	void              *data;
-	bool              remove;
+	union {
+		signal_callback_t        callback;
+		global_signal_callback_t global_callback;
+	};
+	void                             *data;
+	volatile bool                    remove;
+};
+
+struct callback_list {
+	volatile long                    refs;
+	size_t                           num;
+	struct signal_callback           *array;
+
+	struct callback_list             *next;
+	struct callback_list             **prev_next;
+};
+
+struct callback_set {
+	struct signal_handler            *handler;
+	pthread_mutex_t                  mutex;
+	struct callback_list             *cur;
+	struct callback_list             *live;
+	struct signal_frame              *frames;
 };
 
 struct signal_info {
-	struct decl_info               func;
-	DARRAY(struct signal_callback) callbacks;
-	pthread_mutex_t                mutex;
-	bool                           signalling;
+	struct decl_info                 func;
+	struct callback_set              callbacks;
+
+	struct signal_info               *next;
+};
+
+struct signal_handler {
+	struct signal_info               *first;
+	pthread_mutex_t                  mutex;
 
-	struct signal_info             *next;
+	struct callback_set              global_callbacks;
 };
 
-static inline struct signal_info *signal_info_create(struct decl_info *info)
+struct signal_thread;
+
+/* a callback list being dispatched.  frames form a stack per thread, and are
+ * registered with their callback set while the list is dispatched */
+struct signal_frame {
+	struct callback_set              *set;
+	struct callback_list             *list;
+	struct signal_thread             *thread;
+
+	/* callback being run, only changed with the set mutex held */
+	struct signal_callback           *cur;
+	bool                             remove_cur;
+
+	struct signal_frame              *prev;
+
+	struct signal_frame              *next;
+	struct signal_frame              **prev_next;
+};
+
+struct signal_thread {
+	struct signal_frame              *top;
+
+	/* thread this one is blocked on in a disconnect, only accessed with
+	 * wait_mutex held */
+	struct signal_thread             *waiting_for;
+	struct signal_thread             *next_waiting;
+};
+
+static THREAD_LOCAL struct signal_thread thread_state = {0};
+
+/* threads blocked in a disconnect until another thread leaves a callback */
+static pthread_mutex_t wait_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wait_cond = PTHREAD_COND_INITIALIZER;
+static struct signal_thread *waiting_threads = NULL;
+static volatile long waiters = 0;
+
+/* ------------------------------------------------------------------------- */
+
+static bool callback_set_init(struct callback_set *set,
+		struct signal_handler *handler)
 {
-	pthread_mutexattr_t attr;
-	struct signal_info *si;
+	set->handler = handler;
+	set->cur     = NULL;
+	set->live    = NULL;
+	set->frames  = NULL;
+	return pthread_mutex_init(&set->mutex, NULL) == 0;
+}
 
-	if (pthread_mutexattr_init(&attr) != 0)
-		return NULL;
-	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
-		return NULL;
+static void callback_set_free(struct callback_set *set)
+{
+	struct callback_list *list = set->live;
+	while (list) {
+		struct callback_list *next = list->next;
+		bfree(list);
+		list = next;
+	}
+
+	pthread_mutex_destroy(&set->mutex);
+}
+
+static struct callback_list *callback_list_create(struct callback_set *set,
+		size_t num)
+{
+	struct callback_list *list = bzalloc(sizeof(struct callback_list) +
+			sizeof(struct signal_callback) * num);
+
+	list->refs  = 1;
+	list->num   = num;
+	list->array = (struct signal_callback*)(list + 1);
+
+	list->next      = set->live;
+	list->prev_next = &set->live;
+	if (set->live)
+		set->live->prev_next = &list->next;
+	set->live = list;
+
+	return list;
+}
+
+static inline void callback_list_destroy(struct callback_list *list)
+{
+	*list->prev_next = list->next;
+	if (list->next)
+		list->next->prev_next = list->prev_next;
+	bfree(list);
+}
+
+static inline size_t callback_list_find(struct callback_list *list,
+		void *callback, void *data)
+{
+	if (!list)
+		return DARRAY_INVALID;
+
+	for (size_t i = 0; i < list->num; i++) {
+		struct signal_callback *sc = list->array+i;
+
+		if ((void*)sc->callback == callback && sc->data == data)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
+/* takes a reference to the current list and registers the frame that
+ * dispatches it; returns false if there are no callbacks */
+static inline bool callback_set_acquire(struct callback_set *set,
+		struct signal_frame *frame)
+{
+	struct callback_list *list;
+
+	pthread_mutex_lock(&set->mutex);
+
+	list = set->cur;
+	if (list) {
+		os_atomic_inc_long(&list->refs);
+
+		frame->set        = set;
+		frame->list       = list;
+		frame->thread     = &thread_state;
+		frame->cur        = NULL;
+		frame->remove_cur = false;
+
+		frame->next      = set->frames;
+		frame->prev_next = &set->frames;
+		if (set->frames)
+			set->frames->prev_next = &frame->next;
+		set->frames = frame;
+	}
+
+	pthread_mutex_unlock(&set->mutex);
+
+	return list != NULL;
+}
+
+static inline void callback_set_release(struct callback_set *set,
+		struct signal_frame *frame)
+{
+	struct callback_list *list = frame->list;
+
+	pthread_mutex_lock(&set->mutex);
+
+	*frame->prev_next = frame->next;
+	if (frame->next)
+		frame->next->prev_next = frame->prev_next;
+
+	if (os_atomic_dec_long(&list->refs) == 0)
+		callback_list_destroy(list);
+
+	pthread_mutex_unlock(&set->mutex);
+}
+
+/* must be called with the set mutex held */
+static inline void callback_set_publish(struct callback_set *set,
+		struct callback_list *list)
+{
+	struct callback_list *old = set->cur;
+
+	set->cur = list;
+	if (old && os_atomic_dec_long(&old->refs) == 0)
+		callback_list_destroy(old);
+}
+
+static void callback_set_add(struct callback_set *set, void *callback,
+		void *data)
+{
+	struct callback_list *old;
+	struct callback_list *list;
+	size_t num;
+
+	pthread_mutex_lock(&set->mutex);
+
+	old = set->cur;
+	if (callback_list_find(old, callback, data) == DARRAY_INVALID) {
+		num  = old ? old->num : 0;
+		list = callback_list_create(set, num + 1);
+
+		for (size_t i = 0; i < num; i++) {
+			list->array[i].callback = old->array[i].callback;
+			list->array[i].data     = old->array[i].data;
+		}
+
+		list->array[num].callback = (signal_callback_t)callback;
+		list->array[num].data     = data;
+
+		callback_set_publish(set, list);
+	}
+
+	pthread_mutex_unlock(&set->mutex);
+}
+
+static inline bool callback_matches(struct signal_callback *cb,
+		void *callback, void *data)
+{
+	return cb && (void*)cb->callback == callback && cb->data == data;
+}
+
+/* whether thread waits on target, directly or through other waiting threads;
+ * must be called with wait_mutex held */
+static inline bool thread_waits_on(struct signal_thread *thread,
+		struct signal_thread *target)
+{
+	while (thread) {
+		if (thread == target)
+			return true;
+		thread = thread->waiting_for;
+	}
+
+	return false;
+}
+
+/* wakes threads waiting in a disconnect after this thread left a callback */
+static void wake_waiters(void)
+{
+	struct signal_thread *thread;
+
+	if (!os_atomic_load_long(&waiters))
+		return;
+
+	pthread_mutex_lock(&wait_mutex);
+
+	/* this thread may exit once it returns, so it must not stay in any
+	 * chain of waiting threads */
+	for (thread = waiting_threads; thread; thread = thread->next_waiting) {
+		if (thread->waiting_for == &thread_state)
+			thread->waiting_for = NULL;
+	}
+
+	pthread_cond_broadcast(&wait_cond);
+	pthread_mutex_unlock(&wait_mutex);
+}
+
+/* finds another thread running the callback that this thread can wait for,
+ * i.e. one that isn't itself waiting on this thread; must be called with the
+ * set mutex and wait_mutex held */
+static struct signal_thread *find_running_thread(struct callback_set *set,
+		void *callback, void *data)
+{
+	struct signal_frame *frame;
+
+	for (frame = set->frames; frame; frame = frame->next) {
+		if (frame->thread != &thread_state &&
+		    callback_matches(frame->cur, callback, data) &&
+		    !thread_waits_on(frame->thread, &thread_state))
+			return frame->thread;
+	}
+
+	return NULL;
+}
+
+/* blocks until no other thread is running the callback; must be called with
+ * the set mutex held */
+static void callback_set_wait(struct callback_set *set, void *callback,
+		void *data)
+{
+	struct signal_thread *self = &thread_state;
+	struct signal_thread *target;
+
+	/* threads leaving a callback check this after releasing the set
+	 * mutex, so it must be raised while that is still held */
+	os_atomic_inc_long(&waiters);
+
+	for (;;) {
+		pthread_mutex_lock(&wait_mutex);
+
+		target = find_running_thread(set, callback, data);
+		if (!target) {
+			pthread_mutex_unlock(&wait_mutex);
+			break;
+		}
+
+		self->waiting_for  = target;
+		self->next_waiting = waiting_threads;
+		waiting_threads    = self;
+
+		pthread_mutex_unlock(&set->mutex);
+
+		while (self->waiting_for)
+			pthread_cond_wait(&wait_cond, &wait_mutex);
+
+		for (struct signal_thread **p = &waiting_threads; *p;
+				p = &(*p)->next_waiting) {
+			if (*p == self) {
+				*p = self->next_waiting;
+				break;
+			}
+		}
+
+		pthread_mutex_unlock(&wait_mutex);
+		pthread_mutex_lock(&set->mutex);
+	}
+
+	os_atomic_dec_long(&waiters);
+}
+
+static void callback_set_remove(struct callback_set *set, void *callback,
+		void *data, bool wait)
+{
+	struct callback_list *old;
+	struct callback_list *list = NULL;
+	size_t idx;
+
+	pthread_mutex_lock(&set->mutex);
+
+	old = set->cur;
+	idx = callback_list_find(old, callback, data);
+	if (idx == DARRAY_INVALID) {
+		pthread_mutex_unlock(&set->mutex);
+		return;
+	}
+
+	/* stop emitters that are already walking an older list */
+	for (list = set->live; list; list = list->next) {
+		size_t i = callback_list_find(list, callback, data);
+		if (i != DARRAY_INVALID)
+			list->array[i].remove = true;
+	}
+
+	list = NULL;
+	if (old->num > 1) {
+		size_t num = 0;
+
+		list = callback_list_create(set, old->num - 1);
+		for (size_t i = 0; i < old->num; i++) {
+			if (i == idx)
+				continue;
+
+			list->array[num].callback = old->array[i].callback;
+			list->array[num].data     = old->array[i].data;
+			list->array[num].remove   = old->array[i].remove;
+			num++;
+		}
+	}
+
+	callback_set_publish(set, list);
+
+	/* once disconnected, the callback must not be running on any other
+	 * thread, because the caller is typically about to free its data.
+	 * the only exceptions are this thread's own emits, and threads that
+	 * are themselves waiting on this one, which would never return */
+	if (wait)
+		callback_set_wait(set, callback, data);
+
+	pthread_mutex_unlock(&set->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline struct signal_info *signal_info_create(struct decl_info *info,
+		struct signal_handler *handler)
+{
+	struct signal_info *si;
 
 	si = bmalloc(sizeof(struct signal_info));
 
 	si->func       = *info;
 	si->next       = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
 
-	if (pthread_mutex_init(&si->mutex, &attr) != 0) {
+	if (!callback_set_init(&si->callbacks, handler)) {
 		blog(LOG_ERROR, "Could not create signal");
 
 		decl_info_free(&si->func);
@@ -66,41 +444,12 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 static inline void signal_info_destroy(struct signal_info *si)
 {
 	if (si) {
-		pthread_mutex_destroy(&si->mutex);
+		callback_set_free(&si->callbacks);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
 		bfree(si);
 	}
 }
 
-static inline size_t signal_get_callback_idx(struct signal_info *si,
-		signal_callback_t callback, void *data)
-{
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array+i;
-
-		if (sc->callback == callback && sc->data == data)
-			return i;
-	}
-
-	return DARRAY_INVALID;
-}
-
-struct global_callback_info {
-	global_signal_callback_t callback;
-	void                     *data;
-	long                     signaling;
-	bool                     remove;
-};
-
-struct signal_handler {
-	struct signal_info *first;
-	pthread_mutex_t    mutex;
-
-	DARRAY(struct global_callback_info) global_callbacks;
-	pthread_mutex_t                     global_callbacks_mutex;
-};
-
 static struct signal_info *getsignal(signal_handler_t *handler,
 		const char *name, struct signal_info **p_last)
 {
@@ -127,18 +476,12 @@ signal_handler_t *signal_handler_create(void)
 	struct signal_handler *handler = bzalloc(sizeof(struct signal_handler));
 	handler->first = NULL;
 
-	pthread_mutexattr_t attr;
-	if (pthread_mutexattr_init(&attr) != 0)
-		return NULL;
-	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
-		return NULL;
-
 	if (pthread_mutex_init(&handler->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Couldn't create signal handler mutex!");
 		bfree(handler);
 		return NULL;
 	}
-	if (pthread_mutex_init(&handler->global_callbacks_mutex, &attr) != 0) {
+	if (!callback_set_init(&handler->global_callbacks, handler)) {
 		blog(LOG_ERROR, "Couldn't create signal handler global "
 				"callbacks mutex!");
 		pthread_mutex_destroy(&handler->mutex);
@@ -159,8 +502,7 @@ void signal_handler_destroy(signal_handler_t *handler)
 			sig = next;
 		}
 
-		da_free(handler->global_callbacks);
-		pthread_mutex_destroy(&handler->global_callbacks_mutex);
+		callback_set_free(&handler->global_callbacks);
 		pthread_mutex_destroy(&handler->mutex);
 		bfree(handler);
 	}
@@ -185,7 +527,7 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 		decl_info_free(&func);
 		success = false;
 	} else {
-		sig = signal_info_create(&func);
+		sig = signal_info_create(&func, handler);
 		if (!last)
 			handler->first = sig;
 		else
@@ -201,8 +543,6 @@ void signal_handler_connect(signal_handler_t *handler, const char *signal,
 		signal_callback_t callback, void *data)
 {
 	struct signal_info *sig, *last;
-	struct signal_callback cb_data = {callback, data, false};
-	size_t idx;
 
 	if (!handler)
 		return;
@@ -219,13 +559,7 @@ void signal_handler_connect(signal_handler_t *handler, const char *signal,
 
 	/* -------------- */
 
-	pthread_mutex_lock(&sig->mutex);
-
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
-
-	pthread_mutex_unlock(&sig->mutex);
+	callback_set_add(&sig->callbacks, (void*)callback, data);
 }
 
 static inline struct signal_info *getsignal_locked(signal_handler_t *handler,
@@ -247,131 +581,125 @@ void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 		signal_callback_t callback, void *data)
 {
 	struct signal_info *sig = getsignal_locked(handler, signal);
-	size_t idx;
 
 	if (!sig)
 		return;
 
-	pthread_mutex_lock(&sig->mutex);
+	callback_set_remove(&sig->callbacks, (void*)callback, data, true);
+}
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx != DARRAY_INVALID) {
-		if (sig->signalling)
-			sig->callbacks.array[idx].remove = true;
-		else
-			da_erase(sig->callbacks, idx);
+void signal_handler_remove_current(void)
+{
+	struct signal_frame *frame = thread_state.top;
+
+	if (frame && frame->cur) {
+		pthread_mutex_lock(&frame->set->mutex);
+		frame->cur->remove = true;
+		pthread_mutex_unlock(&frame->set->mutex);
+
+		frame->remove_cur = true;
 	}
+}
 
-	pthread_mutex_unlock(&sig->mutex);
+static inline void push_frame(struct signal_frame *frame)
+{
+	frame->prev      = thread_state.top;
+	thread_state.top = frame;
 }
 
-static THREAD_LOCAL struct signal_callback *current_signal_cb = NULL;
-static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
+static inline void pop_frame(struct signal_frame *frame)
+{
+	thread_state.top = frame->prev;
+}
 
-void signal_handler_remove_current(void)
+static inline bool start_callback(struct signal_frame *frame,
+		struct signal_callback *cb)
 {
-	if (current_signal_cb)
-		current_signal_cb->remove = true;
-	else if (current_global_cb)
-		current_global_cb->remove = true;
+	struct callback_set *set = frame->set;
+	bool removed;
+
+	pthread_mutex_lock(&set->mutex);
+	removed = cb->remove;
+	if (!removed)
+		frame->cur = cb;
+	pthread_mutex_unlock(&set->mutex);
+
+	return !removed;
+}
+
+static inline void finish_callback(struct signal_frame *frame)
+{
+	struct callback_set *set = frame->set;
+	struct signal_callback *cb = frame->cur;
+
+	pthread_mutex_lock(&set->mutex);
+	frame->cur = NULL;
+	pthread_mutex_unlock(&set->mutex);
+
+	wake_waiters();
+
+	if (frame->remove_cur) {
+		frame->remove_cur = false;
+		callback_set_remove(frame->set, (void*)cb->callback, cb->data,
+				false);
+	}
 }
 
 void signal_handler_signal(signal_handler_t *handler, const char *signal,
 		calldata_t *params)
 {
 	struct signal_info *sig = getsignal_locked(handler, signal);
+	struct signal_frame frame;
 
 	if (!sig)
 		return;
 
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
+	if (callback_set_acquire(&sig->callbacks, &frame)) {
+		push_frame(&frame);
 
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array+i;
-		if (!cb->remove) {
-			current_signal_cb = cb;
-			cb->callback(cb->data, params);
-			current_signal_cb = NULL;
+		for (size_t i = 0; i < frame.list->num; i++) {
+			struct signal_callback *cb = frame.list->array+i;
+			if (start_callback(&frame, cb)) {
+				cb->callback(cb->data, params);
+				finish_callback(&frame);
+			}
 		}
-	}
 
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array+i-1;
-		if (cb->remove)
-			da_erase(sig->callbacks, i-1);
+		pop_frame(&frame);
+		callback_set_release(&sig->callbacks, &frame);
 	}
 
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
+	if (callback_set_acquire(&handler->global_callbacks, &frame)) {
+		push_frame(&frame);
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
-
-	if (handler->global_callbacks.num) {
-		for (size_t i = 0; i < handler->global_callbacks.num; i++) {
-			struct global_callback_info *cb =
-				handler->global_callbacks.array + i;
-
-			if (!cb->remove) {
-				cb->signaling++;
-				current_global_cb = cb;
-				cb->callback(cb->data, signal, params);
-				current_global_cb = NULL;
-				cb->signaling--;
+		for (size_t i = 0; i < frame.list->num; i++) {
+			struct signal_callback *cb = frame.list->array+i;
+			if (start_callback(&frame, cb)) {
+				cb->global_callback(cb->data, signal, params);
+				finish_callback(&frame);
 			}
 		}
 
-		for (size_t i = handler->global_callbacks.num; i > 0; i--) {
-			struct global_callback_info *cb =
-				handler->global_callbacks.array + (i - 1);
-
-			if (cb->remove && !cb->signaling)
-				da_erase(handler->global_callbacks, i - 1);
-		}	
+		pop_frame(&frame);
+		callback_set_release(&handler->global_callbacks, &frame);
 	}
-
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
 
 void signal_handler_connect_global(signal_handler_t *handler,
 		global_signal_callback_t callback, void *data)
 {
-	struct global_callback_info cb_data = {callback, data, 0, false};
-	size_t idx;
-
 	if (!handler || !callback)
 		return;
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
-
-	idx = da_find(handler->global_callbacks, &cb_data, 0);
-	if (idx == DARRAY_INVALID)
-		da_push_back(handler->global_callbacks, &cb_data);
-
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	callback_set_add(&handler->global_callbacks, (void*)callback, data);
 }
 
 void signal_handler_disconnect_global(signal_handler_t *handler,
 		global_signal_callback_t callback, void *data)
 {
-	struct global_callback_info cb_data = {callback, data, false};
-	size_t idx;
-
 	if (!handler || !callback)
 		return;
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
-
-	idx = da_find(handler->global_callbacks, &cb_data, 0);
-	if (idx != DARRAY_INVALID) {
-		struct global_callback_info *cb =
-			handler->global_callbacks.array + idx;
-
-		if (cb->signaling)
-			cb->remove = true;
-		else
-			da_erase(handler->global_callbacks, idx);
-	}
-
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	callback_set_remove(&handler->global_callbacks, (void*)callback, data,
+			true);
 }
@@ -55,6 +55,15 @@ EXPORT gs_zstencil_t *device_zstencil_create(gs_device_t *device,
 EXPORT gs_stagesurf_t *device_stagesurface_create(gs_device_t *device,
 		uint32_t width, uint32_t height,
 		enum gs_color_format color_format);
+EXPORT bool device_upload_buffers_available(gs_device_t *device);
+EXPORT gs_upload_buffer_t *device_upload_buffer_create(gs_device_t *device,
+		size_t size);
+EXPORT void device_texture_set_image_from_buffer(gs_device_t *device,
+		gs_texture_t *tex, gs_upload_buffer_t *buf, uint32_t linesize);
+EXPORT bool device_texture_set_image_rect(gs_device_t *device,
+		gs_texture_t *tex, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy, const uint8_t *data,
+		uint32_t linesize);
 EXPORT gs_samplerstate_t *device_samplerstate_create(gs_device_t *device,
 		const struct gs_sampler_info *info);
 EXPORT gs_shader_t *device_vertexshader_create(gs_device_t *device,
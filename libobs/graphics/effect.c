@@ -30,6 +30,8 @@ void gs_effect_actually_destroy(gs_effect_t *effect)
 void gs_effect_destroy(gs_effect_t *effect)
 {
 	if (effect) {
+		if (effect->graphics->batch_effect == effect)
+			gs_sprite_batch_flush(effect->graphics);
 		if (!effect->cached)
 			gs_effect_actually_destroy(effect);
 	}
@@ -98,20 +100,62 @@ bool gs_effect_loop(gs_effect_t *effect, const char *name)
 
 size_t gs_technique_begin(gs_technique_t *tech)
 {
+	struct graphics_subsystem *graphics;
+
 	if (!tech) return 0;
 
+	graphics = tech->effect->graphics;
+
+	/* textures kept for batched sprites may only be used by the technique
+	 * that set them */
+	if (graphics->batch_sprites && graphics->batch_effect == tech->effect &&
+	    graphics->batch_technique != tech)
+		gs_sprite_batch_flush(graphics);
+
 	tech->effect->cur_technique = tech;
 	tech->effect->graphics->cur_effect = tech->effect;
 
 	return tech->passes.num;
 }
 
+/* values go back to their defaults once a technique ends.  values that are
+ * already at their default keep their version, so shaders that were last
+ * given that value are not uploaded to again by the next technique */
+static inline void reset_param(struct gs_effect_param *param,
+		bool keep_textures)
+{
+	/* textures are unbound at the end of every pass and may not outlive
+	 * the technique */
+	if (param->type == GS_SHADER_PARAM_TEXTURE) {
+		if (!keep_textures)
+			da_resize(param->cur_val, 0);
+		return;
+	}
+
+	/* without a default, the shaders keep the last value uploaded */
+	if (!param->default_val.num)
+		return;
+
+	if (param->cur_val.num == param->default_val.num &&
+	    memcmp(param->cur_val.array, param->default_val.array,
+		    param->default_val.num) == 0)
+		return;
+
+	gs_sprite_batch_flush(param->effect->graphics);
+
+	da_copy(param->cur_val, param->default_val);
+	if (++param->version == 0)
+		param->version = 1;
+}
+
 void gs_technique_end(gs_technique_t *tech)
 {
 	if (!tech) return;
 
 	struct gs_effect *effect = tech->effect;
+	struct graphics_subsystem *graphics = effect->graphics;
 	struct gs_effect_param *params = effect->params.array;
+	bool keep_textures;
 	size_t i;
 
 	gs_load_vertexshader(NULL);
@@ -120,10 +164,17 @@ void gs_technique_end(gs_technique_t *tech)
 	tech->effect->cur_technique = NULL;
 	tech->effect->graphics->cur_effect = NULL;
 
+	/* batched sprites still need their textures, they are reset once the
+	 * sprites are drawn */
+	keep_textures = graphics->batch_sprites &&
+		graphics->batch_effect == effect;
+	if (keep_textures)
+		graphics->batch_technique_ended = true;
+
 	for (i = 0; i < effect->params.num; i++) {
 		struct gs_effect_param *param = params+i;
 
-		da_free(param->cur_val);
+		reset_param(param, keep_textures);
 		param->changed = false;
 		if (param->next_sampler)
 			param->next_sampler = NULL;
@@ -156,14 +207,25 @@ static void upload_shader_params(struct darray *pass_params, bool changed_only)
 			continue;
 
 		if (!eparam->cur_val.num) {
-			if (eparam->default_val.num)
+			if (eparam->default_val.num) {
+				gs_sprite_batch_flush(eparam->effect->graphics);
 				da_copy(eparam->cur_val, eparam->default_val);
-			else
+				eparam->version++;
+			} else {
 				continue;
+			}
 		}
 
+		/* the shader keeps its constants between passes, so only
+		 * values that changed since they were last uploaded to this
+		 * shader need to be set again */
+		if (param->uploaded_version == eparam->version)
+			continue;
+
 		gs_shader_set_val(sparam, eparam->cur_val.array,
 				eparam->cur_val.num);
+		param->uploaded_version = eparam->version;
+		eparam->effect->graphics->draw_stats.param_uploads++;
 	}
 }
 
@@ -235,8 +297,26 @@ static inline void clear_tex_params(struct darray *in_params)
 		struct gs_shader_param_info info;
 
 		gs_shader_get_param_info(param->sparam, &info);
-		if (info.type == GS_SHADER_PARAM_TEXTURE)
+		if (info.type == GS_SHADER_PARAM_TEXTURE) {
 			gs_shader_set_texture(param->sparam, NULL);
+			param->uploaded_version = 0;
+		}
+	}
+}
+
+void effect_pass_clear_textures(struct gs_effect_pass *pass)
+{
+	clear_tex_params(&pass->vertshader_params.da);
+	clear_tex_params(&pass->pixelshader_params.da);
+}
+
+void effect_reset_textures(struct gs_effect *effect)
+{
+	struct gs_effect_param *params = effect->params.array;
+
+	for (size_t i = 0; i < effect->params.num; i++) {
+		if (params[i].type == GS_SHADER_PARAM_TEXTURE)
+			da_resize(params[i].cur_val, 0);
 	}
 }
 
@@ -244,12 +324,18 @@ void gs_technique_end_pass(gs_technique_t *tech)
 {
 	if (!tech) return;
 
+	struct graphics_subsystem *graphics = tech->effect->graphics;
 	struct gs_effect_pass *pass = tech->effect->cur_pass;
 	if (!pass)
 		return;
 
-	clear_tex_params(&pass->vertshader_params.da);
-	clear_tex_params(&pass->pixelshader_params.da);
+	/* batched sprites of this pass are drawn with its textures later,
+	 * a run of sprites that begin the pass again can keep them bound */
+	if (graphics->batch_sprites && graphics->batch_pass == pass)
+		graphics->batch_pass_ended = true;
+	else
+		effect_pass_clear_textures(pass);
+
 	tech->effect->cur_pass = NULL;
 }
 
@@ -323,13 +409,20 @@ static inline void effect_setval_inline(gs_eparam_t *param,
 
 	size_changed = param->cur_val.num != size;
 
+	if (!size_changed && memcmp(param->cur_val.array, data, size) == 0)
+		return;
+
+	/* sprites already batched must be drawn with the old value */
+	gs_sprite_batch_flush(param->effect->graphics);
+
 	if (size_changed)
 		da_resize(param->cur_val, size);
 
-	if (size_changed || memcmp(param->cur_val.array, data, size) != 0) {
-		memcpy(param->cur_val.array, data, size);
-		param->changed = true;
-	}
+	memcpy(param->cur_val.array, data, size);
+	param->changed = true;
+
+	if (++param->version == 0)
+		param->version = 1;
 }
 
 void gs_effect_set_bool(gs_eparam_t *param, bool val)
@@ -398,6 +491,8 @@ void gs_effect_set_next_sampler(gs_eparam_t *param, gs_samplerstate_t *sampler)
 		return;
 	}
 
-	if (param->type == GS_SHADER_PARAM_TEXTURE)
+	if (param->type == GS_SHADER_PARAM_TEXTURE) {
+		gs_sprite_batch_flush(param->effect->graphics);
 		param->next_sampler = sampler;
+	}
 }
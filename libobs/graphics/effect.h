@@ -53,6 +53,7 @@ struct gs_effect_param {
 	enum gs_shader_param_type type;
 
 	bool changed;
+	uint32_t version;
 	DARRAY(uint8_t) cur_val;
 	DARRAY(uint8_t) default_val;
 
@@ -84,6 +85,9 @@ EXPORT void effect_param_parse_property(gs_eparam_t *param,
 struct pass_shaderparam {
 	struct gs_effect_param *eparam;
 	gs_sparam_t *sparam;
+
+	/* version of eparam last uploaded to sparam, 0 if none */
+	uint32_t uploaded_version;
 };
 
 struct gs_effect_pass {
@@ -178,6 +182,11 @@ static inline void effect_free(gs_effect_t *effect)
 	effect->effect_dir = NULL;
 }
 
+/* finish ending a pass or technique that was put off for batched sprites,
+ * see gs_sprite_batch_flush */
+extern void effect_pass_clear_textures(struct gs_effect_pass *pass);
+extern void effect_reset_textures(struct gs_effect *effect);
+
 EXPORT void effect_upload_params(gs_effect_t *effect, bool changed_only);
 EXPORT void effect_upload_shader_params(gs_effect_t *effect,
 		gs_shader_t *shader, struct darray *pass_params,
@@ -135,6 +135,14 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_stagesurface_map);
 	GRAPHICS_IMPORT(gs_stagesurface_unmap);
 
+	GRAPHICS_IMPORT_OPTIONAL(device_upload_buffers_available);
+	GRAPHICS_IMPORT_OPTIONAL(device_upload_buffer_create);
+	GRAPHICS_IMPORT_OPTIONAL(device_texture_set_image_from_buffer);
+	GRAPHICS_IMPORT_OPTIONAL(device_texture_set_image_rect);
+	GRAPHICS_IMPORT_OPTIONAL(gs_upload_buffer_destroy);
+	GRAPHICS_IMPORT_OPTIONAL(gs_upload_buffer_get_data);
+	GRAPHICS_IMPORT_OPTIONAL(gs_upload_buffer_busy);
+
 	GRAPHICS_IMPORT(gs_zstencil_destroy);
 
 	GRAPHICS_IMPORT(gs_samplerstate_destroy);
@@ -183,6 +183,20 @@ struct gs_exports {
 			uint8_t **data, uint32_t *linesize);
 	void     (*gs_stagesurface_unmap)(gs_stagesurf_t *stagesurf);
 
+	bool     (*device_upload_buffers_available)(gs_device_t *device);
+	gs_upload_buffer_t *(*device_upload_buffer_create)(gs_device_t *device,
+			size_t size);
+	void     (*device_texture_set_image_from_buffer)(gs_device_t *device,
+			gs_texture_t *tex, gs_upload_buffer_t *buf,
+			uint32_t linesize);
+	bool     (*device_texture_set_image_rect)(gs_device_t *device,
+			gs_texture_t *tex, uint32_t x, uint32_t y,
+			uint32_t cx, uint32_t cy, const uint8_t *data,
+			uint32_t linesize);
+	void     (*gs_upload_buffer_destroy)(gs_upload_buffer_t *buf);
+	uint8_t *(*gs_upload_buffer_get_data)(gs_upload_buffer_t *buf);
+	bool     (*gs_upload_buffer_busy)(gs_upload_buffer_t *buf);
+
 	void (*gs_zstencil_destroy)(gs_zstencil_t *zstencil);
 
 	void (*gs_samplerstate_destroy)(gs_samplerstate_t *samplerstate);
@@ -287,6 +301,25 @@ struct graphics_subsystem {
 
 	gs_vertbuffer_t        *sprite_buffer;
 
+	char                   *shader_cache_path;
+
+	/* sprites collected by gs_draw_sprite that haven't been drawn yet, see
+	 * gs_sprite_batch_flush */
+	gs_vertbuffer_t        *batch_buffer;
+	int                    batch_depth;
+	size_t                 batch_sprites;
+	struct gs_effect       *batch_effect;
+	gs_technique_t         *batch_technique;
+	struct gs_effect_pass  *batch_pass;
+	gs_shader_t            *batch_vertshader;
+	gs_shader_t            *batch_pixelshader;
+	bool                   batch_pass_ended;
+	bool                   batch_technique_ended;
+	bool                   batch_unload_vertshader;
+	bool                   batch_unload_pixelshader;
+
+	struct gs_draw_stats   draw_stats;
+
 	bool                   using_immediate;
 	struct gs_vb_data      *vbd;
 	gs_vertbuffer_t        *immediate_vertbuffer;
@@ -304,3 +337,5 @@ struct graphics_subsystem {
 	struct blend_state     cur_blend_state;
 	DARRAY(struct blend_state) blend_state_stack;
 };
+
+extern void gs_sprite_batch_flush(struct graphics_subsystem *graphics);
@@ -140,6 +140,29 @@ static bool graphics_init_sprite_vb(struct graphics_subsystem *graphics)
 	return true;
 }
 
+#define BATCH_MAX_SPRITES 128
+#define BATCH_MAX_VERTS   (BATCH_MAX_SPRITES * 6)
+
+static bool graphics_init_batch_vb(struct graphics_subsystem *graphics)
+{
+	struct gs_vb_data *vbd;
+
+	vbd = gs_vbdata_create();
+	vbd->num     = BATCH_MAX_VERTS;
+	vbd->points  = bzalloc(sizeof(struct vec3) * BATCH_MAX_VERTS);
+	vbd->num_tex = 1;
+	vbd->tvarray = bmalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray[0].width = 2;
+	vbd->tvarray[0].array = bzalloc(sizeof(struct vec2) * BATCH_MAX_VERTS);
+
+	graphics->batch_buffer = graphics->exports.
+		device_vertexbuffer_create(graphics->device, vbd, GS_DYNAMIC);
+	if (!graphics->batch_buffer)
+		return false;
+
+	return true;
+}
+
 static bool graphics_init(struct graphics_subsystem *graphics)
 {
 	struct matrix4 top_mat;
@@ -153,6 +176,8 @@ static bool graphics_init(struct graphics_subsystem *graphics)
 		return false;
 	if (!graphics_init_sprite_vb(graphics))
 		return false;
+	if (!graphics_init_batch_vb(graphics))
+		return false;
 	if (pthread_mutex_init(&graphics->mutex, NULL) != 0)
 		return false;
 	if (pthread_mutex_init(&graphics->effect_mutex, NULL) != 0)
@@ -232,6 +257,8 @@ void gs_destroy(graphics_t *graphics)
 
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->sprite_buffer);
+		graphics->exports.gs_vertexbuffer_destroy(
+				graphics->batch_buffer);
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->immediate_vertbuffer);
 		graphics->exports.device_destroy(graphics->device);
@@ -241,6 +268,7 @@ void gs_destroy(graphics_t *graphics)
 
 	pthread_mutex_destroy(&graphics->mutex);
 	pthread_mutex_destroy(&graphics->effect_mutex);
+	bfree(graphics->shader_cache_path);
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
 	da_free(graphics->blend_state_stack);
@@ -997,6 +1025,120 @@ static inline void build_sprite_rect(struct gs_vb_data *data, gs_texture_t *tex,
 	build_sprite(data, fcx, fcy, start_u, end_u, start_v, end_v);
 }
 
+/*
+ * Sprites are only merged while nothing but their vertices changes.  Every
+ * function that changes device state draws the pending sprites first, and so
+ * does changing an effect parameter to a different value.
+ *
+ * Ending the pass and technique of the batched sprites would unload their
+ * shaders and textures, which would end every batch after one sprite since
+ * most sprites are drawn in a pass of their own.  While sprites are pending,
+ * that is put off until they are drawn, so that a run of sprites that begin
+ * the same pass again with the same parameters is drawn at once.
+ */
+void gs_sprite_batch_flush(struct graphics_subsystem *graphics)
+{
+	size_t count = graphics ? graphics->batch_sprites : 0;
+	struct gs_effect *effect;
+
+	if (!count)
+		return;
+
+	/* cleared first, drawing the batch would flush it again otherwise */
+	graphics->batch_sprites = 0;
+
+	gs_vertexbuffer_flush(graphics->batch_buffer);
+	graphics->exports.device_load_vertexbuffer(graphics->device,
+			graphics->batch_buffer);
+	graphics->exports.device_load_indexbuffer(graphics->device, NULL);
+
+	/* vertices are already transformed */
+	gs_matrix_push();
+	gs_matrix_identity();
+	graphics->exports.device_draw(graphics->device, GS_TRIS, 0,
+			(uint32_t)(count * 6));
+	gs_matrix_pop();
+
+	graphics->draw_stats.draws++;
+
+	effect = graphics->batch_effect;
+	if (graphics->batch_pass_ended &&
+	    effect->cur_pass != graphics->batch_pass)
+		effect_pass_clear_textures(graphics->batch_pass);
+	if (graphics->batch_technique_ended && !effect->cur_technique)
+		effect_reset_textures(effect);
+	if (graphics->batch_unload_vertshader)
+		graphics->exports.device_load_vertexshader(graphics->device,
+				NULL);
+	if (graphics->batch_unload_pixelshader)
+		graphics->exports.device_load_pixelshader(graphics->device,
+				NULL);
+
+	graphics->batch_pass_ended         = false;
+	graphics->batch_technique_ended    = false;
+	graphics->batch_unload_vertshader  = false;
+	graphics->batch_unload_pixelshader = false;
+}
+
+static void batch_sprite(struct graphics_subsystem *graphics,
+		gs_texture_t *tex, float fcx, float fcy, uint32_t flip)
+{
+	static const size_t order[6] = {0, 1, 2, 2, 1, 3};
+	struct vec3 points[4];
+	struct vec2 uvs[4];
+	struct gs_tvertarray tvarray = {2, uvs};
+	struct gs_vb_data sprite = {0};
+	struct gs_vb_data *data;
+	struct vec2 *batch_uvs;
+	struct matrix4 world;
+	size_t idx;
+
+	sprite.num     = 4;
+	sprite.points  = points;
+	sprite.num_tex = 1;
+	sprite.tvarray = &tvarray;
+
+	if (tex && gs_texture_is_rect(tex))
+		build_sprite_rect(&sprite, tex, fcx, fcy, flip);
+	else
+		build_sprite_norm(&sprite, fcx, fcy, flip);
+
+	if (graphics->batch_sprites == BATCH_MAX_SPRITES ||
+	    graphics->batch_effect != graphics->cur_effect ||
+	    graphics->batch_pass   != graphics->cur_effect->cur_pass)
+		gs_sprite_batch_flush(graphics);
+
+	/* values set since the pass began are uploaded right away, the batch
+	 * is drawn with whatever the shaders hold */
+	gs_effect_update_params(graphics->cur_effect);
+
+	if (!graphics->batch_sprites) {
+		struct gs_effect_pass *pass = graphics->cur_effect->cur_pass;
+
+		graphics->batch_effect      = graphics->cur_effect;
+		graphics->batch_technique   =
+			graphics->cur_effect->cur_technique;
+		graphics->batch_pass        = pass;
+		graphics->batch_vertshader  = pass->vertshader;
+		graphics->batch_pixelshader = pass->pixelshader;
+	}
+
+	gs_matrix_get(&world);
+
+	data = gs_vertexbuffer_get_data(graphics->batch_buffer);
+	batch_uvs = data->tvarray[0].array;
+	idx = graphics->batch_sprites * 6;
+
+	for (size_t i = 0; i < 6; i++) {
+		vec3_transform(data->points + idx + i, points + order[i],
+				&world);
+		vec2_copy(batch_uvs + idx + i, uvs + order[i]);
+	}
+
+	graphics->batch_sprites++;
+	graphics->draw_stats.batched_sprites++;
+}
+
 void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 		uint32_t height)
 {
@@ -1020,6 +1162,14 @@ void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 	fcx = width  ? (float)width  : (float)gs_texture_get_width(tex);
 	fcy = height ? (float)height : (float)gs_texture_get_height(tex);
 
+	graphics->draw_stats.sprites++;
+
+	if (graphics->batch_depth && graphics->cur_effect &&
+	    graphics->cur_effect->cur_pass) {
+		batch_sprite(graphics, tex, fcx, fcy, flip);
+		return;
+	}
+
 	data = gs_vertexbuffer_get_data(graphics->sprite_buffer);
 	if (tex && gs_texture_is_rect(tex))
 		build_sprite_rect(data, tex, fcx, fcy, flip);
@@ -1051,6 +1201,8 @@ void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 	fcx = (float)gs_texture_get_width(tex);
 	fcy = (float)gs_texture_get_height(tex);
 
+	graphics->draw_stats.sprites++;
+
 	data = gs_vertexbuffer_get_data(graphics->sprite_buffer);
 	build_subsprite_norm(data,
 			(float)sub_x, (float)sub_y,
@@ -1064,6 +1216,42 @@ void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 	gs_draw(GS_TRISTRIP, 0, 0);
 }
 
+void gs_sprite_batch_begin(void)
+{
+	if (!gs_valid("gs_sprite_batch_begin"))
+		return;
+
+	thread_graphics->batch_depth++;
+}
+
+void gs_sprite_batch_end(void)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_sprite_batch_end"))
+		return;
+
+	if (graphics->batch_depth > 0 && --graphics->batch_depth == 0)
+		gs_sprite_batch_flush(graphics);
+}
+
+void gs_get_draw_stats(struct gs_draw_stats *stats)
+{
+	if (!gs_valid_p("gs_get_draw_stats", stats))
+		return;
+
+	*stats = thread_graphics->draw_stats;
+}
+
+void gs_reset_draw_stats(void)
+{
+	if (!gs_valid("gs_reset_draw_stats"))
+		return;
+
+	memset(&thread_graphics->draw_stats, 0,
+			sizeof(thread_graphics->draw_stats));
+}
+
 void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
 		float left, float right, float top, float bottom, float znear)
 {
@@ -1169,6 +1357,21 @@ void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
 	gs_texture_unmap(tex);
 }
 
+bool gs_texture_set_image_rect(gs_texture_t *tex, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy, const uint8_t *data,
+		uint32_t linesize)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_image_rect", tex, data))
+		return false;
+	if (!graphics->exports.device_texture_set_image_rect)
+		return false;
+
+	return graphics->exports.device_texture_set_image_rect(
+			graphics->device, tex, x, y, cx, cy, data, linesize);
+}
+
 void gs_cubetexture_set_image(gs_texture_t *cubetex, uint32_t side,
 		const void *data, uint32_t linesize, bool invert)
 {
@@ -1544,6 +1747,8 @@ void gs_load_vertexbuffer(gs_vertbuffer_t *vertbuffer)
 	if (!gs_valid("gs_load_vertexbuffer"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_load_vertexbuffer(graphics->device,
 			vertbuffer);
 }
@@ -1555,6 +1760,8 @@ void gs_load_indexbuffer(gs_indexbuffer_t *indexbuffer)
 	if (!gs_valid("gs_load_indexbuffer"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_load_indexbuffer(graphics->device,
 			indexbuffer);
 }
@@ -1566,6 +1773,9 @@ void gs_load_texture(gs_texture_t *tex, int unit)
 	if (!gs_valid("gs_load_texture"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+	graphics->draw_stats.texture_changes++;
+
 	graphics->exports.device_load_texture(graphics->device, tex, unit);
 }
 
@@ -1576,6 +1786,8 @@ void gs_load_samplerstate(gs_samplerstate_t *samplerstate, int unit)
 	if (!gs_valid("gs_load_samplerstate"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_load_samplerstate(graphics->device,
 			samplerstate, unit);
 }
@@ -1587,6 +1799,21 @@ void gs_load_vertexshader(gs_shader_t *vertshader)
 	if (!gs_valid("gs_load_vertexshader"))
 		return;
 
+	/* the shader of batched sprites stays loaded until they are drawn */
+	if (graphics->batch_sprites) {
+		if (vertshader == graphics->batch_vertshader) {
+			graphics->batch_unload_vertshader = false;
+			return;
+		} else if (!vertshader) {
+			graphics->batch_unload_vertshader = true;
+			return;
+		}
+
+		gs_sprite_batch_flush(graphics);
+	}
+
+	graphics->draw_stats.shader_changes++;
+
 	graphics->exports.device_load_vertexshader(graphics->device,
 			vertshader);
 }
@@ -1598,6 +1825,21 @@ void gs_load_pixelshader(gs_shader_t *pixelshader)
 	if (!gs_valid("gs_load_pixelshader"))
 		return;
 
+	/* the shader of batched sprites stays loaded until they are drawn */
+	if (graphics->batch_sprites) {
+		if (pixelshader == graphics->batch_pixelshader) {
+			graphics->batch_unload_pixelshader = false;
+			return;
+		} else if (!pixelshader) {
+			graphics->batch_unload_pixelshader = true;
+			return;
+		}
+
+		gs_sprite_batch_flush(graphics);
+	}
+
+	graphics->draw_stats.shader_changes++;
+
 	graphics->exports.device_load_pixelshader(graphics->device,
 			pixelshader);
 }
@@ -1609,6 +1851,8 @@ void gs_load_default_samplerstate(bool b_3d, int unit)
 	if (!gs_valid("gs_load_default_samplerstate"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_load_default_samplerstate(graphics->device,
 			b_3d, unit);
 }
@@ -1660,6 +1904,9 @@ void gs_set_render_target(gs_texture_t *tex, gs_zstencil_t *zstencil)
 	if (!gs_valid("gs_set_render_target"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+	graphics->draw_stats.render_target_changes++;
+
 	graphics->exports.device_set_render_target(graphics->device, tex,
 			zstencil);
 }
@@ -1672,6 +1919,9 @@ void gs_set_cube_render_target(gs_texture_t *cubetex, int side,
 	if (!gs_valid("gs_set_cube_render_target"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+	graphics->draw_stats.render_target_changes++;
+
 	graphics->exports.device_set_cube_render_target(graphics->device,
 			cubetex, side, zstencil);
 }
@@ -1683,6 +1933,8 @@ void gs_copy_texture(gs_texture_t *dst, gs_texture_t *src)
 	if (!gs_valid_p2("gs_copy_texture", dst, src))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_copy_texture(graphics->device, dst, src);
 }
 
@@ -1695,6 +1947,8 @@ void gs_copy_texture_region(gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
 	if (!gs_valid_p("gs_copy_texture_region", dst))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_copy_texture_region(graphics->device,
 			dst, dst_x, dst_y,
 			src, src_x, src_y, src_w, src_h);
@@ -1707,6 +1961,8 @@ void gs_stage_texture(gs_stagesurf_t *dst, gs_texture_t *src)
 	if (!gs_valid("gs_stage_texture"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_stage_texture(graphics->device, dst, src);
 }
 
@@ -1728,6 +1984,9 @@ void gs_draw(enum gs_draw_mode draw_mode, uint32_t start_vert,
 	if (!gs_valid("gs_draw"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+	graphics->draw_stats.draws++;
+
 	graphics->exports.device_draw(graphics->device, draw_mode,
 			start_vert, num_verts);
 }
@@ -1739,6 +1998,8 @@ void gs_end_scene(void)
 	if (!gs_valid("gs_end_scene"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_end_scene(graphics->device);
 }
 
@@ -1760,6 +2021,8 @@ void gs_clear(uint32_t clear_flags, const struct vec4 *color, float depth,
 	if (!gs_valid("gs_clear"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_clear(graphics->device, clear_flags, color,
 			depth, stencil);
 }
@@ -1771,6 +2034,8 @@ void gs_present(void)
 	if (!gs_valid("gs_present"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_present(graphics->device);
 }
 
@@ -1781,6 +2046,8 @@ void gs_flush(void)
 	if (!gs_valid("gs_flush"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_flush(graphics->device);
 }
 
@@ -1791,6 +2058,8 @@ void gs_set_cull_mode(enum gs_cull_mode mode)
 	if (!gs_valid("gs_set_cull_mode"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_set_cull_mode(graphics->device, mode);
 }
 
@@ -1811,6 +2080,9 @@ void gs_enable_blending(bool enable)
 	if (!gs_valid("gs_enable_blending"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+	graphics->draw_stats.blend_changes++;
+
 	graphics->cur_blend_state.enabled = enable;
 	graphics->exports.device_enable_blending(graphics->device, enable);
 }
@@ -1822,6 +2094,8 @@ void gs_enable_depth_test(bool enable)
 	if (!gs_valid("gs_enable_depth_test"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_enable_depth_test(graphics->device, enable);
 }
 
@@ -1832,6 +2106,8 @@ void gs_enable_stencil_test(bool enable)
 	if (!gs_valid("gs_enable_stencil_test"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_enable_stencil_test(graphics->device, enable);
 }
 
@@ -1842,6 +2118,8 @@ void gs_enable_stencil_write(bool enable)
 	if (!gs_valid("gs_enable_stencil_write"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_enable_stencil_write(graphics->device, enable);
 }
 
@@ -1852,6 +2130,8 @@ void gs_enable_color(bool red, bool green, bool blue, bool alpha)
 	if (!gs_valid("gs_enable_color"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_enable_color(graphics->device, red, green,
 			blue, alpha);
 }
@@ -1863,6 +2143,9 @@ void gs_blend_function(enum gs_blend_type src, enum gs_blend_type dest)
 	if (!gs_valid("gs_blend_function"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+	graphics->draw_stats.blend_changes++;
+
 	graphics->cur_blend_state.src_c  = src;
 	graphics->cur_blend_state.dest_c = dest;
 	graphics->cur_blend_state.src_a  = src;
@@ -1879,6 +2162,9 @@ void gs_blend_function_separate(
 	if (!gs_valid("gs_blend_function_separate"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+	graphics->draw_stats.blend_changes++;
+
 	graphics->cur_blend_state.src_c  = src_c;
 	graphics->cur_blend_state.dest_c = dest_c;
 	graphics->cur_blend_state.src_a  = src_a;
@@ -1894,6 +2180,8 @@ void gs_depth_function(enum gs_depth_test test)
 	if (!gs_valid("gs_depth_function"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_depth_function(graphics->device, test);
 }
 
@@ -1904,6 +2192,8 @@ void gs_stencil_function(enum gs_stencil_side side, enum gs_depth_test test)
 	if (!gs_valid("gs_stencil_function"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_stencil_function(graphics->device, side, test);
 }
 
@@ -1915,6 +2205,8 @@ void gs_stencil_op(enum gs_stencil_side side, enum gs_stencil_op_type fail,
 	if (!gs_valid("gs_stencil_op"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_stencil_op(graphics->device, side, fail, zfail,
 			zpass);
 }
@@ -1926,6 +2218,8 @@ void gs_set_viewport(int x, int y, int width, int height)
 	if (!gs_valid("gs_set_viewport"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_set_viewport(graphics->device, x, y, width,
 			height);
 }
@@ -1958,6 +2252,8 @@ void gs_ortho(float left, float right, float top, float bottom, float znear,
 	if (!gs_valid("gs_ortho"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_ortho(graphics->device, left, right, top,
 			bottom, znear, zfar);
 }
@@ -1970,6 +2266,8 @@ void gs_frustum(float left, float right, float top, float bottom, float znear,
 	if (!gs_valid("gs_frustum"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_frustum(graphics->device, left, right, top,
 			bottom, znear, zfar);
 }
@@ -1991,6 +2289,8 @@ void gs_projection_pop(void)
 	if (!gs_valid("gs_projection_pop"))
 		return;
 
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.device_projection_pop(graphics->device);
 }
 
@@ -2208,6 +2508,9 @@ void gs_texture_destroy(gs_texture_t *tex)
 	if (!tex)
 		return;
 
+	/* batched sprites may still be drawn from it */
+	gs_sprite_batch_flush(graphics);
+
 	graphics->exports.gs_texture_destroy(tex);
 }
 
@@ -2248,6 +2551,8 @@ bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 	if (!gs_valid_p3("gs_texture_map", tex, ptr, linesize))
 		return false;
 
+	gs_sprite_batch_flush(graphics);
+
 	return graphics->exports.gs_texture_map(tex, ptr, linesize);
 }
 
@@ -2433,6 +2738,76 @@ void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 	graphics->exports.gs_stagesurface_unmap(stagesurf);
 }
 
+bool gs_upload_buffers_available(void)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_upload_buffers_available"))
+		return false;
+	if (!graphics->exports.device_upload_buffers_available)
+		return false;
+
+	return graphics->exports.device_upload_buffers_available(
+			graphics->device);
+}
+
+gs_upload_buffer_t *gs_upload_buffer_create(size_t size)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_upload_buffer_create"))
+		return NULL;
+	if (!graphics->exports.device_upload_buffer_create)
+		return NULL;
+
+	return graphics->exports.device_upload_buffer_create(graphics->device,
+			size);
+}
+
+void gs_upload_buffer_destroy(gs_upload_buffer_t *buf)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_upload_buffer_destroy"))
+		return;
+	if (!buf)
+		return;
+
+	graphics->exports.gs_upload_buffer_destroy(buf);
+}
+
+uint8_t *gs_upload_buffer_get_data(gs_upload_buffer_t *buf)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_upload_buffer_get_data", buf))
+		return NULL;
+
+	return graphics->exports.gs_upload_buffer_get_data(buf);
+}
+
+bool gs_upload_buffer_busy(gs_upload_buffer_t *buf)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_upload_buffer_busy", buf))
+		return false;
+
+	return graphics->exports.gs_upload_buffer_busy(buf);
+}
+
+void gs_texture_set_image_from_buffer(gs_texture_t *tex,
+		gs_upload_buffer_t *buf, uint32_t linesize)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_image_from_buffer", tex, buf))
+		return;
+
+	graphics->exports.device_texture_set_image_from_buffer(
+			graphics->device, tex, buf, linesize);
+}
+
 void gs_zstencil_destroy(gs_zstencil_t *zstencil)
 {
 	if (!gs_valid("gs_zstencil_destroy"))
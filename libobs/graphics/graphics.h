@@ -257,6 +257,7 @@ struct graphics_subsystem;
 
 typedef struct gs_texture          gs_texture_t;
 typedef struct gs_stage_surface    gs_stagesurf_t;
+typedef struct gs_upload_buffer    gs_upload_buffer_t;
 typedef struct gs_zstencil_buffer  gs_zstencil_t;
 typedef struct gs_vertex_buffer    gs_vertbuffer_t;
 typedef struct gs_index_buffer     gs_indexbuffer_t;
@@ -519,6 +520,20 @@ EXPORT gs_shader_t *gs_vertexshader_create_from_file(const char *file,
 EXPORT gs_shader_t *gs_pixelshader_create_from_file(const char *file,
 		char **error_string);
 
+/**
+ * Sets the directory that compiled shaders are cached in across runs, or
+ * NULL to disable the cache.  Graphics modules with an expensive shader
+ * compiler look up and store their compiled shaders with
+ * gs_shader_cache_load/gs_shader_cache_store.
+ */
+EXPORT void gs_set_shader_cache_path(const char *path);
+
+/** Returns the cached binary of a shader, which must be freed with bfree */
+EXPORT bool gs_shader_cache_load(const char *source, const char *target,
+		uint8_t **data, size_t *size);
+EXPORT void gs_shader_cache_store(const char *source, const char *target,
+		const void *data, size_t size);
+
 EXPORT gs_texture_t *gs_texture_create_from_file(const char *file);
 EXPORT uint8_t *gs_create_texture_file_data(const char *file,
 		enum gs_color_format *format, uint32_t *cx, uint32_t *cy);
@@ -539,6 +554,38 @@ EXPORT void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 EXPORT void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
 
+/**
+ * Begins/ends a sprite batch
+ *
+ *   While a batch is open, sprites drawn with gs_draw_sprite inside an effect
+ * pass are transformed on the CPU and collected into one vertex buffer.  They
+ * are drawn with a single draw call when the batch ends, or earlier when an
+ * effect parameter changes value, or a shader, texture, blend state, render
+ * target or other state that affects drawing changes.  Sprites that each
+ * begin and end the same technique with the same parameters, such as copies
+ * of one image, are still drawn together.
+ *
+ *   Batches can be nested, the sprites are drawn when the outermost batch
+ * ends.
+ */
+EXPORT void gs_sprite_batch_begin(void);
+EXPORT void gs_sprite_batch_end(void);
+
+struct gs_draw_stats {
+	uint64_t draws;
+	uint64_t sprites;
+	uint64_t batched_sprites;
+	uint64_t shader_changes;
+	uint64_t param_uploads;
+	uint64_t texture_changes;
+	uint64_t blend_changes;
+	uint64_t render_target_changes;
+};
+
+/** Gets the number of draws and state changes since the last reset */
+EXPORT void gs_get_draw_stats(struct gs_draw_stats *stats);
+EXPORT void gs_reset_draw_stats(void);
+
 EXPORT void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
 		float left, float right, float top, float bottom, float znear);
 
@@ -555,6 +602,13 @@ EXPORT void gs_viewport_pop(void);
 
 EXPORT void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
 		uint32_t linesize, bool invert);
+/**
+ * Replaces a rectangle of a 2D texture, leaving the rest of it untouched.
+ * Returns false if the graphics subsystem does not support partial updates.
+ */
+EXPORT bool gs_texture_set_image_rect(gs_texture_t *tex, uint32_t x,
+		uint32_t y, uint32_t cx, uint32_t cy, const uint8_t *data,
+		uint32_t linesize);
 EXPORT void gs_cubetexture_set_image(gs_texture_t *cubetex, uint32_t side,
 		const void *data, uint32_t linesize, bool invert);
 
@@ -721,6 +775,22 @@ EXPORT bool     gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 		uint32_t *linesize);
 EXPORT void     gs_stagesurface_unmap(gs_stagesurf_t *stagesurf);
 
+/**
+ * Upload buffers are persistently mapped buffers that can be filled from any
+ * thread and then copied to a dynamic texture by the GPU.  Not all graphics
+ * subsystems support them.
+ *
+ *   The data pointer stays valid until the buffer is destroyed, but must
+ * not be written while gs_upload_buffer_busy returns true.
+ */
+EXPORT bool     gs_upload_buffers_available(void);
+EXPORT gs_upload_buffer_t *gs_upload_buffer_create(size_t size);
+EXPORT void     gs_upload_buffer_destroy(gs_upload_buffer_t *buf);
+EXPORT uint8_t *gs_upload_buffer_get_data(gs_upload_buffer_t *buf);
+EXPORT bool     gs_upload_buffer_busy(gs_upload_buffer_t *buf);
+EXPORT void     gs_texture_set_image_from_buffer(gs_texture_t *tex,
+		gs_upload_buffer_t *buf, uint32_t linesize);
+
 EXPORT void     gs_zstencil_destroy(gs_zstencil_t *zstencil);
 
 EXPORT void     gs_samplerstate_destroy(gs_samplerstate_t *samplerstate);
@@ -0,0 +1,200 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Project contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+
+#include "../util/crc32.h"
+#include "../util/dstr.h"
+#include "../util/platform.h"
+#include "graphics-internal.h"
+
+/*
+ * Compiled shaders are cached on disk, keyed by a hash of the final shader
+ * source and the compile target.  Each file also stores the full key, so a
+ * hash collision or a truncated file is treated as a cache miss rather than
+ * loading the wrong binary.  Editing an effect changes the generated source,
+ * so stale entries are simply never looked up again.
+ */
+
+#define SHADER_CACHE_MAGIC   0x4353424F /* "OBSC" */
+#define SHADER_CACHE_VERSION 1
+
+struct shader_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t key_size;
+	uint32_t data_size;
+};
+
+static inline void build_key(struct dstr *key, const char *source,
+		const char *target)
+{
+	dstr_copy(key, target);
+	dstr_cat_ch(key, '\n');
+	dstr_cat(key, source);
+}
+
+static bool get_cache_file(graphics_t *graphics, struct dstr *path,
+		const struct dstr *key)
+{
+	const char *cache_path = graphics->shader_cache_path;
+
+	if (!cache_path || !*cache_path)
+		return false;
+
+	dstr_printf(path, "%s/%08X%08X.bin", cache_path,
+			calc_crc32(0, key->array, key->len),
+			(uint32_t)key->len);
+	return true;
+}
+
+void gs_set_shader_cache_path(const char *path)
+{
+	graphics_t *graphics = gs_get_context();
+
+	if (!graphics)
+		return;
+
+	bfree(graphics->shader_cache_path);
+	graphics->shader_cache_path = NULL;
+
+	if (path && *path) {
+		if (os_mkdirs(path) == MKDIR_ERROR) {
+			blog(LOG_WARNING, "Could not create shader cache "
+			                  "directory '%s'", path);
+			return;
+		}
+
+		graphics->shader_cache_path = bstrdup(path);
+	}
+}
+
+static bool read_cache_file(FILE *f, const struct dstr *key,
+		uint8_t **data, size_t *size)
+{
+	struct shader_cache_header header;
+	char *stored_key = NULL;
+	bool match;
+
+	if (fread(&header, 1, sizeof(header), f) != sizeof(header))
+		return false;
+	if (header.magic   != SHADER_CACHE_MAGIC   ||
+	    header.version != SHADER_CACHE_VERSION ||
+	    header.key_size != key->len            ||
+	    !header.data_size)
+		return false;
+
+	stored_key = bmalloc(header.key_size);
+	match = fread(stored_key, 1, header.key_size, f) == header.key_size &&
+		memcmp(stored_key, key->array, key->len) == 0;
+	bfree(stored_key);
+
+	if (!match)
+		return false;
+
+	*data = bmalloc(header.data_size);
+	if (fread(*data, 1, header.data_size, f) != header.data_size) {
+		bfree(*data);
+		*data = NULL;
+		return false;
+	}
+
+	*size = header.data_size;
+	return true;
+}
+
+bool gs_shader_cache_load(const char *source, const char *target,
+		uint8_t **data, size_t *size)
+{
+	graphics_t *graphics = gs_get_context();
+	struct dstr key  = {0};
+	struct dstr path = {0};
+	bool success = false;
+	FILE *f;
+
+	if (!graphics || !source || !target || !data || !size)
+		return false;
+
+	*data = NULL;
+	*size = 0;
+
+	build_key(&key, source, target);
+	if (!get_cache_file(graphics, &path, &key))
+		goto exit;
+
+	f = os_fopen(path.array, "rb");
+	if (!f)
+		goto exit;
+
+	success = read_cache_file(f, &key, data, size);
+	fclose(f);
+
+exit:
+	dstr_free(&key);
+	dstr_free(&path);
+	return success;
+}
+
+void gs_shader_cache_store(const char *source, const char *target,
+		const void *data, size_t size)
+{
+	graphics_t *graphics = gs_get_context();
+	struct shader_cache_header header;
+	struct dstr key       = {0};
+	struct dstr path      = {0};
+	struct dstr temp_path = {0};
+	bool success;
+	FILE *f;
+
+	if (!graphics || !source || !target || !data || !size ||
+	    size > UINT32_MAX)
+		return;
+
+	build_key(&key, source, target);
+	if (!get_cache_file(graphics, &path, &key))
+		goto exit;
+
+	/* written to a temporary file first so that another process reading
+	 * the cache never sees a partially written entry */
+	dstr_copy_dstr(&temp_path, &path);
+	dstr_cat(&temp_path, ".tmp");
+
+	f = os_fopen(temp_path.array, "wb");
+	if (!f)
+		goto exit;
+
+	header.magic     = SHADER_CACHE_MAGIC;
+	header.version   = SHADER_CACHE_VERSION;
+	header.key_size  = (uint32_t)key.len;
+	header.data_size = (uint32_t)size;
+
+	success = fwrite(&header, 1, sizeof(header), f) == sizeof(header) &&
+		fwrite(key.array, 1, key.len, f) == key.len &&
+		fwrite(data, 1, size, f) == size;
+	fclose(f);
+
+	if (!success || os_rename(temp_path.array, path.array) != 0) {
+		blog(LOG_WARNING, "Could not write shader cache file '%s'",
+				path.array);
+		os_unlink(temp_path.array);
+	}
+
+exit:
+	dstr_free(&key);
+	dstr_free(&path);
+	dstr_free(&temp_path);
+}
@@ -33,24 +33,47 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
 #define nop() do {int invalid = 0;} while(0)
 
-struct audio_input {
+/* inputs of a mix that request the same conversion share one resampler, so
+ * the mix is only converted once per block for all of them */
+struct mix_resampler {
 	struct audio_convert_info conversion;
 	audio_resampler_t         *resampler;
+	size_t                    refs;
+
+	/* output for the current block */
+	bool                      resampled;
+	bool                      success;
+	struct audio_data         data;
+};
+
+struct audio_input {
+	struct audio_convert_info conversion;
+	struct mix_resampler      *resampler;
 
 	audio_output_callback_t callback;
 	void *param;
 };
 
-static inline void audio_input_free(struct audio_input *input)
-{
-	audio_resampler_destroy(input->resampler);
-}
-
 struct audio_mix {
 	DARRAY(struct audio_input) inputs;
+	DARRAY(struct mix_resampler*) resamplers;
 	float buffer[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
 };
 
+static inline void audio_input_free(struct audio_input *input,
+		struct audio_mix *mix)
+{
+	struct mix_resampler *resampler = input->resampler;
+
+	if (resampler && --resampler->refs == 0) {
+		da_erase_item(mix->resamplers, &resampler);
+		audio_resampler_destroy(resampler->resampler);
+		bfree(resampler);
+	}
+
+	input->resampler = NULL;
+}
+
 struct audio_output {
 	struct audio_output_info   info;
 	size_t                     block_size;
@@ -118,27 +141,33 @@ static inline size_t min_size(size_t a, size_t b)
 static bool resample_audio_output(struct audio_input *input,
 		struct audio_data *data)
 {
-	bool success = true;
+	struct mix_resampler *resampler = input->resampler;
 
-	if (input->resampler) {
+	if (!resampler)
+		return true;
+
+	if (!resampler->resampled) {
 		uint8_t  *output[MAX_AV_PLANES];
 		uint32_t frames;
 		uint64_t offset;
 
 		memset(output, 0, sizeof(output));
 
-		success = audio_resampler_resample(input->resampler,
+		resampler->success = audio_resampler_resample(
+				resampler->resampler,
 				output, &frames, &offset,
 				(const uint8_t *const *)data->data,
 				data->frames);
+		resampler->resampled = true;
 
 		for (size_t i = 0; i < MAX_AV_PLANES; i++)
-			data->data[i] = output[i];
-		data->frames     = frames;
-		data->timestamp -= offset;
+			resampler->data.data[i] = output[i];
+		resampler->data.frames    = frames;
+		resampler->data.timestamp = data->timestamp - offset;
 	}
 
-	return success;
+	*data = resampler->data;
+	return resampler->success;
 }
 
 static inline void do_audio_output(struct audio_output *audio,
@@ -149,6 +178,9 @@ static inline void do_audio_output(struct audio_output *audio,
 
 	pthread_mutex_lock(&audio->input_mutex);
 
+	for (size_t i = 0; i < mix->resamplers.num; i++)
+		mix->resamplers.array[i]->resampled = false;
+
 	for (size_t i = mix->inputs.num; i > 0; i--) {
 		struct audio_input *input = mix->inputs.array+(i-1);
 
@@ -298,12 +330,43 @@ static size_t audio_get_input_idx(const audio_t *audio, size_t mix_idx,
 	return DARRAY_INVALID;
 }
 
+static inline bool same_conversion(const struct audio_convert_info *a,
+		const struct audio_convert_info *b)
+{
+	return a->format          == b->format          &&
+	       a->samples_per_sec == b->samples_per_sec &&
+	       a->speakers        == b->speakers;
+}
+
+static struct mix_resampler *find_mix_resampler(struct audio_mix *mix,
+		const struct audio_convert_info *conversion)
+{
+	for (size_t i = 0; i < mix->resamplers.num; i++) {
+		struct mix_resampler *resampler = mix->resamplers.array[i];
+
+		if (same_conversion(&resampler->conversion, conversion))
+			return resampler;
+	}
+
+	return NULL;
+}
+
 static inline bool audio_input_init(struct audio_input *input,
-		struct audio_output *audio)
+		struct audio_output *audio, struct audio_mix *mix)
 {
 	if (input->conversion.format          != audio->info.format          ||
 	    input->conversion.samples_per_sec != audio->info.samples_per_sec ||
 	    input->conversion.speakers        != audio->info.speakers) {
+		struct mix_resampler *resampler;
+		audio_resampler_t *new_resampler;
+
+		resampler = find_mix_resampler(mix, &input->conversion);
+		if (resampler) {
+			resampler->refs++;
+			input->resampler = resampler;
+			return true;
+		}
+
 		struct resample_info from = {
 			.format          = audio->info.format,
 			.samples_per_sec = audio->info.samples_per_sec,
@@ -316,12 +379,20 @@ static inline bool audio_input_init(struct audio_input *input,
 			.speakers        = input->conversion.speakers
 		};
 
-		input->resampler = audio_resampler_create(&to, &from);
-		if (!input->resampler) {
+		new_resampler = audio_resampler_create(&to, &from);
+		if (!new_resampler) {
 			blog(LOG_ERROR, "audio_input_init: Failed to "
 			                "create resampler");
 			return false;
 		}
+
+		resampler = bzalloc(sizeof(struct mix_resampler));
+		resampler->conversion = input->conversion;
+		resampler->resampler = new_resampler;
+		resampler->refs = 1;
+		da_push_back(mix->resamplers, &resampler);
+
+		input->resampler = resampler;
 	} else {
 		input->resampler = NULL;
 	}
@@ -362,7 +433,7 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 			input.conversion.samples_per_sec =
 				audio->info.samples_per_sec;
 
-		success = audio_input_init(&input, audio);
+		success = audio_input_init(&input, audio, mix);
 		if (success)
 			da_push_back(mix->inputs, &input);
 	}
@@ -382,7 +453,7 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 	size_t idx = audio_get_input_idx(audio, mix_idx, callback, param);
 	if (idx != DARRAY_INVALID) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
-		audio_input_free(mix->inputs.array+idx);
+		audio_input_free(mix->inputs.array+idx, mix);
 		da_erase(mix->inputs, idx);
 	}
 
@@ -452,9 +523,10 @@ void audio_output_close(audio_t *audio)
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		for (size_t i = 0; i < mix->inputs.num; i++)
-			audio_input_free(mix->inputs.array+i);
+			audio_input_free(mix->inputs.array+i, mix);
 
 		da_free(mix->inputs);
+		da_free(mix->resamplers);
 	}
 
 	os_event_destroy(audio->stop_event);
@@ -0,0 +1,475 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Project contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#include "../util/bmem.h"
+#include "audio-math.h"
+#include "audio-loudness.h"
+
+/*
+ * Channels are processed four at a time, one per SSE lane, so the K-weighting
+ * filters run for all channels of a sample at once.  Each 100 ms block yields
+ * one mean square value; the last 4 give the momentary loudness and the last
+ * 30 the short-term loudness.  For the integrated loudness, each gating block
+ * (400 ms, 75% overlap) is added to a histogram of 0.1 LU bins, so that the
+ * relative gate can be applied at any time without keeping every block.
+ */
+
+#define CHANNEL_GROUPS    (MAX_AUDIO_CHANNELS / 4)
+#define CHUNK_FRAMES      256
+
+#define MOMENTARY_BLOCKS  4
+#define SHORT_TERM_BLOCKS 30
+
+#define ABSOLUTE_GATE     -70.0
+#define RELATIVE_GATE     -10.0
+#define HISTOGRAM_MIN     ABSOLUTE_GATE
+#define HISTOGRAM_BINS    1000 /* -70 to +30 LUFS */
+
+#define TP_PHASES         4
+#define TP_TAPS           12
+#define TP_HISTORY        (TP_TAPS - 1)
+
+/* ITU-R BS.1770-4 annex 2, 4x oversampling interpolation filter */
+static const float tp_coefs[TP_PHASES][TP_TAPS] = {
+	{ 0.0017089843750f,  0.0109863281250f, -0.0196533203125f,
+	  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+	  0.9721679687500f, -0.1022949218750f,  0.0476074218750f,
+	 -0.0266113281250f,  0.0148925781250f, -0.0083007812500f},
+	{-0.0291748046875f,  0.0292968750000f, -0.0517578125000f,
+	  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+	  0.7797851562500f, -0.2003173828125f,  0.1015625000000f,
+	 -0.0582275390625f,  0.0330810546875f, -0.0189208984375f},
+	{-0.0189208984375f,  0.0330810546875f, -0.0582275390625f,
+	  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+	  0.4650878906250f, -0.1665039062500f,  0.0891113281250f,
+	 -0.0517578125000f,  0.0292968750000f, -0.0291748046875f},
+	{-0.0083007812500f,  0.0148925781250f, -0.0266113281250f,
+	  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+	  0.1373291015625f, -0.0594482421875f,  0.0332031250000f,
+	 -0.0196533203125f,  0.0109863281250f,  0.0017089843750f}
+};
+
+struct biquad {
+	__m128 b0, b1, b2, a1, a2;
+};
+
+struct audio_loudness {
+	/* K-weighting: high shelf followed by a high pass, as transposed
+	 * direct form II, states per channel group */
+	struct biquad  shelf;
+	struct biquad  high_pass;
+	__m128         shelf_z[CHANNEL_GROUPS][2];
+	__m128         high_pass_z[CHANNEL_GROUPS][2];
+	__m128         block_sum[CHANNEL_GROUPS];
+	__m128         weights[CHANNEL_GROUPS];
+
+	/* true-peak filter taps, one lane per phase */
+	__m128         tp_taps[TP_TAPS];
+	float          tp_history[MAX_AUDIO_CHANNELS][TP_HISTORY];
+	float          tp_buf[TP_HISTORY + CHUNK_FRAMES];
+	float          true_peak[MAX_AUDIO_CHANNELS];
+	bool           oversample;
+
+	size_t         channels;
+	size_t         groups;
+	size_t         block_frames;
+	size_t         block_pos;
+
+	double         blocks[SHORT_TERM_BLOCKS];
+	size_t         block_idx;
+	uint64_t       block_count;
+
+	uint64_t       hist_count[HISTOGRAM_BINS];
+	double         hist_energy[HISTOGRAM_BINS];
+
+	float          silence[CHUNK_FRAMES];
+};
+
+static inline double energy_to_loudness(double energy)
+{
+	return energy > 0.0 ? -0.691 + 10.0 * log10(energy) : -INFINITY;
+}
+
+static void set_biquad(struct biquad *bq, double b0, double b1, double b2,
+		double a1, double a2)
+{
+	bq->b0 = _mm_set1_ps((float)b0);
+	bq->b1 = _mm_set1_ps((float)b1);
+	bq->b2 = _mm_set1_ps((float)b2);
+	bq->a1 = _mm_set1_ps((float)a1);
+	bq->a2 = _mm_set1_ps((float)a2);
+}
+
+/* the BS.1770 filters are specified at 48 kHz; these are the analog
+ * prototypes they were derived from, so they work at any sample rate */
+static void init_k_weighting(struct audio_loudness *al, double sample_rate)
+{
+	double f0 = 1681.974450955533;
+	double gain = 3.999843853973347;
+	double q = 0.7071752369554196;
+	double k = tan(M_PI * f0 / sample_rate);
+	double vh = pow(10.0, gain / 20.0);
+	double vb = pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+
+	set_biquad(&al->shelf,
+			(vh + vb * k / q + k * k) / a0,
+			2.0 * (k * k - vh) / a0,
+			(vh - vb * k / q + k * k) / a0,
+			2.0 * (k * k - 1.0) / a0,
+			(1.0 - k / q + k * k) / a0);
+
+	f0 = 38.13547087602444;
+	q = 0.5003270373238773;
+	k = tan(M_PI * f0 / sample_rate);
+	a0 = 1.0 + k / q + k * k;
+
+	set_biquad(&al->high_pass, 1.0, -2.0, 1.0,
+			2.0 * (k * k - 1.0) / a0,
+			(1.0 - k / q + k * k) / a0);
+}
+
+/* LFE is not measured, and surround channels are weighted by +1.5 dB */
+static void init_weights(struct audio_loudness *al,
+		enum speaker_layout speakers)
+{
+	float weights[MAX_AUDIO_CHANNELS] = {0};
+
+	for (size_t i = 0; i < al->channels; i++)
+		weights[i] = 1.0f;
+
+	switch (speakers) {
+	case SPEAKERS_2POINT1:
+		weights[2] = 0.0f;
+		break;
+	case SPEAKERS_4POINT0:
+		weights[3] = 1.41f;
+		break;
+	case SPEAKERS_4POINT1:
+		weights[3] = 0.0f;
+		weights[4] = 1.41f;
+		break;
+	case SPEAKERS_5POINT1:
+		weights[3] = 0.0f;
+		weights[4] = weights[5] = 1.41f;
+		break;
+	case SPEAKERS_7POINT1:
+		weights[3] = 0.0f;
+		weights[4] = weights[5] = weights[6] = weights[7] = 1.41f;
+		break;
+	default:
+		break;
+	}
+
+	for (size_t g = 0; g < CHANNEL_GROUPS; g++)
+		al->weights[g] = _mm_loadu_ps(weights + g * 4);
+}
+
+audio_loudness_t *audio_loudness_create(uint32_t sample_rate,
+		enum speaker_layout speakers)
+{
+	struct audio_loudness *al;
+	size_t channels = get_audio_channels(speakers);
+
+	if (!sample_rate || !channels || channels > MAX_AUDIO_CHANNELS)
+		return NULL;
+
+	al = bzalloc(sizeof(struct audio_loudness));
+	al->channels = channels;
+	al->groups = (channels + 3) / 4;
+	al->block_frames = sample_rate / 10;
+	al->oversample = sample_rate < 96000;
+
+	init_k_weighting(al, (double)sample_rate);
+	init_weights(al, speakers);
+
+	for (size_t k = 0; k < TP_TAPS; k++)
+		al->tp_taps[k] = _mm_setr_ps(tp_coefs[0][k], tp_coefs[1][k],
+				tp_coefs[2][k], tp_coefs[3][k]);
+
+	audio_loudness_reset(al);
+	return al;
+}
+
+void audio_loudness_destroy(audio_loudness_t *al)
+{
+	bfree(al);
+}
+
+void audio_loudness_reset(audio_loudness_t *al)
+{
+	if (!al)
+		return;
+
+	memset(al->shelf_z, 0, sizeof(al->shelf_z));
+	memset(al->high_pass_z, 0, sizeof(al->high_pass_z));
+	memset(al->block_sum, 0, sizeof(al->block_sum));
+	memset(al->tp_history, 0, sizeof(al->tp_history));
+	memset(al->true_peak, 0, sizeof(al->true_peak));
+	memset(al->blocks, 0, sizeof(al->blocks));
+	memset(al->hist_count, 0, sizeof(al->hist_count));
+	memset(al->hist_energy, 0, sizeof(al->hist_energy));
+
+	al->block_pos = 0;
+	al->block_idx = 0;
+	al->block_count = 0;
+}
+
+static inline __m128 biquad_run(const struct biquad *bq, __m128 z[2],
+		__m128 x)
+{
+	__m128 y = _mm_add_ps(_mm_mul_ps(bq->b0, x), z[0]);
+
+	z[0] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(bq->b1, x),
+				_mm_mul_ps(bq->a1, y)), z[1]);
+	z[1] = _mm_sub_ps(_mm_mul_ps(bq->b2, x), _mm_mul_ps(bq->a2, y));
+	return y;
+}
+
+/* filter states decay into denormals during silence, which are very slow to
+ * process, so they're flushed at the end of each block */
+static inline __m128 flush_denormal(__m128 v)
+{
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 min = _mm_set1_ps(1e-15f);
+
+	return _mm_and_ps(v, _mm_cmpge_ps(_mm_and_ps(v, abs_mask), min));
+}
+
+static void k_weight_chunk(struct audio_loudness *al,
+		const float *const data[], size_t offset, size_t frames)
+{
+	for (size_t g = 0; g < al->groups; g++) {
+		const float *src[4];
+		__m128 sum = al->block_sum[g];
+
+		for (size_t i = 0; i < 4; i++) {
+			size_t ch = g * 4 + i;
+			src[i] = (ch < al->channels && data[ch]) ?
+				data[ch] + offset : al->silence;
+		}
+
+		for (size_t i = 0; i < frames; i++) {
+			__m128 x = _mm_setr_ps(src[0][i], src[1][i],
+					src[2][i], src[3][i]);
+
+			x = biquad_run(&al->shelf, al->shelf_z[g], x);
+			x = biquad_run(&al->high_pass, al->high_pass_z[g], x);
+			sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+		}
+
+		al->block_sum[g] = sum;
+	}
+}
+
+static void true_peak_chunk(struct audio_loudness *al,
+		const float *const data[], size_t offset, size_t frames)
+{
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	for (size_t ch = 0; ch < al->channels; ch++) {
+		const float *src = data[ch] ? data[ch] + offset : al->silence;
+		float *buf = al->tp_buf;
+		__m128 peak4 = _mm_setzero_ps();
+		float peak[4];
+
+		if (!al->oversample) {
+			float max_val = al->true_peak[ch];
+			for (size_t i = 0; i < frames; i++)
+				max_val = fmaxf(max_val, fabsf(src[i]));
+			al->true_peak[ch] = max_val;
+			continue;
+		}
+
+		memcpy(buf, al->tp_history[ch], TP_HISTORY * sizeof(float));
+		memcpy(buf + TP_HISTORY, src, frames * sizeof(float));
+
+		/* each input sample produces all four phases at once */
+		for (size_t i = 0; i < frames; i++) {
+			const float *x = buf + i + TP_HISTORY;
+			__m128 acc = _mm_mul_ps(al->tp_taps[0],
+					_mm_set1_ps(x[0]));
+
+			for (size_t k = 1; k < TP_TAPS; k++)
+				acc = _mm_add_ps(acc, _mm_mul_ps(
+						al->tp_taps[k],
+						_mm_set1_ps(x[-(ptrdiff_t)k])));
+
+			peak4 = _mm_max_ps(peak4, _mm_and_ps(acc, abs_mask));
+		}
+
+		memcpy(al->tp_history[ch], buf + frames,
+				TP_HISTORY * sizeof(float));
+
+		_mm_storeu_ps(peak, peak4);
+		al->true_peak[ch] = fmaxf(al->true_peak[ch],
+				fmaxf(fmaxf(peak[0], peak[1]),
+				      fmaxf(peak[2], peak[3])));
+	}
+}
+
+static void add_gating_block(struct audio_loudness *al, double energy)
+{
+	double loudness = energy_to_loudness(energy);
+	int bin;
+
+	if (loudness <= ABSOLUTE_GATE)
+		return;
+
+	bin = (int)((loudness - HISTOGRAM_MIN) * 10.0);
+	if (bin >= HISTOGRAM_BINS)
+		bin = HISTOGRAM_BINS - 1;
+
+	al->hist_count[bin]++;
+	al->hist_energy[bin] += energy;
+}
+
+static double mean_of_last_blocks(const struct audio_loudness *al,
+		size_t count)
+{
+	double sum = 0.0;
+	size_t idx = al->block_idx;
+
+	for (size_t i = 0; i < count; i++) {
+		idx = (idx == 0) ? SHORT_TERM_BLOCKS - 1 : idx - 1;
+		sum += al->blocks[idx];
+	}
+
+	return sum / (double)count;
+}
+
+static void finish_block(struct audio_loudness *al)
+{
+	double energy = 0.0;
+
+	for (size_t g = 0; g < al->groups; g++) {
+		float sum[4];
+
+		_mm_storeu_ps(sum, _mm_mul_ps(al->block_sum[g],
+					al->weights[g]));
+		energy += (double)sum[0] + sum[1] + sum[2] + sum[3];
+
+		al->block_sum[g] = _mm_setzero_ps();
+		for (size_t i = 0; i < 2; i++) {
+			al->shelf_z[g][i] = flush_denormal(al->shelf_z[g][i]);
+			al->high_pass_z[g][i] =
+				flush_denormal(al->high_pass_z[g][i]);
+		}
+	}
+
+	al->blocks[al->block_idx] = energy / (double)al->block_frames;
+	al->block_idx = (al->block_idx + 1) % SHORT_TERM_BLOCKS;
+	al->block_count++;
+	al->block_pos = 0;
+
+	if (al->block_count >= MOMENTARY_BLOCKS)
+		add_gating_block(al, mean_of_last_blocks(al,
+					MOMENTARY_BLOCKS));
+}
+
+void audio_loudness_process(audio_loudness_t *al, const float *const data[],
+		size_t frames)
+{
+	size_t pos = 0;
+
+	if (!al || !data)
+		return;
+
+	while (pos < frames) {
+		size_t count = frames - pos;
+
+		if (count > CHUNK_FRAMES)
+			count = CHUNK_FRAMES;
+		if (count > al->block_frames - al->block_pos)
+			count = al->block_frames - al->block_pos;
+
+		k_weight_chunk(al, data, pos, count);
+		true_peak_chunk(al, data, pos, count);
+
+		pos += count;
+		al->block_pos += count;
+		if (al->block_pos == al->block_frames)
+			finish_block(al);
+	}
+}
+
+static double integrated_loudness(const struct audio_loudness *al)
+{
+	uint64_t count = 0;
+	double energy = 0.0;
+	double threshold;
+	int first_bin;
+
+	for (size_t i = 0; i < HISTOGRAM_BINS; i++) {
+		count += al->hist_count[i];
+		energy += al->hist_energy[i];
+	}
+
+	if (!count)
+		return -INFINITY;
+
+	threshold = energy_to_loudness(energy / (double)count) + RELATIVE_GATE;
+	first_bin = (int)((threshold - HISTOGRAM_MIN) * 10.0);
+	if (first_bin < 0)
+		first_bin = 0;
+
+	count = 0;
+	energy = 0.0;
+
+	for (size_t i = (size_t)first_bin; i < HISTOGRAM_BINS; i++) {
+		count += al->hist_count[i];
+		energy += al->hist_energy[i];
+	}
+
+	return count ? energy_to_loudness(energy / (double)count) : -INFINITY;
+}
+
+void audio_loudness_get_info(const audio_loudness_t *al,
+		struct audio_loudness_info *info)
+{
+	if (!info)
+		return;
+
+	info->momentary = -INFINITY;
+	info->short_term = -INFINITY;
+	info->integrated = -INFINITY;
+	info->max_true_peak = -INFINITY;
+	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++)
+		info->true_peak[i] = -INFINITY;
+
+	if (!al)
+		return;
+
+	if (al->block_count >= MOMENTARY_BLOCKS)
+		info->momentary = (float)energy_to_loudness(
+				mean_of_last_blocks(al, MOMENTARY_BLOCKS));
+	if (al->block_count >= SHORT_TERM_BLOCKS)
+		info->short_term = (float)energy_to_loudness(
+				mean_of_last_blocks(al, SHORT_TERM_BLOCKS));
+
+	info->integrated = (float)integrated_loudness(al);
+
+	for (size_t i = 0; i < al->channels; i++) {
+		info->true_peak[i] = mul_to_db(al->true_peak[i]);
+		if (info->true_peak[i] > info->max_true_peak)
+			info->max_true_peak = info->true_peak[i];
+	}
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Project contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+#include "audio-io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * ITU-R BS.1770 loudness and true-peak measurement.
+ *
+ * Audio is K-weighted and measured in 100 millisecond blocks, from which the
+ * momentary (400 ms), short-term (3 s) and gated integrated loudness are
+ * derived.  True-peak is measured with 4x oversampling below 96 kHz, and is
+ * the sample peak at higher rates.  Values that have not been measured yet,
+ * or that are silent, are -INFINITY.
+ */
+
+struct audio_loudness;
+typedef struct audio_loudness audio_loudness_t;
+
+struct audio_loudness_info {
+	float momentary;                      /**< LUFS */
+	float short_term;                     /**< LUFS */
+	float integrated;                     /**< LUFS, since reset */
+	float true_peak[MAX_AUDIO_CHANNELS];  /**< dBTP, since reset */
+	float max_true_peak;                  /**< dBTP, since reset */
+};
+
+EXPORT audio_loudness_t *audio_loudness_create(uint32_t sample_rate,
+		enum speaker_layout speakers);
+EXPORT void audio_loudness_destroy(audio_loudness_t *loudness);
+
+/** Clears all measurements, including the integrated loudness */
+EXPORT void audio_loudness_reset(audio_loudness_t *loudness);
+
+/** Measures a block of planar float audio */
+EXPORT void audio_loudness_process(audio_loudness_t *loudness,
+		const float *const data[], size_t frames);
+
+EXPORT void audio_loudness_get_info(const audio_loudness_t *loudness,
+		struct audio_loudness_info *info);
+
+#ifdef __cplusplus
+}
+#endif
@@ -19,6 +19,8 @@
 
 #include "../util/c99defs.h"
 #include <math.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
 
 #ifdef _MSC_VER
 #include <float.h>
@@ -38,6 +40,244 @@ static inline float db_to_mul(const float db)
 	return isfinite((double)db) ? powf(10.0f, db / 20.0f) : 0.0f;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Fast approximations for per-sample gain computation.
+ *
+ * fast_log2f splits x into 2^e * m with m in [sqrt(0.5), sqrt(2)) and
+ * evaluates log2(m) with an odd series in (m-1)/(m+1); the absolute error is
+ * below 1e-5 for any positive normal x.  Zero and denormals return about -127
+ * instead of -INFINITY.
+ *
+ * fast_exp2f splits x into an integer and a fraction in [-0.5, 0.5] and
+ * evaluates 2^f with a degree 6 polynomial; the relative error is below 1e-6.
+ * Input is clamped to [-126, 127], so very small results flush to about
+ * 1e-38 rather than zero.
+ *
+ * The block versions compute four values at a time and give the same
+ * results as the scalar versions. */
+
+#define AUDIO_MATH_LOG2_C1 2.8853900818f /* 2/ln(2)   */
+#define AUDIO_MATH_LOG2_C3 0.9617966939f /* 2/3ln(2)  */
+#define AUDIO_MATH_LOG2_C5 0.5770780164f /* 2/5ln(2)  */
+#define AUDIO_MATH_LOG2_C7 0.4121985831f /* 2/7ln(2)  */
+
+#define AUDIO_MATH_EXP2_C1 0.6931471806f
+#define AUDIO_MATH_EXP2_C2 0.2402265070f
+#define AUDIO_MATH_EXP2_C3 0.0555041087f
+#define AUDIO_MATH_EXP2_C4 0.0096181291f
+#define AUDIO_MATH_EXP2_C5 0.0013333558f
+#define AUDIO_MATH_EXP2_C6 0.0001540353f
+
+#define AUDIO_MATH_SQRT2     1.4142135624f
+#define AUDIO_MATH_DB_PER_L2 6.0205999133f /* 20*log10(2)   */
+#define AUDIO_MATH_L2_PER_DB 0.1660964047f /* log2(10)/20   */
+
+union audio_math_bits {
+	float f;
+	int32_t i;
+};
+
+static inline float fast_log2f(const float x)
+{
+	union audio_math_bits bits = {x};
+	int32_t e = ((bits.i >> 23) & 0xFF) - 127;
+	float m, y, y2;
+
+	bits.i = (bits.i & 0x7FFFFF) | 0x3F800000;
+	m = bits.f;
+	if (m > AUDIO_MATH_SQRT2) {
+		m *= 0.5f;
+		e++;
+	}
+
+	y  = (m - 1.0f) / (m + 1.0f);
+	y2 = y * y;
+
+	return (float)e + y * (AUDIO_MATH_LOG2_C1 + y2 * (AUDIO_MATH_LOG2_C3 +
+			y2 * (AUDIO_MATH_LOG2_C5 + y2 * AUDIO_MATH_LOG2_C7)));
+}
+
+static inline float fast_exp2f(float x)
+{
+	union audio_math_bits bits;
+	float i, f;
+
+	x = x < -126.0f ? -126.0f : (x > 127.0f ? 127.0f : x);
+	i = floorf(x + 0.5f);
+	f = x - i;
+
+	bits.i = ((int32_t)i + 127) << 23;
+
+	return bits.f * (1.0f + f * (AUDIO_MATH_EXP2_C1 +
+			f * (AUDIO_MATH_EXP2_C2 + f * (AUDIO_MATH_EXP2_C3 +
+			f * (AUDIO_MATH_EXP2_C4 + f * (AUDIO_MATH_EXP2_C5 +
+			f * AUDIO_MATH_EXP2_C6))))));
+}
+
+static inline float fast_mul_to_db(const float mul)
+{
+	return AUDIO_MATH_DB_PER_L2 * fast_log2f(mul);
+}
+
+static inline float fast_db_to_mul(const float db)
+{
+	return fast_exp2f(db * AUDIO_MATH_L2_PER_DB);
+}
+
+static inline __m128 fast_log2_ps(__m128 x)
+{
+	const __m128i mant_mask = _mm_set1_epi32(0x7FFFFF);
+	const __m128i one_bits  = _mm_set1_epi32(0x3F800000);
+	const __m128  one       = _mm_set1_ps(1.0f);
+	__m128i bits = _mm_castps_si128(x);
+	__m128i e    = _mm_sub_epi32(
+			_mm_and_si128(_mm_srli_epi32(bits, 23),
+				_mm_set1_epi32(0xFF)),
+			_mm_set1_epi32(127));
+	__m128  m    = _mm_castsi128_ps(_mm_or_si128(
+			_mm_and_si128(bits, mant_mask), one_bits));
+	__m128  big  = _mm_cmpgt_ps(m, _mm_set1_ps(AUDIO_MATH_SQRT2));
+	__m128  y, y2, p;
+
+	m = _mm_mul_ps(m, _mm_or_ps(_mm_and_ps(big, _mm_set1_ps(0.5f)),
+				_mm_andnot_ps(big, one)));
+	e = _mm_sub_epi32(e, _mm_castps_si128(big)); /* mask is -1 */
+
+	y  = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+	y2 = _mm_mul_ps(y, y);
+
+	p = _mm_add_ps(_mm_set1_ps(AUDIO_MATH_LOG2_C5),
+			_mm_mul_ps(y2, _mm_set1_ps(AUDIO_MATH_LOG2_C7)));
+	p = _mm_add_ps(_mm_set1_ps(AUDIO_MATH_LOG2_C3), _mm_mul_ps(y2, p));
+	p = _mm_add_ps(_mm_set1_ps(AUDIO_MATH_LOG2_C1), _mm_mul_ps(y2, p));
+
+	return _mm_add_ps(_mm_cvtepi32_ps(e), _mm_mul_ps(y, p));
+}
+
+static inline __m128 fast_exp2_ps(__m128 x)
+{
+	__m128 i, f, p;
+	__m128i ii;
+
+	x  = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)),
+			_mm_set1_ps(127.0f));
+
+	/* truncate x + 0.5 towards negative infinity */
+	i  = _mm_add_ps(x, _mm_set1_ps(0.5f));
+	ii = _mm_cvttps_epi32(i);
+	ii = _mm_add_epi32(ii, _mm_castps_si128(
+			_mm_cmplt_ps(i, _mm_cvtepi32_ps(ii))));
+	f  = _mm_sub_ps(x, _mm_cvtepi32_ps(ii));
+
+	p = _mm_add_ps(_mm_set1_ps(AUDIO_MATH_EXP2_C5),
+			_mm_mul_ps(f, _mm_set1_ps(AUDIO_MATH_EXP2_C6)));
+	p = _mm_add_ps(_mm_set1_ps(AUDIO_MATH_EXP2_C4), _mm_mul_ps(f, p));
+	p = _mm_add_ps(_mm_set1_ps(AUDIO_MATH_EXP2_C3), _mm_mul_ps(f, p));
+	p = _mm_add_ps(_mm_set1_ps(AUDIO_MATH_EXP2_C2), _mm_mul_ps(f, p));
+	p = _mm_add_ps(_mm_set1_ps(AUDIO_MATH_EXP2_C1), _mm_mul_ps(f, p));
+	p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(f, p));
+
+	ii = _mm_slli_epi32(_mm_add_epi32(ii, _mm_set1_epi32(127)), 23);
+	return _mm_mul_ps(_mm_castsi128_ps(ii), p);
+}
+
+/** Converts a block of linear values to dB, dst may equal src */
+static inline void audio_block_mul_to_db(float *dst, const float *src,
+		size_t count)
+{
+	const __m128 scale = _mm_set1_ps(AUDIO_MATH_DB_PER_L2);
+	const size_t block_count = count & ~(size_t)3;
+	size_t i = 0;
+
+	for (; i < block_count; i += 4) {
+		__m128 v = fast_log2_ps(_mm_loadu_ps(src + i));
+		_mm_storeu_ps(dst + i, _mm_mul_ps(v, scale));
+	}
+	for (; i < count; i++)
+		dst[i] = fast_mul_to_db(src[i]);
+}
+
+/** Converts a block of dB values to linear, dst may equal src */
+static inline void audio_block_db_to_mul(float *dst, const float *src,
+		size_t count)
+{
+	const __m128 scale = _mm_set1_ps(AUDIO_MATH_L2_PER_DB);
+	const size_t block_count = count & ~(size_t)3;
+	size_t i = 0;
+
+	for (; i < block_count; i += 4) {
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+		_mm_storeu_ps(dst + i, fast_exp2_ps(v));
+	}
+	for (; i < count; i++)
+		dst[i] = fast_db_to_mul(src[i]);
+}
+
+/** Raises each value of dst to the absolute value of src if it is larger */
+static inline void audio_block_abs_max(float *dst, const float *src,
+		size_t count)
+{
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const size_t block_count = count & ~(size_t)3;
+	size_t i = 0;
+
+	for (; i < block_count; i += 4) {
+		__m128 v = _mm_and_ps(_mm_loadu_ps(src + i), abs_mask);
+		_mm_storeu_ps(dst + i, _mm_max_ps(_mm_loadu_ps(dst + i), v));
+	}
+	for (; i < count; i++)
+		dst[i] = fmaxf(dst[i], fabsf(src[i]));
+}
+
+/** Multiplies a block of samples by a block of gains */
+static inline void audio_block_mul(float *samples, const float *gains,
+		size_t count)
+{
+	const size_t block_count = count & ~(size_t)3;
+	size_t i = 0;
+
+	for (; i < block_count; i += 4) {
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(samples + i),
+				_mm_loadu_ps(gains + i));
+		_mm_storeu_ps(samples + i, v);
+	}
+	for (; i < count; i++)
+		samples[i] *= gains[i];
+}
+
+/** Returns the largest absolute value in a block of samples, and stores the
+ * sum of their squares in sum_sq */
+static inline float audio_block_peak_sum_sq(const float *src, size_t count,
+		float *sum_sq)
+{
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const size_t block_count = count & ~(size_t)3;
+	__m128 peak4 = _mm_setzero_ps();
+	__m128 sum4 = _mm_setzero_ps();
+	float peak, sum;
+	float p[4], s[4];
+	size_t i = 0;
+
+	for (; i < block_count; i += 4) {
+		__m128 v = _mm_loadu_ps(src + i);
+		peak4 = _mm_max_ps(peak4, _mm_and_ps(v, abs_mask));
+		sum4 = _mm_add_ps(sum4, _mm_mul_ps(v, v));
+	}
+
+	_mm_storeu_ps(p, peak4);
+	_mm_storeu_ps(s, sum4);
+	peak = fmaxf(fmaxf(p[0], p[1]), fmaxf(p[2], p[3]));
+	sum = (s[0] + s[1]) + (s[2] + s[3]);
+
+	for (; i < count; i++) {
+		peak = fmaxf(peak, fabsf(src[i]));
+		sum += src[i] * src[i];
+	}
+
+	*sum_sq = sum;
+	return peak;
+}
+
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
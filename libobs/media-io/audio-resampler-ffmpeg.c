@@ -15,6 +15,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <math.h>
+
 #include "../util/bmem.h"
 #include "audio-resampler.h"
 #include "audio-io.h"
@@ -22,17 +24,27 @@
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
+/* when the rate and speaker layout don't change, the audio only needs its
+ * sample format converted, which is done directly instead of by swresample */
+
+/* output buffers are allocated up front for input packets of up to this many
+ * frames, so they normally never grow while audio is running */
+#define PREALLOC_FRAMES (AUDIO_OUTPUT_FRAMES * 4)
+
 struct audio_resampler {
 	struct SwrContext   *context;
 	bool                opened;
+	bool                format_only;
 
 	uint32_t            input_freq;
 	uint64_t            input_layout;
 	enum AVSampleFormat input_format;
+	enum audio_format   input_audio_format;
 
 	uint8_t             *output_buffer[MAX_AV_PLANES];
 	uint64_t            output_layout;
 	enum AVSampleFormat output_format;
+	enum audio_format   output_audio_format;
 	int                 output_size;
 	uint32_t            output_ch;
 	uint32_t            output_freq;
@@ -74,6 +86,28 @@ static inline uint64_t convert_speaker_layout(enum speaker_layout layout)
 	return 0;
 }
 
+static bool ensure_output_size(struct audio_resampler *rs, int frames)
+{
+	if (frames <= rs->output_size)
+		return true;
+
+	/* grow with some headroom so that slowly growing input sizes don't
+	 * cause a reallocation every time */
+	frames += frames / 2;
+
+	if (rs->output_buffer[0])
+		av_freep(&rs->output_buffer[0]);
+
+	if (av_samples_alloc(rs->output_buffer, NULL, rs->output_ch,
+				frames, rs->output_format, 0) < 0) {
+		rs->output_size = 0;
+		return false;
+	}
+
+	rs->output_size = frames;
+	return true;
+}
+
 audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 		const struct resample_info *src)
 {
@@ -84,13 +118,32 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	rs->input_freq    = src->samples_per_sec;
 	rs->input_layout  = convert_speaker_layout(src->speakers);
 	rs->input_format  = convert_audio_format(src->format);
+	rs->input_audio_format = src->format;
 	rs->output_size   = 0;
 	rs->output_ch     = get_audio_channels(dst->speakers);
 	rs->output_freq   = dst->samples_per_sec;
 	rs->output_layout = convert_speaker_layout(dst->speakers);
 	rs->output_format = convert_audio_format(dst->format);
+	rs->output_audio_format = dst->format;
 	rs->output_planes = is_audio_planar(dst->format) ? rs->output_ch : 1;
 
+	rs->format_only =
+		src->samples_per_sec == dst->samples_per_sec &&
+		src->speakers        == dst->speakers        &&
+		src->format != AUDIO_FORMAT_UNKNOWN          &&
+		dst->format != AUDIO_FORMAT_UNKNOWN;
+
+	if (!ensure_output_size(rs, (int)av_rescale_rnd(PREALLOC_FRAMES,
+				rs->output_freq, rs->input_freq,
+				AV_ROUND_UP))) {
+		blog(LOG_ERROR, "av_samples_alloc failed");
+		audio_resampler_destroy(rs);
+		return NULL;
+	}
+
+	if (rs->format_only)
+		return rs;
+
 	rs->context = swr_alloc_set_opts(NULL,
 		rs->output_layout, rs->output_format, dst->samples_per_sec,
 		rs->input_layout,  rs->input_format,  src->samples_per_sec,
@@ -125,6 +178,156 @@ void audio_resampler_destroy(audio_resampler_t *rs)
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* format only conversion                                                    */
+
+static inline enum audio_format packed_format(enum audio_format format)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT_PLANAR: return AUDIO_FORMAT_U8BIT;
+	case AUDIO_FORMAT_16BIT_PLANAR: return AUDIO_FORMAT_16BIT;
+	case AUDIO_FORMAT_32BIT_PLANAR: return AUDIO_FORMAT_32BIT;
+	case AUDIO_FORMAT_FLOAT_PLANAR: return AUDIO_FORMAT_FLOAT;
+	default:                        return format;
+	}
+}
+
+/* these match the conversions done by swresample: integer formats are
+ * converted to each other by shifting, without rounding, and to and from
+ * float by scaling */
+static inline bool is_int_format(enum audio_format format)
+{
+	return format == AUDIO_FORMAT_U8BIT ||
+	       format == AUDIO_FORMAT_16BIT ||
+	       format == AUDIO_FORMAT_32BIT;
+}
+
+static inline int32_t read_int_sample(enum audio_format format,
+		const uint8_t *ptr)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+		return (int32_t)((uint32_t)((int)*ptr - 0x80) << 24);
+	case AUDIO_FORMAT_16BIT:
+		return (int32_t)((uint32_t)*(const int16_t*)ptr << 16);
+	default:
+		return *(const int32_t*)ptr;
+	}
+}
+
+static inline void write_int_sample(enum audio_format format, uint8_t *ptr,
+		int32_t val)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+		*ptr = (uint8_t)((val >> 24) + 0x80);
+		break;
+	case AUDIO_FORMAT_16BIT:
+		*(int16_t*)ptr = (int16_t)(val >> 16);
+		break;
+	default:
+		*(int32_t*)ptr = val;
+	}
+}
+
+static inline float read_sample(enum audio_format format, const uint8_t *ptr)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+		return (float)((int)*ptr - 0x80) * (1.0f / 128.0f);
+	case AUDIO_FORMAT_16BIT:
+		return (float)*(const int16_t*)ptr * (1.0f / 32768.0f);
+	case AUDIO_FORMAT_32BIT:
+		return (float)((double)*(const int32_t*)ptr *
+				(1.0 / 2147483648.0));
+	default:
+		return *(const float*)ptr;
+	}
+}
+
+static inline void write_sample(enum audio_format format, uint8_t *ptr,
+		float val)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+		*ptr = (uint8_t)av_clip_uint8((int)lrintf(val * 128.0f) + 0x80);
+		break;
+	case AUDIO_FORMAT_16BIT:
+		*(int16_t*)ptr = (int16_t)av_clip_int16(
+				(int)lrintf(val * 32768.0f));
+		break;
+	case AUDIO_FORMAT_32BIT:
+		*(int32_t*)ptr = (int32_t)av_clipl_int32(
+				llrint((double)val * 2147483648.0));
+		break;
+	default:
+		*(float*)ptr = val;
+	}
+}
+
+static void convert_channel(uint8_t *dst, size_t dst_stride,
+		enum audio_format dst_format,
+		const uint8_t *src, size_t src_stride,
+		enum audio_format src_format, uint32_t frames)
+{
+	/* only the layout changes, so samples are copied as they are */
+	if (src_format == dst_format) {
+		size_t size = get_audio_bytes_per_channel(src_format);
+
+		if (size == 4) {
+			for (uint32_t i = 0; i < frames; i++)
+				*(uint32_t*)(dst + i * dst_stride) =
+					*(const uint32_t*)(src + i * src_stride);
+		} else if (size == 2) {
+			for (uint32_t i = 0; i < frames; i++)
+				*(uint16_t*)(dst + i * dst_stride) =
+					*(const uint16_t*)(src + i * src_stride);
+		} else {
+			for (uint32_t i = 0; i < frames; i++)
+				dst[i * dst_stride] = src[i * src_stride];
+		}
+		return;
+	}
+
+	if (is_int_format(src_format) && is_int_format(dst_format)) {
+		for (uint32_t i = 0; i < frames; i++)
+			write_int_sample(dst_format, dst + i * dst_stride,
+					read_int_sample(src_format,
+						src + i * src_stride));
+		return;
+	}
+
+	for (uint32_t i = 0; i < frames; i++)
+		write_sample(dst_format, dst + i * dst_stride,
+				read_sample(src_format, src + i * src_stride));
+}
+
+static void convert_format(struct audio_resampler *rs,
+		const uint8_t *const input[], uint32_t frames)
+{
+	enum audio_format src_format = packed_format(rs->input_audio_format);
+	enum audio_format dst_format = packed_format(rs->output_audio_format);
+	bool src_planar = is_audio_planar(rs->input_audio_format);
+	bool dst_planar = is_audio_planar(rs->output_audio_format);
+	size_t src_size = get_audio_bytes_per_channel(src_format);
+	size_t dst_size = get_audio_bytes_per_channel(dst_format);
+	size_t src_stride = src_planar ? src_size : src_size * rs->output_ch;
+	size_t dst_stride = dst_planar ? dst_size : dst_size * rs->output_ch;
+
+	for (uint32_t ch = 0; ch < rs->output_ch; ch++) {
+		const uint8_t *src = src_planar ?
+			input[ch] : input[0] + ch * src_size;
+		uint8_t *dst = dst_planar ?
+			rs->output_buffer[ch] :
+			rs->output_buffer[0] + ch * dst_size;
+
+		convert_channel(dst, dst_stride, dst_format,
+				src, src_stride, src_format, frames);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
 bool audio_resampler_resample(audio_resampler_t *rs,
 		 uint8_t *output[], uint32_t *out_frames, uint64_t *ts_offset,
 		 const uint8_t *const input[], uint32_t in_frames)
@@ -132,25 +335,38 @@ bool audio_resampler_resample(audio_resampler_t *rs,
 	if (!rs) return false;
 
 	struct SwrContext *context = rs->context;
+	int64_t delay_ns;
+	int64_t delay;
+	int estimated;
 	int ret;
 
-	int64_t delay = swr_get_delay(context, rs->input_freq);
-	int estimated = (int)av_rescale_rnd(
+	if (rs->format_only) {
+		if (!ensure_output_size(rs, (int)in_frames))
+			return false;
+
+		convert_format(rs, input, in_frames);
+
+		for (uint32_t i = 0; i < rs->output_planes; i++)
+			output[i] = rs->output_buffer[i];
+
+		*out_frames = in_frames;
+		*ts_offset = 0;
+		return true;
+	}
+
+	delay_ns = swr_get_delay(context, 1000000000);
+	delay = av_rescale_rnd(delay_ns, (int64_t)rs->input_freq, 1000000000,
+			AV_ROUND_UP);
+	estimated = (int)av_rescale_rnd(
 			delay + (int64_t)in_frames,
 			(int64_t)rs->output_freq, (int64_t)rs->input_freq,
 			AV_ROUND_UP);
 
-	*ts_offset = (uint64_t)swr_get_delay(context, 1000000000);
+	*ts_offset = (uint64_t)delay_ns;
 
-	/* resize the buffer if bigger */
-	if (estimated > rs->output_size) {
-		if (rs->output_buffer[0])
-			av_freep(&rs->output_buffer[0]);
-
-		av_samples_alloc(rs->output_buffer, NULL, rs->output_ch,
-				estimated, rs->output_format, 0);
-
-		rs->output_size = estimated;
+	if (!ensure_output_size(rs, estimated)) {
+		blog(LOG_ERROR, "av_samples_alloc failed");
+		return false;
 	}
 
 	ret = swr_convert(context,
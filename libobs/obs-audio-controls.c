@@ -61,21 +61,96 @@ struct meter_cb {
 	void                   *param;
 };
 
+/*
+ * Levels are accumulated on the audio thread without taking any locks: the
+ * floats are stored as their bit patterns in atomic longs.  The publisher
+ * thread takes the accumulated values at each meter's update interval and
+ * calls the level callbacks from there, so the audio thread never runs UI
+ * callbacks.  Frames and sums are exchanged separately, so at worst one packet
+ * is attributed to the neighbouring update.
+ */
 struct obs_volmeter {
 	pthread_mutex_t        mutex;
 	obs_source_t           *source;
 	enum obs_fader_type    type;
-	float                  cur_db;
 
 	pthread_mutex_t        callback_mutex;
 	DARRAY(struct meter_cb)callbacks;
 
 	unsigned int           update_ms;
-
-	float                  vol_magnitude[MAX_AUDIO_CHANNELS];
-	float                  vol_peak[MAX_AUDIO_CHANNELS];
+	uint64_t               next_update_ns;
+
+	volatile long          vol_mul;
+	volatile bool          muted;
+	volatile long          channels;
+	volatile long          frames;
+	volatile long          peak[MAX_AUDIO_CHANNELS];
+	volatile long          sum_sq[MAX_AUDIO_CHANNELS];
 };
 
+/* all volmeters publish their levels from one shared thread, which runs while
+ * any volmeter exists */
+#define VOLMETER_PUBLISH_TICK_MS 10
+
+static pthread_mutex_t publisher_start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t publisher_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct obs_volmeter*) publisher_volmeters;
+static os_event_t *publisher_stop_event = NULL;
+static pthread_t publisher_thread;
+static bool publisher_active = false;
+
+static inline long float_to_bits(float val)
+{
+	union {float f; int32_t i;} u;
+	u.f = val;
+	return (long)u.i;
+}
+
+static inline float bits_to_float(long bits)
+{
+	union {float f; int32_t i;} u;
+	u.i = (int32_t)bits;
+	return u.f;
+}
+
+static inline void atomic_set_float(volatile long *ptr, float val)
+{
+	os_atomic_set_long(ptr, float_to_bits(val));
+}
+
+static inline float atomic_load_float(const volatile long *ptr)
+{
+	return bits_to_float(os_atomic_load_long(ptr));
+}
+
+static inline float atomic_take_float(volatile long *ptr)
+{
+	return bits_to_float(os_atomic_set_long(ptr, float_to_bits(0.0f)));
+}
+
+/* only for positive values, whose bit patterns order the same as the values */
+static inline void atomic_max_float(volatile long *ptr, float val)
+{
+	long new_bits = float_to_bits(val);
+	long old_bits;
+
+	do {
+		old_bits = os_atomic_load_long(ptr);
+		if (new_bits <= old_bits)
+			return;
+	} while (!os_atomic_compare_swap_long(ptr, old_bits, new_bits));
+}
+
+static inline void atomic_add_float(volatile long *ptr, float val)
+{
+	long old_bits;
+
+	do {
+		old_bits = os_atomic_load_long(ptr);
+	} while (!os_atomic_compare_swap_long(ptr, old_bits,
+			float_to_bits(bits_to_float(old_bits) + val)));
+}
+
 static float cubic_def_to_db(const float def)
 {
 	if (def == 1.0f)
@@ -232,12 +307,8 @@ static void volmeter_source_volume_changed(void *vptr, calldata_t *calldata)
 {
 	struct obs_volmeter *volmeter = (struct obs_volmeter *) vptr;
 
-	pthread_mutex_lock(&volmeter->mutex);
-
 	float mul = (float) calldata_float(calldata, "volume");
-	volmeter->cur_db = mul_to_db(mul);
-
-	pthread_mutex_unlock(&volmeter->mutex);
+	atomic_set_float(&volmeter->vol_mul, mul);
 }
 
 static void fader_source_destroyed(void *vptr, calldata_t *calldata)
@@ -256,82 +327,170 @@ static void volmeter_source_destroyed(void *vptr, calldata_t *calldata)
 	obs_volmeter_detach_source(volmeter);
 }
 
-static void volmeter_process_audio_data(obs_volmeter_t *volmeter,
-		const struct audio_data *data)
+static void volmeter_source_data_received(void *vptr, obs_source_t *source,
+		const struct audio_data *data, bool muted)
 {
-	int nr_samples = data->frames;
-	int channel_nr = 0;
+	struct obs_volmeter *volmeter = (struct obs_volmeter *) vptr;
+	long channel_nr = 0;
 
+	// For each plane calculate:
+	// * peak = the maximum-absolute of the sample values.
+	// * sum of squares, from which the publisher calculates the
+	//      root-mean-square magnitude over its whole update interval.
 	for (size_t plane_nr = 0; plane_nr < MAX_AV_PLANES; plane_nr++) {
-		float *samples = (float *)data->data[plane_nr];
+		const float *samples = (const float *)data->data[plane_nr];
+		float peak, sum_sq;
+
 		if (!samples) {
 			// This plane does not contain data.
 			continue;
 		}
+		if (channel_nr == MAX_AUDIO_CHANNELS)
+			break;
 
-		// For each plane calculate:
-		// * peak = the maximum-absolute of the sample values.
-		// * magnitude = root-mean-square of the sample values.
-		//      A VU meter needs to integrate over 300ms, but this will
-		//	be handled by the ballistics of the meter itself,
-		//	reality. Which makes this calculation independent of
-		//	sample rate or update rate.
-		float peak = 0.0;
-		float sum_of_squares = 0.0;
-		for (int sample_nr = 0; sample_nr < nr_samples; sample_nr++) {
-			float sample = samples[sample_nr];
-
-			peak = fmaxf(peak, fabsf(sample));
-			sum_of_squares += (sample * sample);
-		}
+		peak = audio_block_peak_sum_sq(samples, data->frames, &sum_sq);
 
-		volmeter->vol_magnitude[channel_nr] = sqrtf(sum_of_squares /
-			nr_samples);
-		volmeter->vol_peak[channel_nr] = peak;
+		atomic_max_float(&volmeter->peak[channel_nr], peak);
+		atomic_add_float(&volmeter->sum_sq[channel_nr], sum_sq);
 		channel_nr++;
 	}
 
-	// Clear audio channels that are not in use.
-	for (; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++) {
-		volmeter->vol_magnitude[channel_nr] = 0.0;
-		volmeter->vol_peak[channel_nr] = 0.0;
-	}
+	os_atomic_set_long(&volmeter->channels, channel_nr);
+	os_atomic_set_bool(&volmeter->muted, muted);
+	os_atomic_add_long(&volmeter->frames, (long)data->frames);
+
+	UNUSED_PARAMETER(source);
 }
 
-static void volmeter_source_data_received(void *vptr, obs_source_t *source,
-		const struct audio_data *data, bool muted)
+static void volmeter_publish(struct obs_volmeter *volmeter)
 {
-	struct obs_volmeter *volmeter = (struct obs_volmeter *) vptr;
-	float mul;
 	float magnitude[MAX_AUDIO_CHANNELS];
 	float peak[MAX_AUDIO_CHANNELS];
 	float input_peak[MAX_AUDIO_CHANNELS];
+	long frames;
+	long channels;
+	float mul;
 
-	pthread_mutex_lock(&volmeter->mutex);
+	frames = os_atomic_set_long(&volmeter->frames, 0);
+	if (!frames)
+		return;
 
-	volmeter_process_audio_data(volmeter, data);
+	channels = os_atomic_load_long(&volmeter->channels);
+	mul = os_atomic_load_bool(&volmeter->muted) ?
+		0.0f : atomic_load_float(&volmeter->vol_mul);
 
 	// Adjust magnitude/peak based on the volume level set by the user.
 	// And convert to dB.
-	mul = muted ? 0.0f : db_to_mul(volmeter->cur_db);
-	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS;
-		channel_nr++) {
-		magnitude[channel_nr] = mul_to_db(
-			volmeter->vol_magnitude[channel_nr] * mul);
-		peak[channel_nr] = mul_to_db(
-			volmeter->vol_peak[channel_nr] * mul);
-		input_peak[channel_nr] = mul_to_db(
-			volmeter->vol_peak[channel_nr]);
-	}
-
 	// The input-peak is NOT adjusted with volume, so that the user
 	// can check the input-gain.
+	for (long channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS;
+		channel_nr++) {
+		float ch_peak = atomic_take_float(&volmeter->peak[channel_nr]);
+		float ch_sum = atomic_take_float(&volmeter->sum_sq[channel_nr]);
+		float ch_magnitude = sqrtf(ch_sum / (float)frames);
 
-	pthread_mutex_unlock(&volmeter->mutex);
+		// Clear audio channels that are not in use.
+		if (channel_nr >= channels)
+			ch_peak = ch_magnitude = 0.0f;
+
+		magnitude[channel_nr] = mul_to_db(ch_magnitude * mul);
+		peak[channel_nr] = mul_to_db(ch_peak * mul);
+		input_peak[channel_nr] = mul_to_db(ch_peak);
+	}
 
 	signal_levels_updated(volmeter, magnitude, peak, input_peak);
+}
 
-	UNUSED_PARAMETER(source);
+static void *volmeter_publisher_thread(void *unused)
+{
+	os_set_thread_name("obs volmeter publisher");
+
+	while (os_event_timedwait(publisher_stop_event,
+				VOLMETER_PUBLISH_TICK_MS) == ETIMEDOUT) {
+		uint64_t now = os_gettime_ns();
+
+		pthread_mutex_lock(&publisher_mutex);
+
+		for (size_t i = 0; i < publisher_volmeters.num; i++) {
+			struct obs_volmeter *volmeter =
+				publisher_volmeters.array[i];
+			unsigned int update_ms;
+
+			if (now < volmeter->next_update_ns)
+				continue;
+
+			pthread_mutex_lock(&volmeter->mutex);
+			update_ms = volmeter->update_ms;
+			pthread_mutex_unlock(&volmeter->mutex);
+
+			volmeter->next_update_ns = now +
+				(uint64_t)update_ms * 1000000ULL;
+			volmeter_publish(volmeter);
+		}
+
+		pthread_mutex_unlock(&publisher_mutex);
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+static bool volmeter_publisher_add(struct obs_volmeter *volmeter)
+{
+	bool success = true;
+
+	pthread_mutex_lock(&publisher_start_mutex);
+
+	if (!publisher_active) {
+		if (os_event_init(&publisher_stop_event,
+					OS_EVENT_TYPE_MANUAL) != 0) {
+			success = false;
+			goto exit;
+		}
+
+		if (pthread_create(&publisher_thread, NULL,
+					volmeter_publisher_thread, NULL) != 0) {
+			blog(LOG_ERROR, "Failed to create volmeter publisher "
+			                "thread");
+			os_event_destroy(publisher_stop_event);
+			publisher_stop_event = NULL;
+			success = false;
+			goto exit;
+		}
+
+		publisher_active = true;
+	}
+
+	pthread_mutex_lock(&publisher_mutex);
+	da_push_back(publisher_volmeters, &volmeter);
+	pthread_mutex_unlock(&publisher_mutex);
+
+exit:
+	pthread_mutex_unlock(&publisher_start_mutex);
+	return success;
+}
+
+static void volmeter_publisher_remove(struct obs_volmeter *volmeter)
+{
+	bool stop;
+
+	pthread_mutex_lock(&publisher_start_mutex);
+
+	pthread_mutex_lock(&publisher_mutex);
+	da_erase_item(publisher_volmeters, &volmeter);
+	stop = publisher_active && !publisher_volmeters.num;
+	pthread_mutex_unlock(&publisher_mutex);
+
+	if (stop) {
+		os_event_signal(publisher_stop_event);
+		pthread_join(publisher_thread, NULL);
+		os_event_destroy(publisher_stop_event);
+		publisher_stop_event = NULL;
+		da_free(publisher_volmeters);
+		publisher_active = false;
+	}
+
+	pthread_mutex_unlock(&publisher_start_mutex);
 }
 
 obs_fader_t *obs_fader_create(enum obs_fader_type type)
@@ -565,9 +724,13 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 		goto fail;
 
 	volmeter->type = type;
+	atomic_set_float(&volmeter->vol_mul, 1.0f);
 
 	obs_volmeter_set_update_interval(volmeter, 50);
 
+	if (!volmeter_publisher_add(volmeter))
+		goto fail;
+
 	return volmeter;
 fail:
 	obs_volmeter_destroy(volmeter);
@@ -580,6 +743,7 @@ void obs_volmeter_destroy(obs_volmeter_t *volmeter)
 		return;
 
 	obs_volmeter_detach_source(volmeter);
+	volmeter_publisher_remove(volmeter);
 	da_free(volmeter->callbacks);
 	pthread_mutex_destroy(&volmeter->callback_mutex);
 	pthread_mutex_destroy(&volmeter->mutex);
@@ -607,12 +771,11 @@ bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 	vol = obs_source_get_volume(source);
 
 	pthread_mutex_lock(&volmeter->mutex);
-
 	volmeter->source = source;
-	volmeter->cur_db = mul_to_db(vol);
-
 	pthread_mutex_unlock(&volmeter->mutex);
 
+	atomic_set_float(&volmeter->vol_mul, vol);
+
 	return true;
 }
 
@@ -712,3 +875,193 @@ void obs_volmeter_remove_callback(obs_volmeter_t *volmeter,
 	pthread_mutex_unlock(&volmeter->callback_mutex);
 }
 
+
+struct obs_loudness {
+	pthread_mutex_t        mutex;
+	audio_loudness_t       *engine;
+	obs_source_t           *source;
+	size_t                 mix_idx;
+	bool                   mix_attached;
+};
+
+static void loudness_source_destroyed(void *vptr, calldata_t *calldata)
+{
+	UNUSED_PARAMETER(calldata);
+	struct obs_loudness *loudness = (struct obs_loudness *) vptr;
+
+	obs_loudness_detach(loudness);
+}
+
+static void loudness_source_data_received(void *vptr, obs_source_t *source,
+		const struct audio_data *data, bool muted)
+{
+	struct obs_loudness *loudness = (struct obs_loudness *) vptr;
+
+	pthread_mutex_lock(&loudness->mutex);
+	audio_loudness_process(loudness->engine,
+			(const float *const *)data->data, data->frames);
+	pthread_mutex_unlock(&loudness->mutex);
+
+	UNUSED_PARAMETER(source);
+	UNUSED_PARAMETER(muted);
+}
+
+static void loudness_mix_data_received(void *param, size_t mix_idx,
+		struct audio_data *data)
+{
+	struct obs_loudness *loudness = (struct obs_loudness *) param;
+
+	pthread_mutex_lock(&loudness->mutex);
+	audio_loudness_process(loudness->engine,
+			(const float *const *)data->data, data->frames);
+	pthread_mutex_unlock(&loudness->mutex);
+
+	UNUSED_PARAMETER(mix_idx);
+}
+
+static bool loudness_create_engine(struct obs_loudness *loudness)
+{
+	struct obs_audio_info oai;
+	audio_loudness_t *engine;
+
+	if (!obs_get_audio_info(&oai))
+		return false;
+
+	engine = audio_loudness_create(oai.samples_per_sec, oai.speakers);
+	if (!engine)
+		return false;
+
+	pthread_mutex_lock(&loudness->mutex);
+	audio_loudness_destroy(loudness->engine);
+	loudness->engine = engine;
+	pthread_mutex_unlock(&loudness->mutex);
+	return true;
+}
+
+obs_loudness_t *obs_loudness_create(void)
+{
+	struct obs_loudness *loudness = bzalloc(sizeof(struct obs_loudness));
+
+	pthread_mutex_init_value(&loudness->mutex);
+	if (pthread_mutex_init(&loudness->mutex, NULL) != 0) {
+		bfree(loudness);
+		return NULL;
+	}
+
+	return loudness;
+}
+
+void obs_loudness_destroy(obs_loudness_t *loudness)
+{
+	if (!loudness)
+		return;
+
+	obs_loudness_detach(loudness);
+	audio_loudness_destroy(loudness->engine);
+	pthread_mutex_destroy(&loudness->mutex);
+	bfree(loudness);
+}
+
+bool obs_loudness_attach_source(obs_loudness_t *loudness,
+		obs_source_t *source)
+{
+	signal_handler_t *sh;
+
+	if (!loudness || !source)
+		return false;
+
+	obs_loudness_detach(loudness);
+	if (!loudness_create_engine(loudness))
+		return false;
+
+	pthread_mutex_lock(&loudness->mutex);
+	loudness->source = source;
+	pthread_mutex_unlock(&loudness->mutex);
+
+	sh = obs_source_get_signal_handler(source);
+	signal_handler_connect(sh, "destroy",
+			loudness_source_destroyed, loudness);
+	obs_source_add_audio_capture_callback(source,
+			loudness_source_data_received, loudness);
+	return true;
+}
+
+bool obs_loudness_attach_mix(obs_loudness_t *loudness, size_t mix_idx)
+{
+	struct audio_convert_info conv = {0};
+
+	if (!loudness || mix_idx >= MAX_AUDIO_MIXES)
+		return false;
+
+	obs_loudness_detach(loudness);
+	if (!loudness_create_engine(loudness))
+		return false;
+
+	conv.format = AUDIO_FORMAT_FLOAT_PLANAR;
+
+	if (!audio_output_connect(obs_get_audio(), mix_idx, &conv,
+				loudness_mix_data_received, loudness))
+		return false;
+
+	pthread_mutex_lock(&loudness->mutex);
+	loudness->mix_idx = mix_idx;
+	loudness->mix_attached = true;
+	pthread_mutex_unlock(&loudness->mutex);
+	return true;
+}
+
+void obs_loudness_detach(obs_loudness_t *loudness)
+{
+	obs_source_t *source;
+	size_t mix_idx;
+	bool mix_attached;
+
+	if (!loudness)
+		return;
+
+	pthread_mutex_lock(&loudness->mutex);
+	source = loudness->source;
+	mix_idx = loudness->mix_idx;
+	mix_attached = loudness->mix_attached;
+	loudness->source = NULL;
+	loudness->mix_attached = false;
+	pthread_mutex_unlock(&loudness->mutex);
+
+	if (source) {
+		signal_handler_t *sh = obs_source_get_signal_handler(source);
+		signal_handler_disconnect(sh, "destroy",
+				loudness_source_destroyed, loudness);
+		obs_source_remove_audio_capture_callback(source,
+				loudness_source_data_received, loudness);
+	}
+
+	if (mix_attached)
+		audio_output_disconnect(obs_get_audio(), mix_idx,
+				loudness_mix_data_received, loudness);
+}
+
+void obs_loudness_reset(obs_loudness_t *loudness)
+{
+	if (!loudness)
+		return;
+
+	pthread_mutex_lock(&loudness->mutex);
+	audio_loudness_reset(loudness->engine);
+	pthread_mutex_unlock(&loudness->mutex);
+}
+
+bool obs_loudness_get_info(obs_loudness_t *loudness,
+		struct audio_loudness_info *info)
+{
+	bool attached;
+
+	if (!loudness || !info)
+		return false;
+
+	pthread_mutex_lock(&loudness->mutex);
+	attached = loudness->source || loudness->mix_attached;
+	audio_loudness_get_info(attached ? loudness->engine : NULL, info);
+	pthread_mutex_unlock(&loudness->mutex);
+
+	return attached;
+}
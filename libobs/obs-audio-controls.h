@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include "obs.h"
+#include "media-io/audio-loudness.h"
 
 /**
  * @file
@@ -205,18 +206,12 @@ EXPORT void obs_volmeter_detach_source(obs_volmeter_t *volmeter);
  * @param volmeter pointer to the volume meter object
  * @param ms update interval in ms
  *
- * This sets the update interval in milliseconds that should be processed before
- * the resulting values are emitted by the levels_updated signal. The resulting
- * number of audio samples is rounded to an integer.
- *
- * Please note that due to way obs does receive audio data from the sources
- * this is no hard guarantee for the timing of the signal itself. When the
- * volume meter receives a chunk of data that is multiple the size of the sample
- * interval, all data will be sampled and the values updated accordingly, but
- * only the signal for the last segment is actually emitted.
- * On the other hand data might be received in a way that will cause the signal
- * to be emitted in shorter intervals than specified here under some
- * circumstances.
+ * This sets how often, in milliseconds, the level callbacks are called.  The
+ * levels passed to the callbacks cover all audio received since the previous
+ * update: the peak is the highest peak and the magnitude is the RMS over the
+ * whole interval.  Callbacks are called from a shared volume meter thread,
+ * never from the audio thread, and are skipped if no audio was received.
+ * Updates are checked every 10ms, so the interval is rounded up to that.
  */
 EXPORT void obs_volmeter_set_update_interval(obs_volmeter_t *volmeter,
 		const unsigned int ms);
@@ -244,6 +239,66 @@ EXPORT void obs_volmeter_add_callback(obs_volmeter_t *volmeter,
 EXPORT void obs_volmeter_remove_callback(obs_volmeter_t *volmeter,
 		obs_volmeter_updated_t callback, void *param);
 
+/**
+ * @brief Create a loudness meter
+ * @return pointer to the loudness meter object
+ *
+ * A loudness meter measures ITU-R BS.1770 loudness (momentary, short-term and
+ * integrated LUFS) and true-peak of either a source or one of the output
+ * mixes.  Measurement runs on the audio thread; the results can be queried
+ * from any thread.
+ */
+EXPORT obs_loudness_t *obs_loudness_create(void);
+
+/**
+ * @brief Destroy a loudness meter
+ * @param loudness pointer to the loudness meter object
+ */
+EXPORT void obs_loudness_destroy(obs_loudness_t *loudness);
+
+/**
+ * @brief Attach the loudness meter to a source
+ * @param loudness pointer to the loudness meter object
+ * @param source pointer to the source object
+ * @return true on success
+ *
+ * The source is measured after its filters, before volume is applied.
+ * Attaching resets all measurements.
+ */
+EXPORT bool obs_loudness_attach_source(obs_loudness_t *loudness,
+		obs_source_t *source);
+
+/**
+ * @brief Attach the loudness meter to an output mix
+ * @param loudness pointer to the loudness meter object
+ * @param mix_idx index of the mix, up to MAX_AUDIO_MIXES
+ * @return true on success
+ *
+ * Attaching resets all measurements.
+ */
+EXPORT bool obs_loudness_attach_mix(obs_loudness_t *loudness, size_t mix_idx);
+
+/**
+ * @brief Detach the loudness meter from its source or mix
+ * @param loudness pointer to the loudness meter object
+ */
+EXPORT void obs_loudness_detach(obs_loudness_t *loudness);
+
+/**
+ * @brief Reset the measurements, restarting the integrated loudness
+ * @param loudness pointer to the loudness meter object
+ */
+EXPORT void obs_loudness_reset(obs_loudness_t *loudness);
+
+/**
+ * @brief Get the current measurements
+ * @param loudness pointer to the loudness meter object
+ * @param info receives the measurements
+ * @return false if the meter is not attached
+ */
+EXPORT bool obs_loudness_get_info(obs_loudness_t *loudness,
+		struct audio_loudness_info *info);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include <inttypes.h>
+#include <math.h>
 #include "obs-internal.h"
 
 struct ts_info {
@@ -26,6 +27,16 @@ struct ts_info {
 #define DEBUG_AUDIO 0
 #define MAX_BUFFERING_TICKS 45
 
+/* buffering is only reduced after every source has stayed ahead of it for
+ * this long, and one tick of what they were ahead by is always kept */
+#define BUFFERING_REDUCE_WINDOW_SEC 10
+#define BUFFERING_REDUCE_MARGIN_TICKS 1
+
+/* removing a tick of buffering skips a tick of audio, so it waits this long
+ * for a mix quieter than -60 dB before doing it anyway */
+#define BUFFERING_REDUCE_SILENCE_WAIT_SEC 5
+#define BUFFERING_REDUCE_SILENCE 0.001f
+
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
 	struct obs_core_audio *audio = p;
@@ -254,6 +265,10 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 		blog(LOG_WARNING, "Max audio buffering reached!");
 	}
 
+	if (audio->total_buffering_ticks > audio->max_buffering_ticks)
+		audio->max_buffering_ticks = audio->total_buffering_ticks;
+	audio->buffering_increases++;
+
 	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
 	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
 		sample_rate;
@@ -358,6 +373,144 @@ static inline void calc_min_ts(struct obs_core_data *data,
 		find_min_ts(data, min_ts);
 }
 
+/* how many frames a source has buffered past the end of the tick that was
+ * just output, or SIZE_MAX if the source doesn't limit buffering */
+static inline size_t audio_headroom(obs_source_t *source,
+		const struct ts_info *ts)
+{
+	if (source->info.audio_render || !source->audio_ts ||
+	    source->audio_ts > ts->end)
+		return SIZE_MAX;
+
+	/* audio for this tick wasn't there to be discarded */
+	if (source->audio_ts != ts->end)
+		return 0;
+
+	return source->audio_input_buf[0].size / sizeof(float);
+}
+
+static inline void reset_buffering_window(struct obs_core_audio *audio)
+{
+	audio->buffering_window_ticks = 0;
+	audio->buffering_reduce_wait_ticks = 0;
+	audio->min_headroom = SIZE_MAX;
+}
+
+static bool mixes_silent(const struct audio_output_data *mixes,
+		uint32_t mixers, size_t channels)
+{
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		if ((mixers & (1 << mix_idx)) == 0)
+			continue;
+
+		for (size_t ch = 0; ch < channels; ch++) {
+			const float *mix = mixes[mix_idx].data[ch];
+
+			for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+				if (fabsf(mix[i]) > BUFFERING_REDUCE_SILENCE)
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/* returns whether a tick of buffering should be removed now.  at most one
+ * tick is removed per window, preferably after a silent tick, so that the
+ * audio skipped isn't heard */
+static bool update_buffering_window(struct obs_core_audio *audio,
+		size_t sample_rate, size_t headroom, bool silent)
+{
+	int window_ticks = (int)(BUFFERING_REDUCE_WINDOW_SEC * sample_rate /
+			AUDIO_OUTPUT_FRAMES);
+
+	/* any lateness restarts the window */
+	if (audio->buffering_wait_ticks || !headroom) {
+		reset_buffering_window(audio);
+		audio->last_min_headroom = 0;
+		return false;
+	}
+
+	if (audio->buffering_reduce_wait_ticks) {
+		/* a source got too close to output meanwhile */
+		if (headroom / AUDIO_OUTPUT_FRAMES <=
+				BUFFERING_REDUCE_MARGIN_TICKS) {
+			reset_buffering_window(audio);
+			return false;
+		}
+
+		if (!silent && --audio->buffering_reduce_wait_ticks)
+			return false;
+
+		reset_buffering_window(audio);
+		return true;
+	}
+
+	if (headroom < audio->min_headroom)
+		audio->min_headroom = headroom;
+
+	if (++audio->buffering_window_ticks < window_ticks)
+		return false;
+
+	audio->last_min_headroom = audio->min_headroom;
+	reset_buffering_window(audio);
+
+	if (audio->last_min_headroom == SIZE_MAX ||
+	    !audio->total_buffering_ticks)
+		return false;
+
+	if (audio->last_min_headroom / AUDIO_OUTPUT_FRAMES >
+			BUFFERING_REDUCE_MARGIN_TICKS)
+		audio->buffering_reduce_wait_ticks = (int)(
+				BUFFERING_REDUCE_SILENCE_WAIT_SEC *
+				sample_rate / AUDIO_OUTPUT_FRAMES);
+
+	return false;
+}
+
+/* skips the next tick of buffered timestamps, discarding the audio sources
+ * have buffered for it, so that output catches up */
+static void reduce_audio_buffering(struct obs_core_audio *audio,
+		struct obs_core_data *data, size_t channels,
+		size_t sample_rate)
+{
+	struct obs_source *source = data->first_audio_source;
+	struct ts_info ts;
+	size_t total_ms;
+	size_t ms;
+
+	ms = AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
+	audio->total_buffering_ticks--;
+	audio->buffering_decreases++;
+
+	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+		sample_rate;
+
+	blog(LOG_INFO, "removing %d milliseconds of audio buffering, total "
+			"audio buffering is now %d milliseconds",
+			(int)ms, (int)total_ms);
+
+	circlebuf_pop_front(&audio->buffered_timestamps, &ts, sizeof(ts));
+
+#if DEBUG_AUDIO == 1
+	blog(LOG_DEBUG, "remove buffered ts: %"PRIu64"-%"PRIu64,
+			ts.start, ts.end);
+#endif
+
+	pthread_mutex_lock(&data->audio_sources_mutex);
+
+	while (source) {
+		pthread_mutex_lock(&source->audio_buf_mutex);
+		discard_audio(audio, source, channels, sample_rate, &ts);
+		pthread_mutex_unlock(&source->audio_buf_mutex);
+
+		source = (struct obs_source*)source->next_audio_source;
+	}
+
+	pthread_mutex_unlock(&data->audio_sources_mutex);
+}
+
 static inline void release_audio_sources(struct obs_core_audio *audio)
 {
 	for (size_t i = 0; i < audio->render_order.num; i++)
@@ -374,8 +527,10 @@ bool audio_callback(void *param,
 	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
 	size_t channels = audio_output_get_channels(audio->audio);
 	struct ts_info ts = {start_ts_in, end_ts_in};
+	size_t headroom = SIZE_MAX;
 	size_t audio_size;
 	uint64_t min_ts;
+	bool silent;
 
 	da_resize(audio->render_order, 0);
 	da_resize(audio->root_nodes, 0);
@@ -430,8 +585,10 @@ bool audio_callback(void *param,
 
 	/* ------------------------------------------------ */
 	/* if a source has gone backward in time, buffer */
-	if (min_ts < ts.start)
+	if (min_ts < ts.start) {
 		add_audio_buffering(audio, sample_rate, &ts, min_ts);
+		reset_buffering_window(audio);
+	}
 
 	/* ------------------------------------------------ */
 	/* mix audio */
@@ -458,10 +615,16 @@ bool audio_callback(void *param,
 
 	source = data->first_audio_source;
 	while (source) {
+		size_t source_headroom;
+
 		pthread_mutex_lock(&source->audio_buf_mutex);
 		discard_audio(audio, source, channels, sample_rate, &ts);
+		source_headroom = audio_headroom(source, &ts);
 		pthread_mutex_unlock(&source->audio_buf_mutex);
 
+		if (source_headroom < headroom)
+			headroom = source_headroom;
+
 		source = (struct obs_source*)source->next_audio_source;
 	}
 
@@ -473,6 +636,14 @@ bool audio_callback(void *param,
 
 	circlebuf_pop_front(&audio->buffered_timestamps, NULL, sizeof(ts));
 
+	/* ------------------------------------------------ */
+	/* remove buffering that's no longer needed */
+	silent = audio->buffering_reduce_wait_ticks &&
+		mixes_silent(mixes, mixers, channels);
+
+	if (update_buffering_window(audio, sample_rate, headroom, silent))
+		reduce_audio_buffering(audio, data, channels, sample_rate);
+
 	*out_ts = ts.start;
 
 	if (audio->buffering_wait_ticks) {
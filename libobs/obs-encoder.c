@@ -427,6 +427,7 @@ void obs_encoder_shutdown(obs_encoder_t *encoder)
 		encoder->first_received  = false;
 		encoder->offset_usec     = 0;
 		encoder->start_ts        = 0;
+		encoder->next_audio_ts   = 0;
 	}
 	pthread_mutex_unlock(&encoder->init_mutex);
 }
@@ -912,6 +913,32 @@ static void start_from_buffer(struct obs_encoder *encoder, uint64_t v_start_ts)
 		bfree(audio.data[i]);
 }
 
+/* audio output skips ahead when libobs removes audio buffering, so fill the
+ * skipped time with silence to keep audio in sync with video.  smaller
+ * differences are timestamp jitter from resampling and are ignored */
+static void fill_audio_gap(struct obs_encoder *encoder,
+		const struct audio_data *data)
+{
+	uint64_t gap_frames;
+	size_t size;
+
+	if (encoder->next_audio_ts && data->timestamp > encoder->next_audio_ts) {
+		gap_frames = (data->timestamp - encoder->next_audio_ts) *
+			(uint64_t)encoder->samplerate / 1000000000ULL;
+		size = (size_t)gap_frames * encoder->blocksize;
+
+		if (gap_frames * 2 >= data->frames)
+			for (size_t i = 0; i < encoder->planes; i++)
+				circlebuf_push_back_zero(
+						&encoder->audio_input_buffer[i],
+						size);
+	}
+
+	encoder->next_audio_ts = data->timestamp +
+		(uint64_t)data->frames * 1000000000ULL /
+		(uint64_t)encoder->samplerate;
+}
+
 static const char *buffer_audio_name = "buffer_audio";
 static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data)
 {
@@ -921,6 +948,8 @@ static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data)
 	size_t offset_size = 0;
 	bool success = true;
 
+	fill_audio_gap(encoder, data);
+
 	if (!encoder->start_ts && encoder->paired_encoder) {
 		uint64_t end_ts     = data->timestamp;
 		uint64_t v_start_ts = encoder->paired_encoder->start_ts;
@@ -998,6 +1027,7 @@ static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
 	if (!encoder->first_received) {
 		encoder->first_raw_ts = data->timestamp;
 		encoder->first_received = true;
+		encoder->next_audio_ts = 0;
 		clear_audio(encoder);
 	}
 
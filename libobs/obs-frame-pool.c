@@ -0,0 +1,310 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Project contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+
+#include "util/platform.h"
+#include "obs-internal.h"
+
+/*
+ * Async frame data is recycled through a pool shared by all sources.  Block
+ * sizes are rounded up to one of four size classes per power of two, so a
+ * block freed by one source can be reused by another source (or the same
+ * source after a resolution change) with at most 25% wasted space.
+ *
+ * Blocks that stay idle for FRAME_POOL_IDLE_TIME are given back to the
+ * system, checked on every allocation, release and video tick.  If a limit
+ * is set, live and idle blocks together never exceed it; idle blocks are
+ * evicted first, after which new frames fail to allocate.
+ */
+
+#define FRAME_POOL_MIN_SHIFT 12
+#define FRAME_POOL_MAX_SHIFT 28
+#define FRAME_POOL_CLASSES   4
+#define FRAME_POOL_UNPOOLED  FRAME_POOL_BUCKETS
+#define FRAME_POOL_IDLE_TIME 5000000000ULL
+
+/* the header keeps the data that follows it aligned the same way as bmalloc
+ * allocations */
+union frame_block {
+	struct {
+		size_t bucket;
+		size_t size;
+	};
+	uint8_t padding[32];
+};
+
+static inline union frame_block *get_block(void *data)
+{
+	return (union frame_block*)data - 1;
+}
+
+static size_t get_bucket(size_t size, size_t *block_size)
+{
+	size_t shift = FRAME_POOL_MIN_SHIFT;
+	size_t base, step, sub;
+
+	if (size <= ((size_t)1 << FRAME_POOL_MIN_SHIFT)) {
+		*block_size = (size_t)1 << FRAME_POOL_MIN_SHIFT;
+		return 0;
+	}
+	if (size > ((size_t)1 << FRAME_POOL_MAX_SHIFT)) {
+		*block_size = size;
+		return FRAME_POOL_UNPOOLED;
+	}
+
+	while (((size_t)1 << (shift + 1)) < size)
+		shift++;
+
+	base = (size_t)1 << shift;
+	step = base / FRAME_POOL_CLASSES;
+	sub  = (size - base + step - 1) / step;
+
+	*block_size = base + sub * step;
+	return 1 + (shift - FRAME_POOL_MIN_SHIFT) * FRAME_POOL_CLASSES +
+		(sub - 1);
+}
+
+static inline void free_idle_block(struct obs_frame_pool *pool,
+		size_t bucket, size_t idx)
+{
+	union frame_block *block = pool->buckets[bucket].array[idx].block;
+
+	pool->idle_bytes -= block->size;
+	da_erase(pool->buckets[bucket], idx);
+	bfree(block);
+}
+
+/* must be called with the pool mutex held.  blocks are pushed to the back of
+ * each bucket, so the oldest block of a bucket is always at the front */
+static void trim_idle_blocks(struct obs_frame_pool *pool, uint64_t ts)
+{
+	if (!pool->idle_bytes)
+		return;
+
+	for (size_t i = 0; i < FRAME_POOL_BUCKETS; i++) {
+		while (pool->buckets[i].num &&
+		       ts - pool->buckets[i].array[0].released >=
+				FRAME_POOL_IDLE_TIME)
+			free_idle_block(pool, i, 0);
+	}
+}
+
+/* must be called with the pool mutex held */
+static bool evict_oldest_block(struct obs_frame_pool *pool)
+{
+	size_t oldest = FRAME_POOL_BUCKETS;
+
+	for (size_t i = 0; i < FRAME_POOL_BUCKETS; i++) {
+		if (!pool->buckets[i].num)
+			continue;
+		if (oldest == FRAME_POOL_BUCKETS ||
+		    pool->buckets[i].array[0].released <
+		    pool->buckets[oldest].array[0].released)
+			oldest = i;
+	}
+
+	if (oldest == FRAME_POOL_BUCKETS)
+		return false;
+
+	free_idle_block(pool, oldest, 0);
+	return true;
+}
+
+/* must be called with the pool mutex held */
+static bool reserve_bytes(struct obs_frame_pool *pool, size_t size)
+{
+	if (!pool->limit)
+		return true;
+
+	while (pool->live_bytes + pool->idle_bytes + size > pool->limit) {
+		if (!evict_oldest_block(pool))
+			return false;
+	}
+
+	return true;
+}
+
+bool obs_frame_pool_init(struct obs_frame_pool *pool)
+{
+	memset(pool, 0, sizeof(*pool));
+	pthread_mutex_init_value(&pool->mutex);
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		return false;
+
+	pool->initialized = true;
+	return true;
+}
+
+void obs_frame_pool_free(struct obs_frame_pool *pool)
+{
+	if (!pool->initialized)
+		return;
+
+	blog(LOG_INFO, "Frame pool: %"PRIu64" hits, %"PRIu64" misses, "
+			"%"PRIu64" failed allocations",
+			pool->hits, pool->misses, pool->failures);
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->initialized = false;
+	for (size_t i = 0; i < FRAME_POOL_BUCKETS; i++) {
+		while (pool->buckets[i].num)
+			free_idle_block(pool, i, pool->buckets[i].num - 1);
+		da_free(pool->buckets[i]);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+void *obs_frame_pool_alloc(size_t size)
+{
+	struct obs_frame_pool *pool = &obs->data.frame_pool;
+	union frame_block *block = NULL;
+	size_t block_size;
+	size_t bucket;
+
+	if (!size)
+		return NULL;
+
+	bucket = get_bucket(size, &block_size);
+
+	pthread_mutex_lock(&pool->mutex);
+
+	trim_idle_blocks(pool, os_gettime_ns());
+
+	if (bucket != FRAME_POOL_UNPOOLED && pool->buckets[bucket].num) {
+		size_t idx = pool->buckets[bucket].num - 1;
+
+		block = pool->buckets[bucket].array[idx].block;
+		da_pop_back(pool->buckets[bucket]);
+		pool->idle_bytes -= block_size;
+		pool->hits++;
+
+	} else if (!reserve_bytes(pool, block_size)) {
+		pool->failures++;
+		pthread_mutex_unlock(&pool->mutex);
+		return NULL;
+
+	} else {
+		pool->misses++;
+	}
+
+	pool->live_bytes += block_size;
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (!block) {
+		block = bmalloc(sizeof(union frame_block) + block_size);
+		block->bucket = bucket;
+		block->size   = block_size;
+	}
+
+	return block + 1;
+}
+
+void obs_frame_pool_release(void *data)
+{
+	struct obs_frame_pool *pool;
+	union frame_block *block;
+
+	if (!data)
+		return;
+
+	block = get_block(data);
+
+	/* frames can outlive the core when a plugin still holds on to one */
+	if (!obs || !obs->data.frame_pool.initialized) {
+		bfree(block);
+		return;
+	}
+
+	pool = &obs->data.frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->live_bytes -= block->size;
+
+	if (block->bucket != FRAME_POOL_UNPOOLED &&
+	    (!pool->limit || pool->live_bytes + pool->idle_bytes +
+			block->size <= pool->limit)) {
+		struct frame_pool_idle idle = {block, os_gettime_ns()};
+
+		da_push_back(pool->buckets[block->bucket], &idle);
+		pool->idle_bytes += block->size;
+		block = NULL;
+
+		trim_idle_blocks(pool, idle.released);
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	bfree(block);
+}
+
+/* called every video tick, so idle blocks are also given back when no source
+ * allocates or releases frames anymore */
+void obs_frame_pool_trim(struct obs_frame_pool *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	trim_idle_blocks(pool, os_gettime_ns());
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void obs_set_frame_pool_limit(uint64_t bytes)
+{
+	struct obs_frame_pool *pool;
+
+	if (!obs)
+		return;
+
+	pool = &obs->data.frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->limit = bytes;
+	if (bytes) {
+		while (pool->live_bytes + pool->idle_bytes > bytes &&
+		       evict_oldest_block(pool));
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+uint64_t obs_get_frame_pool_limit(void)
+{
+	return obs ? obs->data.frame_pool.limit : 0;
+}
+
+bool obs_get_frame_pool_stats(struct obs_frame_pool_stats *stats)
+{
+	struct obs_frame_pool *pool;
+
+	if (!obs || !stats)
+		return false;
+
+	pool = &obs->data.frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	stats->hits       = pool->hits;
+	stats->misses     = pool->misses;
+	stats->failures   = pool->failures;
+	stats->live_bytes = pool->live_bytes;
+	stats->idle_bytes = pool->idle_bytes;
+	stats->limit      = pool->limit;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return true;
+}
@@ -225,6 +225,43 @@ struct obs_vframe_info {
 	int count;
 };
 
+/* worker threads for sources with OBS_SOURCE_PARALLEL_TICK, only used by the
+ * graphics thread */
+struct obs_tick_pool {
+	pthread_t                       *threads;
+	size_t                          num_threads;
+	os_sem_t                        *start_sem;
+	os_event_t                      *done_event;
+	volatile long                   next_job;
+	volatile long                   working;
+	volatile bool                   stop;
+
+	DARRAY(struct obs_source*)      jobs;
+	float                           seconds;
+	bool                            initialized;
+};
+
+/* conversion effect parameters, resolved once when the effect is loaded */
+struct obs_conversion_params {
+	gs_eparam_t                     *image;
+	gs_eparam_t                     *u_plane_offset;
+	gs_eparam_t                     *v_plane_offset;
+	gs_eparam_t                     *width;
+	gs_eparam_t                     *height;
+	gs_eparam_t                     *width_i;
+	gs_eparam_t                     *height_i;
+	gs_eparam_t                     *width_d2;
+	gs_eparam_t                     *height_d2;
+	gs_eparam_t                     *width_d2_i;
+	gs_eparam_t                     *height_d2_i;
+	gs_eparam_t                     *input_height;
+	gs_eparam_t                     *input_width_i_d2;
+	gs_eparam_t                     *int_width;
+	gs_eparam_t                     *int_input_width;
+	gs_eparam_t                     *int_u_plane_offset;
+	gs_eparam_t                     *int_v_plane_offset;
+};
+
 struct obs_core_video {
 	graphics_t                      *graphics;
 	gs_stagesurf_t                  *copy_surfaces[NUM_TEXTURES];
@@ -241,6 +278,7 @@ struct obs_core_video {
 	gs_effect_t                     *opaque_effect;
 	gs_effect_t                     *solid_effect;
 	gs_effect_t                     *conversion_effect;
+	struct obs_conversion_params    conversion_params;
 	gs_effect_t                     *bicubic_effect;
 	gs_effect_t                     *lanczos_effect;
 	gs_effect_t                     *bilinear_lowres_effect;
@@ -251,6 +289,7 @@ struct obs_core_video {
 
 	uint64_t                        video_time;
 	uint64_t                        video_avg_frame_time_ns;
+	struct gs_draw_stats            video_avg_draw_stats;
 	double                          video_fps;
 	video_t                         *video;
 	pthread_t                       video_thread;
@@ -274,6 +313,14 @@ struct obs_core_video {
 
 	gs_texture_t                    *transparent_texture;
 
+	/* upload buffers of destroyed async frames, freed by the graphics
+	 * thread */
+	bool                            async_uploads_available;
+	pthread_mutex_t                 async_upload_mutex;
+	DARRAY(gs_upload_buffer_t*)     async_upload_garbage;
+
+	struct obs_tick_pool            tick_pool;
+
 	gs_effect_t                     *deinterlace_discard_effect;
 	gs_effect_t                     *deinterlace_discard_2x_effect;
 	gs_effect_t                     *deinterlace_linear_effect;
@@ -298,6 +345,19 @@ struct obs_core_audio {
 	struct circlebuf                buffered_timestamps;
 	int                             buffering_wait_ticks;
 	int                             total_buffering_ticks;
+	int                             max_buffering_ticks;
+	uint32_t                        buffering_increases;
+	uint32_t                        buffering_decreases;
+
+	/* least audio (in frames) any source had buffered ahead of output
+	 * over the current and last completed window */
+	int                             buffering_window_ticks;
+	size_t                          min_headroom;
+	size_t                          last_min_headroom;
+
+	/* ticks left to wait for silence before removing a tick of
+	 * buffering, or 0 if none is to be removed */
+	int                             buffering_reduce_wait_ticks;
 
 	float                           user_volume;
 
@@ -305,8 +365,38 @@ struct obs_core_audio {
 	DARRAY(struct audio_monitor*)   monitors;
 	char                            *monitoring_device_name;
 	char                            *monitoring_device_id;
+	uint32_t                        monitoring_latency_ms;
 };
 
+/* recycled memory for async frames, shared by all sources */
+#define FRAME_POOL_BUCKETS 65
+
+struct frame_pool_idle {
+	void                            *block;
+	uint64_t                        released;
+};
+
+struct obs_frame_pool {
+	pthread_mutex_t                 mutex;
+	DARRAY(struct frame_pool_idle)  buckets[FRAME_POOL_BUCKETS];
+
+	uint64_t                        limit;
+	uint64_t                        live_bytes;
+	uint64_t                        idle_bytes;
+
+	uint64_t                        hits;
+	uint64_t                        misses;
+	uint64_t                        failures;
+
+	bool                            initialized;
+};
+
+extern bool obs_frame_pool_init(struct obs_frame_pool *pool);
+extern void obs_frame_pool_free(struct obs_frame_pool *pool);
+extern void *obs_frame_pool_alloc(size_t size);
+extern void obs_frame_pool_release(void *data);
+extern void obs_frame_pool_trim(struct obs_frame_pool *pool);
+
 /* user sources, output channels, and displays */
 struct obs_core_data {
 	struct obs_source               *first_source;
@@ -326,6 +416,14 @@ struct obs_core_data {
 	DARRAY(struct draw_callback)    draw_callbacks;
 	DARRAY(struct tick_callback)    tick_callbacks;
 
+	/* sources that will be ticked on the next frame, see
+	 * obs_source_request_tick */
+	pthread_mutex_t                 tick_sources_mutex;
+	DARRAY(struct obs_source*)      tick_sources;
+	DARRAY(struct obs_source*)      ticking_sources;
+
+	struct obs_frame_pool           frame_pool;
+
 	struct obs_view                 main_view;
 
 	long long                       unnamed_index;
@@ -387,6 +485,7 @@ struct obs_core {
 
 	char                            *locale;
 	char                            *module_config_path;
+	char                            *shader_cache_path;
 	bool                            name_store_owned;
 	profiler_name_store_t           *name_store;
 
@@ -500,6 +599,13 @@ struct async_frame {
 	struct obs_source_frame *frame;
 	long unused_count;
 	bool used;
+	bool upload_pending;
+};
+
+struct async_upload {
+	gs_upload_buffer_t *buffer;
+	uint8_t *data;
+	size_t size;
 };
 
 enum audio_action_type {
@@ -543,12 +649,22 @@ struct obs_source {
 	/* signals to call the source update in the video thread */
 	bool                            defer_update;
 
+	/* source is in the tick list (protected by tick_sources_mutex) */
+	bool                            tick_queued;
+
+	/* source is being destroyed and must not be ticked or queued for
+	 * ticking anymore (protected by tick_sources_mutex) */
+	bool                            destroying;
+
 	/* ensures show/hide are only called once */
 	volatile long                   show_refs;
 
 	/* ensures activate/deactivate are only called once */
 	volatile long                   activate_refs;
 
+	/* incremented when the output changes, see obs_source_mark_dirty */
+	volatile long                   render_version;
+
 	/* used to indicate that the source has been removed and all
 	 * references to it should be released (not exactly how I would prefer
 	 * to handle things but it's the best option) */
@@ -598,6 +714,7 @@ struct obs_source {
 	float                           volume;
 	int64_t                         sync_offset;
 	int64_t                         last_sync_offset;
+	uint64_t                        audio_latency;
 
 	/* async video data */
 	gs_texture_t                    *async_texture;
@@ -627,6 +744,10 @@ struct obs_source {
 	uint32_t                        async_cache_height;
 	uint32_t                        async_convert_width;
 	uint32_t                        async_convert_height;
+	DARRAY(struct async_upload)     async_uploads;
+	size_t                          async_upload_size;
+	uint64_t                        async_ref_frames;
+	uint64_t                        async_ref_copied_frames;
 
 	/* async video deinterlacing */
 	uint64_t                        deinterlace_offset;
@@ -710,6 +831,8 @@ extern void obs_transition_load(obs_source_t *source, obs_data_t *data);
 struct audio_monitor *audio_monitor_create(obs_source_t *source);
 void audio_monitor_reset(struct audio_monitor *monitor);
 extern void audio_monitor_destroy(struct audio_monitor *monitor);
+extern bool audio_monitor_get_stats(struct audio_monitor *monitor,
+		struct obs_audio_monitoring_stats *stats);
 
 extern void obs_source_destroy(struct obs_source *source);
 
@@ -758,6 +881,28 @@ static inline enum gs_color_format convert_video_format(
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
+extern void obs_source_tick_state(obs_source_t *source);
+
+#define RENDER_VERSION_INIT 0xcbf29ce484222325ULL
+
+static inline uint64_t render_version_mix(uint64_t version,
+		const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		version ^= bytes[i];
+		version *= 0x100000001b3ULL;
+	}
+
+	return version;
+}
+
+extern bool obs_source_get_render_version(obs_source_t *source,
+		uint64_t *version);
+extern bool obs_scene_get_render_version(obs_scene_t *scene,
+		uint64_t *version);
+extern void obs_source_request_tick(obs_source_t *source);
 extern float obs_source_get_target_volume(obs_source_t *source,
 		obs_source_t *target);
 
@@ -773,6 +918,7 @@ extern bool update_async_texture(struct obs_source *source,
 		gs_texture_t *tex, gs_texrender_t *texrender);
 extern bool set_async_texture_size(struct obs_source *source,
 		const struct obs_source_frame *frame);
+extern void free_async_upload_garbage(void);
 extern void remove_async_frame(obs_source_t *source,
 		struct obs_source_frame *frame);
 
@@ -970,6 +1116,7 @@ struct obs_encoder {
 	int64_t                         offset_usec;
 	uint64_t                        first_raw_ts;
 	uint64_t                        start_ts;
+	uint64_t                        next_audio_ts;
 
 	pthread_mutex_t                 outputs_mutex;
 	DARRAY(obs_output_t*)            outputs;
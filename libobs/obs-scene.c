@@ -157,6 +157,12 @@ static void scene_destroy(void *data)
 
 	remove_all_items(scene);
 
+	if (scene->cache_render) {
+		obs_enter_graphics();
+		gs_texrender_destroy(scene->cache_render);
+		obs_leave_graphics();
+	}
+
 	pthread_mutex_destroy(&scene->video_mutex);
 	pthread_mutex_destroy(&scene->audio_mutex);
 	bfree(scene);
@@ -521,6 +527,131 @@ static void scene_video_tick(void *data, float seconds)
 	UNUSED_PARAMETER(seconds);
 }
 
+/* must be called with the video mutex held */
+static bool get_render_version(struct obs_scene *scene, uint64_t *version)
+{
+	struct obs_scene_item *item = scene->first_item;
+	uint64_t v = RENDER_VERSION_INIT;
+
+	while (item) {
+		uint64_t item_version;
+
+		if (item->user_visible) {
+			if (!obs_source_get_render_version(item->source,
+						&item_version))
+				return false;
+
+			v = render_version_mix(v, &item->id, sizeof(item->id));
+			v = render_version_mix(v, &item_version,
+					sizeof(item_version));
+			v = render_version_mix(v, &item->draw_transform,
+					sizeof(item->draw_transform));
+			v = render_version_mix(v, &item->crop,
+					sizeof(item->crop));
+			v = render_version_mix(v, &item->scale_filter,
+					sizeof(item->scale_filter));
+			v = render_version_mix(v, &item->last_width,
+					sizeof(item->last_width));
+			v = render_version_mix(v, &item->last_height,
+					sizeof(item->last_height));
+		}
+
+		item = item->next;
+	}
+
+	*version = v;
+	return true;
+}
+
+bool obs_scene_get_render_version(obs_scene_t *scene, uint64_t *version)
+{
+	bool success;
+
+	video_lock(scene);
+	success = get_render_version(scene, version);
+	video_unlock(scene);
+
+	return success;
+}
+
+/* when rendering into the cache, alpha is composited the same way as color,
+ * so that the cache holds premultiplied color along with the coverage of all
+ * items, see render_cached */
+static void render_items(struct obs_scene *scene, bool premultiplied)
+{
+	struct obs_scene_item *item = scene->first_item;
+
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	if (premultiplied)
+		gs_blend_function_separate(
+				GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA,
+				GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+	/* sprites of consecutive items that use the same texture and effect
+	 * state, such as copies of one image or color source, are merged into
+	 * a single draw */
+	gs_sprite_batch_begin();
+
+	while (item) {
+		if (item->user_visible)
+			render_item(item);
+		item = item->next;
+	}
+
+	gs_sprite_batch_end();
+	gs_blend_state_pop();
+}
+
+/* must be called with the video mutex held.  returns false if the scene has
+ * to be rendered directly */
+static bool render_cached(struct obs_scene *scene)
+{
+	uint32_t cx = obs->video.base_width;
+	uint32_t cy = obs->video.base_height;
+	gs_effect_t *effect = obs->video.default_effect;
+	uint64_t version;
+	gs_texture_t *tex;
+
+	if (!get_render_version(scene, &version)) {
+		scene->cache_valid = false;
+		return false;
+	}
+
+	if (!scene->cache_render)
+		scene->cache_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	if (!scene->cache_valid || scene->cache_version != version) {
+		struct vec4 clear_color;
+
+		gs_texrender_reset(scene->cache_render);
+		if (!gs_texrender_begin(scene->cache_render, cx, cy)) {
+			scene->cache_valid = false;
+			return false;
+		}
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		render_items(scene, true);
+		gs_texrender_end(scene->cache_render);
+
+		scene->cache_version = version;
+		scene->cache_valid = true;
+	}
+
+	/* the color in the cache is already multiplied by alpha */
+	tex = gs_texrender_get_texture(scene->cache_render);
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+	while (gs_effect_loop(effect, "Draw"))
+		obs_source_draw(tex, 0, 0, 0, 0, 0);
+	gs_blend_state_pop();
+
+	return true;
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	DARRAY(struct obs_scene_item*) remove_items;
@@ -532,9 +663,6 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 	video_lock(scene);
 	item = scene->first_item;
 
-	gs_blend_state_push();
-	gs_reset_blend_state();
-
 	while (item) {
 		if (obs_source_removed(item->source)) {
 			struct obs_scene_item *del_item = item;
@@ -548,13 +676,17 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 		if (source_size_changed(item))
 			update_item_transform(item);
 
-		if (item->user_visible)
-			render_item(item);
-
 		item = item->next;
 	}
 
-	gs_blend_state_pop();
+	if (!scene->render_cache && scene->cache_render) {
+		gs_texrender_destroy(scene->cache_render);
+		scene->cache_render = NULL;
+		scene->cache_valid = false;
+	}
+
+	if (!scene->render_cache || !render_cached(scene))
+		render_items(scene, false);
 
 	video_unlock(scene);
 
@@ -684,6 +816,8 @@ static void scene_load(void *data, obs_data_t *settings)
 
 	remove_all_items(scene);
 
+	scene->render_cache = obs_data_get_bool(settings, "render_cache");
+
 	if (!items) return;
 
 	count = obs_data_array_count(items);
@@ -758,6 +892,7 @@ static void scene_save(void *data, obs_data_t *settings)
 	}
 
 	obs_data_set_int(settings, "id_counter", scene->id_counter);
+	obs_data_set_bool(settings, "render_cache", scene->render_cache);
 
 	full_unlock(scene);
 
@@ -1096,6 +1231,7 @@ obs_scene_t *obs_scene_duplicate(obs_scene_t *scene, const char *name,
 		obs_scene_create_private(name) : obs_scene_create(name);
 
 	obs_source_copy_filters(new_scene->source, scene->source);
+	new_scene->render_cache = scene->render_cache;
 
 	obs_data_apply(new_scene->source->private_settings,
 			scene->source->private_settings);
@@ -1182,6 +1318,20 @@ obs_scene_t *obs_scene_from_source(const obs_source_t *source)
 	return source->context.data;
 }
 
+void obs_scene_set_render_cache(obs_scene_t *scene, bool enable)
+{
+	if (!obs_ptr_valid(scene, "obs_scene_set_render_cache"))
+		return;
+
+	scene->render_cache = enable;
+}
+
+bool obs_scene_get_render_cache(const obs_scene_t *scene)
+{
+	return obs_ptr_valid(scene, "obs_scene_get_render_cache") ?
+		scene->render_cache : false;
+}
+
 obs_sceneitem_t *obs_scene_find_source(obs_scene_t *scene, const char *name)
 {
 	struct obs_scene_item *item;
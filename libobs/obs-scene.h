@@ -86,4 +86,10 @@ struct obs_scene {
 	pthread_mutex_t       video_mutex;
 	pthread_mutex_t       audio_mutex;
 	struct obs_scene_item *first_item;
+
+	/* reuses the previous render while nothing has changed */
+	bool                  render_cache;
+	gs_texrender_t        *cache_render;
+	uint64_t              cache_version;
+	bool                  cache_valid;
 };
@@ -195,6 +195,7 @@ bool obs_source_init(struct obs_source *source)
 	obs_context_data_insert(&source->context,
 			&obs->data.sources_mutex,
 			&obs->data.first_source);
+	obs_source_request_tick(source);
 	return true;
 }
 
@@ -496,15 +497,116 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
+/* frame whose data is owned by the source that output it, see
+ * obs_source_output_video2 */
+struct external_frame {
+	struct obs_source_frame frame;
+	void (*release)(void *param);
+	void *param;
+};
+
+/* upload buffers can only be destroyed by the graphics thread */
+static void discard_async_upload(gs_upload_buffer_t *buffer)
+{
+	struct obs_core_video *video = &obs->video;
+
+	pthread_mutex_lock(&video->async_upload_mutex);
+	da_push_back(video->async_upload_garbage, &buffer);
+	pthread_mutex_unlock(&video->async_upload_mutex);
+}
+
+void free_async_upload_garbage(void)
+{
+	struct obs_core_video *video = &obs->video;
+	DARRAY(gs_upload_buffer_t*) garbage;
+
+	if (!video->async_upload_garbage.num)
+		return;
+
+	pthread_mutex_lock(&video->async_upload_mutex);
+	garbage.da = video->async_upload_garbage.da;
+	da_init(video->async_upload_garbage);
+	pthread_mutex_unlock(&video->async_upload_mutex);
+
+	for (size_t i = 0; i < garbage.num; i++)
+		gs_upload_buffer_destroy(garbage.array[i]);
+	da_free(garbage);
+}
+
+static inline void async_frame_destroy(struct obs_source_frame *frame)
+{
+	if (frame->external) {
+		struct external_frame *ext = (struct external_frame*)frame;
+		ext->release(ext->param);
+		bfree(ext);
+	} else if (frame->upload) {
+		discard_async_upload(frame->upload);
+		bfree(frame);
+	} else if (frame->pooled) {
+		obs_frame_pool_release(frame->data[0]);
+		bfree(frame);
+	} else {
+		obs_source_frame_destroy(frame);
+	}
+}
+
 static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 {
 	if (os_atomic_dec_long(&frame->refs) == 0)
-		obs_source_frame_destroy(frame);
+		async_frame_destroy(frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
 		obs_source_t *filter);
 
+static inline void clear_ticking_entries(obs_source_t *source)
+{
+	struct obs_core_data *data = &obs->data;
+
+	for (size_t i = 0; i < data->ticking_sources.num; i++) {
+		if (data->ticking_sources.array[i] == source)
+			data->ticking_sources.array[i] = NULL;
+	}
+}
+
+/* the tick list is walked with the sources mutex held, so this waits for
+ * any tick in progress.  if the source is destroyed from within a tick, its
+ * entry in the list being ticked is cleared instead.  from here on the source
+ * is skipped by tick_sources, and obs_source_request_tick does nothing, so
+ * plugin threads that are still outputting can't queue it again */
+static void stop_ticking(obs_source_t *source)
+{
+	struct obs_core_data *data = &obs->data;
+
+	pthread_mutex_lock(&data->sources_mutex);
+	pthread_mutex_lock(&data->tick_sources_mutex);
+
+	source->destroying = true;
+	clear_ticking_entries(source);
+
+	pthread_mutex_unlock(&data->tick_sources_mutex);
+	pthread_mutex_unlock(&data->sources_mutex);
+}
+
+/* called once nothing can request a tick for the source anymore */
+static void remove_from_tick_list(obs_source_t *source)
+{
+	struct obs_core_data *data = &obs->data;
+
+	pthread_mutex_lock(&data->sources_mutex);
+	pthread_mutex_lock(&data->tick_sources_mutex);
+
+	if (source->tick_queued) {
+		da_erase_item(data->tick_sources, &source);
+		source->tick_queued = false;
+	}
+
+	clear_ticking_entries(source);
+
+	pthread_mutex_unlock(&data->tick_sources_mutex);
+	pthread_mutex_unlock(&data->sources_mutex);
+}
+
 void obs_source_destroy(struct obs_source *source)
 {
 	size_t i;
@@ -531,11 +633,20 @@ void obs_source_destroy(struct obs_source *source)
 		obs_source_filter_remove(source, source->filters.array[0]);
 
 	obs_context_data_remove(&source->context);
+	stop_ticking(source);
 
 	blog(LOG_DEBUG, "%ssource '%s' destroyed",
 			source->context.private ? "private " : "",
 			source->context.name);
 
+	if (source->async_ref_frames || source->async_ref_copied_frames)
+		blog(LOG_INFO, "source '%s': %llu of %llu frames output "
+				"without copying",
+				source->context.name,
+				(unsigned long long)source->async_ref_frames,
+				(unsigned long long)(source->async_ref_frames +
+					source->async_ref_copied_frames));
+
 	obs_source_dosignal(source, "source_destroy", "destroy");
 
 	if (source->context.data) {
@@ -563,6 +674,8 @@ void obs_source_destroy(struct obs_source *source)
 		gs_texture_destroy(source->async_prev_texture);
 	if (source->filter_texrender)
 		gs_texrender_destroy(source->filter_texrender);
+	for (i = 0; i < source->async_uploads.num; i++)
+		gs_upload_buffer_destroy(source->async_uploads.array[i].buffer);
 	gs_leave_context();
 
 	for (i = 0; i < MAX_AV_PLANES; i++)
@@ -574,9 +687,14 @@ void obs_source_destroy(struct obs_source *source)
 
 	obs_source_frame_destroy(source->async_preload_frame);
 
+	/* the plugin's threads are gone and the async frames are released, so
+	 * nothing can queue the source for ticking anymore */
+	remove_from_tick_list(source);
+
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_free(source);
 
+	da_free(source->async_uploads);
 	da_free(source->audio_actions);
 	da_free(source->audio_cb_list);
 	da_free(source->async_cache);
@@ -785,6 +903,8 @@ static void obs_source_deferred_update(obs_source_t *source)
 		source->info.update(source->context.data,
 				source->context.settings);
 
+	os_atomic_inc_long(&source->render_version);
+
 	source->defer_update = false;
 }
 
@@ -798,9 +918,11 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 
 	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
 		source->defer_update = true;
+		obs_source_request_tick(source);
 	} else if (source->context.data && source->info.update) {
 		source->info.update(source->context.data,
 				source->context.settings);
+		os_atomic_inc_long(&source->render_version);
 	}
 }
 
@@ -914,6 +1036,7 @@ static void activate_tree(obs_source_t *parent, obs_source_t *child,
 		void *param)
 {
 	os_atomic_inc_long(&child->activate_refs);
+	obs_source_request_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -923,6 +1046,7 @@ static void deactivate_tree(obs_source_t *parent, obs_source_t *child,
 		void *param)
 {
 	os_atomic_dec_long(&child->activate_refs);
+	obs_source_request_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -931,6 +1055,7 @@ static void deactivate_tree(obs_source_t *parent, obs_source_t *child,
 static void show_tree(obs_source_t *parent, obs_source_t *child, void *param)
 {
 	os_atomic_inc_long(&child->show_refs);
+	obs_source_request_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -939,6 +1064,7 @@ static void show_tree(obs_source_t *parent, obs_source_t *child, void *param)
 static void hide_tree(obs_source_t *parent, obs_source_t *child, void *param)
 {
 	os_atomic_dec_long(&child->show_refs);
+	obs_source_request_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -949,6 +1075,8 @@ void obs_source_activate(obs_source_t *source, enum view_type type)
 	if (!obs_source_valid(source, "obs_source_activate"))
 		return;
 
+	obs_source_request_tick(source);
+
 	os_atomic_inc_long(&source->show_refs);
 	obs_source_enum_active_tree(source, show_tree, NULL);
 
@@ -963,6 +1091,8 @@ void obs_source_deactivate(obs_source_t *source, enum view_type type)
 	if (!obs_source_valid(source, "obs_source_deactivate"))
 		return;
 
+	obs_source_request_tick(source);
+
 	if (os_atomic_load_long(&source->show_refs) > 0) {
 		os_atomic_dec_long(&source->show_refs);
 		obs_source_enum_active_tree(source, hide_tree, NULL);
@@ -1009,12 +1139,25 @@ static void async_tick(obs_source_t *source)
 				source->cur_async_frame);
 }
 
-void obs_source_video_tick(obs_source_t *source, float seconds)
+/* queues the source to be ticked on the next frame.  sources stay in the tick
+ * list for as long as they need it, see tick_sources in obs-video.c */
+void obs_source_request_tick(obs_source_t *source)
 {
-	bool now_showing, now_active;
+	struct obs_core_data *data = &obs->data;
 
-	if (!obs_source_valid(source, "obs_source_video_tick"))
-		return;
+	pthread_mutex_lock(&data->tick_sources_mutex);
+	if (!source->tick_queued && !source->destroying) {
+		da_push_back(data->tick_sources, &source);
+		source->tick_queued = true;
+	}
+	pthread_mutex_unlock(&data->tick_sources_mutex);
+}
+
+/* per-frame state handled by libobs itself, always done on the graphics
+ * thread before the source's video_tick callback is called */
+void obs_source_tick_state(obs_source_t *source)
+{
+	bool now_showing, now_active;
 
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_tick(source);
@@ -1053,13 +1196,21 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 		source->active = now_active;
 	}
 
-	if (source->context.data && source->info.video_tick)
-		source->info.video_tick(source->context.data, seconds);
-
 	source->async_rendered = false;
 	source->deinterlace_rendered = false;
 }
 
+void obs_source_video_tick(obs_source_t *source, float seconds)
+{
+	if (!obs_source_valid(source, "obs_source_video_tick"))
+		return;
+
+	obs_source_tick_state(source);
+
+	if (source->context.data && source->info.video_tick)
+		source->info.video_tick(source->context.data, seconds);
+}
+
 /* unless the value is 3+ hours worth of frames, this won't overflow */
 static inline uint64_t conv_frames_to_time(const size_t sample_rate,
 		const size_t frames)
@@ -1223,7 +1374,10 @@ static void source_output_audio_data(obs_source_t *source,
 	size_t sample_rate = audio_output_get_sample_rate(obs->audio.audio);
 	struct audio_data in = *data;
 	uint64_t diff;
-	uint64_t os_time = os_gettime_ns();
+
+	/* audio held back by filters arrives late, so treat it as having
+	 * arrived when it would have without them */
+	uint64_t os_time = os_gettime_ns() - source->audio_latency;
 	int64_t sync_offset;
 	bool using_direct_ts = false;
 	bool push_back = false;
@@ -1453,24 +1607,32 @@ bool set_async_texture_size(struct obs_source *source,
 	return !!source->async_texture;
 }
 
+/* frames backed by an upload buffer only queue a copy on the GPU */
+static void set_async_texture_image(gs_texture_t *tex,
+		const struct obs_source_frame *frame, uint32_t linesize)
+{
+	if (frame->upload)
+		gs_texture_set_image_from_buffer(tex, frame->upload, linesize);
+	else
+		gs_texture_set_image(tex, frame->data[0], linesize, false);
+}
+
 static void upload_raw_frame(gs_texture_t *tex,
 		const struct obs_source_frame *frame)
 {
 	switch (get_convert_type(frame->format)) {
 		case CONVERT_422_U:
 		case CONVERT_422_Y:
-			gs_texture_set_image(tex, frame->data[0],
-					frame->linesize[0], false);
+			set_async_texture_image(tex, frame,
+					frame->linesize[0]);
 			break;
 
 		case CONVERT_420:
-			gs_texture_set_image(tex, frame->data[0],
-					frame->width, false);
+			set_async_texture_image(tex, frame, frame->width);
 			break;
 
 		case CONVERT_NV12:
-			gs_texture_set_image(tex, frame->data[0],
-					frame->width, false);
+			set_async_texture_image(tex, frame, frame->width);
 			break;
 
 		case CONVERT_NONE:
@@ -1510,18 +1672,6 @@ static const char *select_conversion_technique(enum video_format format)
 	return NULL;
 }
 
-static inline void set_eparam(gs_effect_t *effect, const char *name, float val)
-{
-	gs_eparam_t *param = gs_effect_get_param_by_name(effect, name);
-	gs_effect_set_float(param, val);
-}
-
-static inline void set_eparami(gs_effect_t *effect, const char *name, int val)
-{
-	gs_eparam_t *param = gs_effect_get_param_by_name(effect, name);
-	gs_effect_set_int(param, val);
-}
-
 static bool update_async_texrender(struct obs_source *source,
 		const struct obs_source_frame *frame,
 		gs_texture_t *tex, gs_texrender_t *texrender)
@@ -1536,6 +1686,7 @@ static bool update_async_texrender(struct obs_source *source,
 	float convert_width  = (float)source->async_convert_width;
 
 	gs_effect_t *conv = obs->video.conversion_effect;
+	struct obs_conversion_params *params = &obs->video.conversion_params;
 	gs_technique_t *tech = gs_effect_get_technique(conv,
 			select_conversion_technique(frame->format));
 
@@ -1545,18 +1696,20 @@ static bool update_async_texrender(struct obs_source *source,
 	gs_technique_begin(tech);
 	gs_technique_begin_pass(tech, 0);
 
-	gs_effect_set_texture(gs_effect_get_param_by_name(conv, "image"), tex);
-	set_eparam(conv, "width",  (float)cx);
-	set_eparam(conv, "height", (float)cy);
-	set_eparam(conv, "width_d2",  cx * 0.5f);
-	set_eparam(conv, "width_d2_i",  1.0f / (cx * 0.5f));
-	set_eparam(conv, "input_width_i_d2",  (1.0f / convert_width)  * 0.5f);
-
-	set_eparami(conv, "int_width", (int)cx);
-	set_eparami(conv, "int_input_width", (int)source->async_convert_width);
-	set_eparami(conv, "int_u_plane_offset",
+	gs_effect_set_texture(params->image, tex);
+	gs_effect_set_float(params->width,  (float)cx);
+	gs_effect_set_float(params->height, (float)cy);
+	gs_effect_set_float(params->width_d2,  cx * 0.5f);
+	gs_effect_set_float(params->width_d2_i,  1.0f / (cx * 0.5f));
+	gs_effect_set_float(params->input_width_i_d2,
+			(1.0f / convert_width) * 0.5f);
+
+	gs_effect_set_int(params->int_width, (int)cx);
+	gs_effect_set_int(params->int_input_width,
+			(int)source->async_convert_width);
+	gs_effect_set_int(params->int_u_plane_offset,
 			(int)source->async_plane_offset[0]);
-	set_eparami(conv, "int_v_plane_offset",
+	gs_effect_set_int(params->int_v_plane_offset,
 			(int)source->async_plane_offset[1]);
 
 	gs_ortho(0.f, (float)cx, 0.f, (float)cy, -100.f, 100.f);
@@ -1571,6 +1724,25 @@ static bool update_async_texrender(struct obs_source *source,
 	return true;
 }
 
+/* the frame's upload buffer must not be rewritten until the GPU is done
+ * copying from it, see update_async_uploads */
+static void mark_async_upload_pending(struct obs_source *source,
+		const struct obs_source_frame *frame)
+{
+	pthread_mutex_lock(&source->async_mutex);
+
+	for (size_t i = 0; i < source->async_cache.num; i++) {
+		struct async_frame *af = &source->async_cache.array[i];
+
+		if (af->frame == frame) {
+			af->upload_pending = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
 bool update_async_texture(struct obs_source *source,
 		const struct obs_source_frame *frame,
 		gs_texture_t *tex, gs_texrender_t *texrender)
@@ -1588,12 +1760,14 @@ bool update_async_texture(struct obs_source *source,
 	memcpy(source->async_color_range_max, frame->color_range_max,
 			sizeof frame->color_range_max);
 
+	if (frame->upload)
+		mark_async_upload_pending(source, frame);
+
 	if (source->async_gpu_conversion && texrender)
 		return update_async_texrender(source, frame, tex, texrender);
 
 	if (type == CONVERT_NONE) {
-		gs_texture_set_image(tex, frame->data[0], frame->linesize[0],
-				false);
+		set_async_texture_image(tex, frame, frame->linesize[0]);
 		return true;
 	}
 
@@ -1682,8 +1856,88 @@ static void obs_source_draw_async_texture(struct obs_source *source)
 	}
 }
 
+#define ASYNC_UPLOAD_RESERVE 2
+#define MAX_ASYNC_UPLOADS    8
+
+/*
+ * Keeps a few upload buffers of the current frame size ready for
+ * cache_video, and releases frames whose upload has finished on the GPU.
+ * Buffers are only created here because creating them requires the graphics
+ * context.
+ */
+static void update_async_uploads(obs_source_t *source)
+{
+	size_t count = 0;
+	size_t needed = 0;
+	size_t size;
+
+	if (!obs->video.async_uploads_available)
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	size = source->async_upload_size;
+
+	for (size_t i = 0; i < source->async_cache.num; i++) {
+		struct async_frame *af = &source->async_cache.array[i];
+		if (!af->frame->upload)
+			continue;
+
+		if (af->upload_pending && !gs_upload_buffer_busy(
+					af->frame->upload))
+			af->upload_pending = false;
+		count++;
+	}
+
+	for (size_t i = source->async_uploads.num; i > 0; i--) {
+		struct async_upload *upload = &source->async_uploads.array[i-1];
+		if (upload->size != size) {
+			gs_upload_buffer_destroy(upload->buffer);
+			da_erase(source->async_uploads, i - 1);
+		}
+	}
+
+	count += source->async_uploads.num;
+
+	if (size && source->async_uploads.num < ASYNC_UPLOAD_RESERVE &&
+	    count < MAX_ASYNC_UPLOADS) {
+		needed = ASYNC_UPLOAD_RESERVE - source->async_uploads.num;
+		if (needed > MAX_ASYNC_UPLOADS - count)
+			needed = MAX_ASYNC_UPLOADS - count;
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+
+	for (size_t i = 0; i < needed; i++) {
+		struct async_upload upload;
+
+		upload.buffer = gs_upload_buffer_create(size);
+		if (!upload.buffer) {
+			blog(LOG_WARNING, "Failed to create async upload "
+			                  "buffer, uploading from system "
+			                  "memory instead");
+			obs->video.async_uploads_available = false;
+			break;
+		}
+
+		upload.data = gs_upload_buffer_get_data(upload.buffer);
+		upload.size = size;
+
+		pthread_mutex_lock(&source->async_mutex);
+		if (size == source->async_upload_size) {
+			da_push_back(source->async_uploads, &upload);
+			upload.buffer = NULL;
+		}
+		pthread_mutex_unlock(&source->async_mutex);
+
+		gs_upload_buffer_destroy(upload.buffer);
+	}
+}
+
 static void obs_source_update_async_video(obs_source_t *source)
 {
+	update_async_uploads(source);
+
 	if (!source->async_rendered) {
 		struct obs_source_frame *frame = obs_source_get_frame(source);
 
@@ -1802,11 +2056,72 @@ void obs_source_video_render(obs_source_t *source)
 	if (!obs_source_valid(source, "obs_source_video_render"))
 		return;
 
+	/* sources rendered without being shown still need their per-frame
+	 * render state reset */
+	obs_source_request_tick(source);
+
 	obs_source_addref(source);
 	render_video(source);
 	obs_source_release(source);
 }
 
+void obs_source_mark_dirty(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_mark_dirty"))
+		return;
+
+	os_atomic_inc_long(&source->render_version);
+}
+
+static inline bool render_static(const obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+	return (flags & OBS_SOURCE_STATIC_RENDER) != 0 &&
+	       (flags & OBS_SOURCE_ASYNC) == 0;
+}
+
+/* the version changes whenever the output of the source (including its
+ * filters) may have changed.  returns false if the output can change without
+ * notice, in which case it can't be cached */
+bool obs_source_get_render_version(obs_source_t *source, uint64_t *version)
+{
+	uint64_t v = RENDER_VERSION_INIT;
+	bool success = true;
+	long own;
+
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE) {
+		if (!obs_scene_get_render_version(source->context.data, &v))
+			return false;
+	} else if (!render_static(source)) {
+		return false;
+	}
+
+	own = os_atomic_load_long(&source->render_version);
+	v = render_version_mix(v, &own, sizeof(own));
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+
+		if (!render_static(filter)) {
+			success = false;
+			break;
+		}
+
+		own = os_atomic_load_long(&filter->render_version);
+		v = render_version_mix(v, &filter, sizeof(filter));
+		v = render_version_mix(v, &filter->enabled,
+				sizeof(filter->enabled));
+		v = render_version_mix(v, &own, sizeof(own));
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	*version = v;
+	return success;
+}
+
 static uint32_t get_base_width(const obs_source_t *source)
 {
 	bool is_filter = !!source->filter_parent;
@@ -1965,6 +2280,8 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_request_tick(filter);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -2223,7 +2540,7 @@ static inline void copy_frame_data_y800(struct obs_source_frame *dst,
 	}
 }
 
-static void copy_frame_data(struct obs_source_frame *dst,
+static inline void copy_frame_info(struct obs_source_frame *dst,
 		const struct obs_source_frame *src)
 {
 	dst->flip         = src->flip;
@@ -2235,6 +2552,12 @@ static void copy_frame_data(struct obs_source_frame *dst,
 		memcpy(dst->color_range_min, src->color_range_min, size);
 		memcpy(dst->color_range_max, src->color_range_max, size);
 	}
+}
+
+static void copy_frame_data(struct obs_source_frame *dst,
+		const struct obs_source_frame *src)
+{
+	copy_frame_info(dst, src);
 
 	switch (src->format) {
 	case VIDEO_FORMAT_I420:
@@ -2303,7 +2626,7 @@ static void clean_cache(obs_source_t *source)
 		struct async_frame *af = &source->async_cache.array[i - 1];
 		if (!af->used) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
+				async_frame_destroy(af->frame);
 				da_erase(source->async_cache, i - 1);
 			}
 		}
@@ -2312,18 +2635,14 @@ static void clean_cache(obs_source_t *source)
 
 #define MAX_ASYNC_FRAMES 30
 
-static inline struct obs_source_frame *cache_video(struct obs_source *source,
+/* must be called with the async mutex held */
+static inline bool prepare_async_cache(struct obs_source *source,
 		const struct obs_source_frame *frame)
 {
-	struct obs_source_frame *new_frame = NULL;
-
-	pthread_mutex_lock(&source->async_mutex);
-
 	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
 		free_async_cache(source);
 		source->last_frame_ts = 0;
-		pthread_mutex_unlock(&source->async_mutex);
-		return NULL;
+		return false;
 	}
 
 	if (async_texture_changed(source, frame)) {
@@ -2333,16 +2652,158 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 		source->async_cache_format = frame->format;
 	}
 
+	return true;
+}
+
+static inline bool async_upload_format(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		return true;
+
+	case VIDEO_FORMAT_NONE:
+	case VIDEO_FORMAT_I444:
+	case VIDEO_FORMAT_Y800:
+		return false;
+	}
+
+	return false;
+}
+
+/* must be called with the async mutex held.  frames that are backed by an
+ * upload buffer are preferred, other unused frames are only reused when no
+ * upload buffer is ready so that they age out of the cache */
+static struct obs_source_frame *reuse_cached_frame(struct obs_source *source)
+{
+	struct async_frame *reuse = NULL;
+
 	for (size_t i = 0; i < source->async_cache.num; i++) {
 		struct async_frame *af = &source->async_cache.array[i];
-		if (!af->used) {
-			new_frame = af->frame;
-			af->used = true;
-			af->unused_count = 0;
+		if (af->used || af->upload_pending)
+			continue;
+
+		if (af->frame->upload) {
+			reuse = af;
 			break;
+		} else if (!reuse) {
+			reuse = af;
 		}
 	}
 
+	if (!reuse)
+		return NULL;
+	if (!reuse->frame->upload && source->async_upload_size &&
+	    source->async_uploads.num)
+		return NULL;
+
+	reuse->used = true;
+	reuse->unused_count = 0;
+	return reuse->frame;
+}
+
+/* must be called with the async mutex held */
+static struct obs_source_frame *create_upload_frame(struct obs_source *source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame;
+	struct async_upload upload;
+	size_t offsets[MAX_AV_PLANES];
+	size_t size;
+
+	if (!obs->video.async_uploads_available)
+		return NULL;
+	if (!async_upload_format(format)) {
+		source->async_upload_size = 0;
+		return NULL;
+	}
+
+	frame = bzalloc(sizeof(struct obs_source_frame));
+	size = video_frame_get_layout(format, width, height, offsets,
+			frame->linesize);
+
+	/* lets the graphics thread know which buffers to prepare */
+	source->async_upload_size = size;
+
+	if (!size || !source->async_uploads.num) {
+		bfree(frame);
+		return NULL;
+	}
+
+	upload = source->async_uploads.array[source->async_uploads.num - 1];
+	if (upload.size != size) {
+		bfree(frame);
+		return NULL;
+	}
+
+	da_pop_back(source->async_uploads);
+
+	frame->upload = upload.buffer;
+	frame->format = format;
+	frame->width  = width;
+	frame->height = height;
+	frame->data[0] = upload.data;
+	for (size_t i = 1; i < MAX_AV_PLANES; i++) {
+		if (frame->linesize[i])
+			frame->data[i] = upload.data + offsets[i];
+	}
+
+	return frame;
+}
+
+/* frame data comes from the frame pool shared by all sources, returns NULL
+ * if the pool limit has been reached */
+static struct obs_source_frame *create_pooled_frame(enum video_format format,
+		uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame;
+	size_t offsets[MAX_AV_PLANES];
+	uint8_t *data;
+	size_t size;
+
+	frame = bzalloc(sizeof(struct obs_source_frame));
+	size = video_frame_get_layout(format, width, height, offsets,
+			frame->linesize);
+
+	data = obs_frame_pool_alloc(size);
+	if (!data) {
+		bfree(frame);
+		return NULL;
+	}
+
+	frame->pooled = true;
+	frame->format = format;
+	frame->width  = width;
+	frame->height = height;
+	frame->data[0] = data;
+	for (size_t i = 1; i < MAX_AV_PLANES; i++) {
+		if (frame->linesize[i])
+			frame->data[i] = data + offsets[i];
+	}
+
+	return frame;
+}
+
+static inline struct obs_source_frame *cache_video(struct obs_source *source,
+		const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *new_frame = NULL;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (!prepare_async_cache(source, frame)) {
+		pthread_mutex_unlock(&source->async_mutex);
+		return NULL;
+	}
+
+	new_frame = reuse_cached_frame(source);
+
 	clean_cache(source);
 
 	if (!new_frame) {
@@ -2352,10 +2813,19 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 		if (format == VIDEO_FORMAT_Y800)
 			format = VIDEO_FORMAT_BGRX;
 
-		new_frame = obs_source_frame_create(format,
+		new_frame = create_upload_frame(source, format,
 				frame->width, frame->height);
+		if (!new_frame)
+			new_frame = create_pooled_frame(format,
+					frame->width, frame->height);
+		if (!new_frame) {
+			pthread_mutex_unlock(&source->async_mutex);
+			return NULL;
+		}
+
 		new_af.frame = new_frame;
 		new_af.used = true;
+		new_af.upload_pending = false;
 		new_af.unused_count = 0;
 		new_frame->refs = 1;
 
@@ -2369,7 +2839,7 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 	copy_frame_data(new_frame, frame);
 
 	if (os_atomic_dec_long(&new_frame->refs) == 0) {
-		obs_source_frame_destroy(new_frame);
+		async_frame_destroy(new_frame);
 		new_frame = NULL;
 	}
 
@@ -2397,9 +2867,123 @@ void obs_source_output_video(obs_source_t *source,
 		da_push_back(source->async_frames, &output);
 		pthread_mutex_unlock(&source->async_mutex);
 		source->async_active = true;
+		obs_source_request_tick(source);
+	}
+}
+
+/* formats converted on the GPU are uploaded as a single texture, so their
+ * planes have to be laid out exactly like the planes of cached frames */
+static bool async_frame_layout_valid(const struct obs_source_frame *frame)
+{
+	size_t offsets[MAX_AV_PLANES];
+	uint32_t linesize[MAX_AV_PLANES];
+	enum convert_type type = get_convert_type(frame->format);
+
+	if (type != CONVERT_420 && type != CONVERT_NV12)
+		return true;
+
+	video_frame_get_layout(frame->format, frame->width, frame->height,
+			offsets, linesize);
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		if (!linesize[i])
+			break;
+		if (frame->linesize[i] != linesize[i] ||
+		    frame->data[i] != frame->data[0] + offsets[i])
+			return false;
+	}
+
+	return true;
+}
+
+static struct obs_source_frame *queue_external_video(
+		struct obs_source *source,
+		const struct obs_source_frame *frame,
+		void (*release)(void *param), void *param)
+{
+	struct external_frame *ext;
+	struct async_frame new_af;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (!prepare_async_cache(source, frame)) {
+		pthread_mutex_unlock(&source->async_mutex);
+		release(param);
+		return NULL;
+	}
+
+	clean_cache(source);
+
+	ext = bzalloc(sizeof(struct external_frame));
+	ext->release = release;
+	ext->param   = param;
+
+	memcpy(ext->frame.data, frame->data, sizeof(frame->data));
+	memcpy(ext->frame.linesize, frame->linesize, sizeof(frame->linesize));
+	ext->frame.width  = frame->width;
+	ext->frame.height = frame->height;
+	ext->frame.format = frame->format;
+	copy_frame_info(&ext->frame, frame);
+
+	ext->frame.refs     = 1;
+	ext->frame.external = true;
+
+	new_af.frame = &ext->frame;
+	new_af.used = true;
+	new_af.unused_count = 0;
+	da_push_back(source->async_cache, &new_af);
+
+	pthread_mutex_unlock(&source->async_mutex);
+	return &ext->frame;
+}
+
+void obs_source_output_video2(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		void (*release)(void *param), void *param)
+{
+	struct obs_source_frame *output;
+
+	if (!obs_ptr_valid(release, "obs_source_output_video2"))
+		return;
+	if (!obs_source_valid(source, "obs_source_output_video2")) {
+		release(param);
+		return;
+	}
+
+	/* deactivation, formats converted on the CPU and planes that cannot be
+	 * uploaded directly take the copying path */
+	if (!frame || frame->format == VIDEO_FORMAT_Y800 ||
+	    !async_frame_layout_valid(frame)) {
+		if (frame)
+			source->async_ref_copied_frames++;
+		obs_source_output_video(source, frame);
+		release(param);
+		return;
+	}
+
+	output = queue_external_video(source, frame, release, param);
+
+	if (output) {
+		source->async_ref_frames++;
+		pthread_mutex_lock(&source->async_mutex);
+		da_push_back(source->async_frames, &output);
+		pthread_mutex_unlock(&source->async_mutex);
+		source->async_active = true;
+		obs_source_request_tick(source);
 	}
 }
 
+void obs_source_flush_async_video(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_flush_async_video"))
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+	free_async_cache(source);
+	source->last_frame_ts = 0;
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
 static inline bool preload_frame_changed(obs_source_t *source,
 		const struct obs_source_frame *in)
 {
@@ -2477,6 +3061,39 @@ static inline struct obs_audio_data *filter_async_audio(obs_source_t *source,
 	return in;
 }
 
+static inline uint64_t filter_audio_latency(obs_source_t *filter)
+{
+	return filter->context.data && filter->info.get_audio_latency ?
+		filter->info.get_audio_latency(filter->context.data) : 0;
+}
+
+/* must be called with the filter mutex held */
+static uint64_t filter_chain_audio_latency(obs_source_t *source)
+{
+	uint64_t latency = 0;
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		struct obs_source *filter = source->filters.array[i];
+
+		if (filter->enabled)
+			latency += filter_audio_latency(filter);
+	}
+
+	return latency;
+}
+
+static void update_audio_latency(obs_source_t *source)
+{
+	uint64_t latency = filter_chain_audio_latency(source);
+
+	if (latency != source->audio_latency) {
+		blog(LOG_DEBUG, "Audio filter latency of source '%s' changed "
+				"to %"PRIu64" ms",
+				source->context.name, latency / 1000000);
+		source->audio_latency = latency;
+	}
+}
+
 static inline void reset_resampler(obs_source_t *source,
 		const struct obs_source_audio *audio)
 {
@@ -2608,6 +3225,7 @@ void obs_source_output_audio(obs_source_t *source,
 	process_audio(source, audio);
 
 	pthread_mutex_lock(&source->filter_mutex);
+	update_audio_latency(source);
 	output = filter_async_audio(source, &source->audio_data);
 
 	if (output) {
@@ -2636,7 +3254,12 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 		struct async_frame *f = &source->async_cache.array[i];
 
 		if (f->frame == frame) {
-			f->used = false;
+			if (frame->external) {
+				da_erase(source->async_cache, i);
+				obs_source_frame_decref(frame);
+			} else {
+				f->used = false;
+			}
 			break;
 		}
 	}
@@ -2786,12 +3409,12 @@ void obs_source_release_frame(obs_source_t *source,
 		return;
 
 	if (!source) {
-		obs_source_frame_destroy(frame);
+		async_frame_destroy(frame);
 	} else {
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			async_frame_destroy(frame);
 		else
 			remove_async_frame(source, frame);
 
@@ -3038,6 +3661,20 @@ void obs_source_skip_video_filter(obs_source_t *filter)
 	}
 }
 
+struct obs_audio_data *obs_source_filter_audio(obs_source_t *filter,
+		struct obs_audio_data *audio)
+{
+	if (!obs_source_valid(filter, "obs_source_filter_audio"))
+		return NULL;
+	if (!obs_ptr_valid(audio, "obs_source_filter_audio"))
+		return NULL;
+
+	if (!filter->context.data || !filter->info.filter_audio)
+		return audio;
+
+	return filter->info.filter_audio(filter->context.data, audio);
+}
+
 signal_handler_t *obs_source_get_signal_handler(const obs_source_t *source)
 {
 	return obs_source_valid(source, "obs_source_get_signal_handler") ?
@@ -3110,6 +3747,23 @@ int64_t obs_source_get_sync_offset(const obs_source_t *source)
 		source->sync_offset : 0;
 }
 
+uint64_t obs_source_get_audio_latency(obs_source_t *source)
+{
+	uint64_t latency;
+
+	if (!obs_source_valid(source, "obs_source_get_audio_latency"))
+		return 0;
+
+	if (source->info.type == OBS_SOURCE_TYPE_FILTER)
+		return filter_audio_latency(source);
+
+	pthread_mutex_lock(&source->filter_mutex);
+	latency = filter_chain_audio_latency(source);
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return latency;
+}
+
 struct source_enum_data {
 	obs_source_enum_proc_t enum_callback;
 	void *param;
@@ -4061,12 +4715,14 @@ void obs_source_set_monitoring_type(obs_source_t *source,
 	now_on = type != OBS_MONITORING_TYPE_NONE;
 
 	if (was_on != now_on) {
+		pthread_mutex_lock(&obs->audio.monitoring_mutex);
 		if (!was_on) {
 			source->monitor = audio_monitor_create(source);
 		} else {
 			audio_monitor_destroy(source->monitor);
 			source->monitor = NULL;
 		}
+		pthread_mutex_unlock(&obs->audio.monitoring_mutex);
 	}
 
 	source->monitoring_type = type;
@@ -4079,6 +4735,26 @@ enum obs_monitoring_type obs_source_get_monitoring_type(
 		source->monitoring_type : OBS_MONITORING_TYPE_NONE;
 }
 
+bool obs_source_get_audio_monitoring_stats(obs_source_t *source,
+		struct obs_audio_monitoring_stats *stats)
+{
+	bool success;
+
+	if (!obs_source_valid(source, "obs_source_get_audio_monitoring_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_source_get_audio_monitoring_stats"))
+		return false;
+
+	memset(stats, 0, sizeof(*stats));
+
+	/* the monitor is destroyed when monitoring is turned off */
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+	success = source->monitor ?
+		audio_monitor_get_stats(source->monitor, stats) : false;
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+	return success;
+}
+
 void obs_source_set_async_unbuffered(obs_source_t *source, bool unbuffered)
 {
 	if (!obs_source_valid(source, "obs_source_set_async_unbuffered"))
@@ -135,6 +135,43 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_CAP_DISABLED (1<<10)
 
+/**
+ * Source needs its video_tick callback called every frame
+ *
+ * By default sources are only ticked while they are showing, active, have
+ * async frames queued or have just been rendered.  Sources that need to do
+ * work in video_tick regardless of whether they are being displayed should
+ * set this flag.
+ */
+#define OBS_SOURCE_ALWAYS_TICK (1<<11)
+
+/**
+ * Source's video_tick callback is thread-safe and mostly CPU work
+ *
+ * The video_tick callback of sources with this flag may be called from a
+ * worker thread, at the same time as the video_tick callbacks of other
+ * sources.  It must only touch data of its own source, and must enter the
+ * graphics context with obs_enter_graphics to use the graphics subsystem.
+ *
+ * The show/hide/activate/deactivate callbacks and the deferred updates of
+ * video sources are called on the graphics thread before any parallel tick
+ * of that frame starts, so they never overlap with it.  Updates of sources
+ * without OBS_SOURCE_VIDEO are not deferred and are called on whatever
+ * thread calls obs_source_update, so they must be synchronized with the
+ * tick by the source itself.
+ */
+#define OBS_SOURCE_PARALLEL_TICK (1<<12)
+
+/**
+ * Source's output only changes when its settings are updated or when it
+ * calls obs_source_mark_dirty
+ *
+ * Scenes with render caching enabled can reuse their previous render while
+ * all of their items are unchanged sources with this flag.  Async sources
+ * are never cached.
+ */
+#define OBS_SOURCE_STATIC_RENDER (1<<13)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -452,6 +489,17 @@ struct obs_source_info {
 	 * @return          The properties data
 	 */
 	obs_properties_t *(*get_properties2)(void *data, void *type_data);
+
+	/**
+	 * Returns how long an audio filter holds audio back before passing
+	 * it on, for filters that buffer audio internally.  Called before
+	 * each packet is filtered, so filters whose buffering varies should
+	 * report the amount they currently hold.
+	 *
+	 * @param  data  Filter data
+	 * @return       Added latency in nanoseconds
+	 */
+	uint64_t (*get_audio_latency)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
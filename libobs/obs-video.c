@@ -23,11 +23,159 @@
 #include "graphics/vec4.h"
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
+#include "util/platform.h"
+
+#define MAX_TICK_THREADS 8
+
+static void run_tick_jobs(struct obs_tick_pool *pool)
+{
+	long idx;
+
+	while ((idx = os_atomic_inc_long(&pool->next_job) - 1) <
+			(long)pool->jobs.num) {
+		struct obs_source *source = pool->jobs.array[idx];
+		source->info.video_tick(source->context.data, pool->seconds);
+	}
+}
+
+static void *tick_thread(void *param)
+{
+	struct obs_tick_pool *pool = param;
+
+	os_set_thread_name("libobs: tick thread");
+
+	for (;;) {
+		os_sem_wait(pool->start_sem);
+		if (pool->stop)
+			break;
+
+		run_tick_jobs(pool);
+
+		if (os_atomic_dec_long(&pool->working) == 0)
+			os_event_signal(pool->done_event);
+	}
+
+	return NULL;
+}
+
+static void tick_pool_free(struct obs_tick_pool *pool)
+{
+	if (pool->initialized) {
+		pool->stop = true;
+		for (size_t i = 0; i < pool->num_threads; i++)
+			os_sem_post(pool->start_sem);
+		for (size_t i = 0; i < pool->num_threads; i++)
+			pthread_join(pool->threads[i], NULL);
+	}
+
+	os_sem_destroy(pool->start_sem);
+	os_event_destroy(pool->done_event);
+	bfree(pool->threads);
+	da_free(pool->jobs);
+	memset(pool, 0, sizeof(*pool));
+}
+
+/* threads are only created once a source with OBS_SOURCE_PARALLEL_TICK is
+ * ticked.  returns false if the ticks have to be done serially */
+static bool tick_pool_init(struct obs_tick_pool *pool)
+{
+	int cores;
+
+	if (pool->initialized)
+		return true;
+	if (pool->stop)
+		return false;
+
+	/* the graphics thread also runs jobs while waiting */
+	cores = os_get_logical_cores() - 1;
+	if (cores > MAX_TICK_THREADS)
+		cores = MAX_TICK_THREADS;
+	if (cores <= 0)
+		goto fail;
+
+	if (os_sem_init(&pool->start_sem, 0) != 0)
+		goto fail;
+	if (os_event_init(&pool->done_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	pool->threads = bzalloc(sizeof(pthread_t) * cores);
+
+	for (int i = 0; i < cores; i++) {
+		if (pthread_create(&pool->threads[i], NULL, tick_thread,
+					pool) != 0)
+			break;
+		pool->num_threads++;
+	}
+
+	if (!pool->num_threads)
+		goto fail;
+
+	pool->initialized = true;
+	blog(LOG_INFO, "Created %d source tick thread(s)",
+			(int)pool->num_threads);
+	return true;
+
+fail:
+	blog(LOG_WARNING, "Failed to create source tick threads, "
+			"ticking sources serially");
+	tick_pool_free(pool);
+	pool->stop = true;
+	return false;
+}
+
+static void tick_pool_start(struct obs_tick_pool *pool, float seconds)
+{
+	size_t threads = pool->num_threads;
+
+	if (threads > pool->jobs.num)
+		threads = pool->jobs.num;
+
+	pool->seconds  = seconds;
+	pool->next_job = 0;
+	pool->working  = (long)threads;
+
+	for (size_t i = 0; i < threads; i++)
+		os_sem_post(pool->start_sem);
+}
+
+static void tick_pool_wait(struct obs_tick_pool *pool)
+{
+	run_tick_jobs(pool);
+
+	/* the last thread to finish always signals */
+	os_event_wait(pool->done_event);
+}
+
+/* filters follow the state of the source they are attached to */
+static inline bool source_keeps_ticking(struct obs_source *source)
+{
+	struct obs_source *target = source->filter_parent ?
+		source->filter_parent : source;
+
+	if ((source->info.output_flags & OBS_SOURCE_ALWAYS_TICK) != 0 ||
+	    source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		return true;
+	if (target->show_refs || target->activate_refs ||
+	    target->showing || target->active)
+		return true;
+
+	return source->defer_update || source->async_frames.num;
+}
+
+static inline bool use_tick_pool(struct obs_tick_pool *pool,
+		struct obs_source *source)
+{
+	return (source->info.output_flags & OBS_SOURCE_PARALLEL_TICK) != 0 &&
+		source->context.data && source->info.video_tick &&
+		tick_pool_init(pool);
+}
 
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
 	struct obs_core_data *data = &obs->data;
+	struct obs_tick_pool *pool = &obs->video.tick_pool;
 	struct obs_source    *source;
+	struct darray        swap;
 	uint64_t             delta_time;
 	float                seconds;
 
@@ -56,14 +204,70 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 
 	pthread_mutex_lock(&data->sources_mutex);
 
-	source = data->first_source;
-	while (source) {
-		obs_source_video_tick(source, seconds);
-		source = (struct obs_source*)source->context.next;
+	/* only sources in the tick list are ticked, rather than every source
+	 * in the collection */
+	pthread_mutex_lock(&data->tick_sources_mutex);
+	swap = data->ticking_sources.da;
+	data->ticking_sources.da = data->tick_sources.da;
+	data->tick_sources.da = swap;
+
+	for (size_t i = 0; i < data->ticking_sources.num; i++) {
+		source = data->ticking_sources.array[i];
+		source->tick_queued = false;
+
+		/* queued before it started being destroyed */
+		if (source->destroying)
+			data->ticking_sources.array[i] = NULL;
 	}
+	pthread_mutex_unlock(&data->tick_sources_mutex);
+
+	/* state callbacks must all be done before the parallel ticks start,
+	 * see OBS_SOURCE_PARALLEL_TICK */
+	for (size_t i = 0; i < data->ticking_sources.num; i++) {
+		source = data->ticking_sources.array[i];
+		if (!source)
+			continue;
+
+		obs_source_tick_state(source);
+	}
+
+	for (size_t i = 0; i < data->ticking_sources.num; i++) {
+		source = data->ticking_sources.array[i];
+		if (source && use_tick_pool(pool, source))
+			da_push_back(pool->jobs, &source);
+	}
+
+	/* thread-safe ticks are done first so that nothing on this thread can
+	 * destroy a source while it's being ticked */
+	if (pool->jobs.num) {
+		tick_pool_start(pool, seconds);
+		tick_pool_wait(pool);
+		da_resize(pool->jobs, 0);
+	}
+
+	for (size_t i = 0; i < data->ticking_sources.num; i++) {
+		source = data->ticking_sources.array[i];
+		if (source && source->context.data && source->info.video_tick &&
+		    !use_tick_pool(pool, source))
+			source->info.video_tick(source->context.data, seconds);
+	}
+
+	pthread_mutex_lock(&data->tick_sources_mutex);
+	for (size_t i = 0; i < data->ticking_sources.num; i++) {
+		source = data->ticking_sources.array[i];
+		if (source && !source->tick_queued &&
+		    source_keeps_ticking(source)) {
+			da_push_back(data->tick_sources, &source);
+			source->tick_queued = true;
+		}
+	}
+	da_resize(data->ticking_sources, 0);
+	pthread_mutex_unlock(&data->tick_sources_mutex);
 
 	pthread_mutex_unlock(&data->sources_mutex);
 
+	obs_frame_pool_trim(&data->frame_pool);
+
 	return cur_time;
 }
 
@@ -243,12 +447,6 @@ end:
 	profile_end(render_output_texture_name);
 }
 
-static inline void set_eparam(gs_effect_t *effect, const char *name, float val)
-{
-	gs_eparam_t *param = gs_effect_get_param_by_name(effect, name);
-	gs_effect_set_float(param, val);
-}
-
 static const char *render_convert_texture_name = "render_convert_texture";
 static void render_convert_texture(struct obs_core_video *video,
 		int cur_texture, int prev_texture)
@@ -262,26 +460,29 @@ static void render_convert_texture(struct obs_core_video *video,
 	size_t       passes, i;
 
 	gs_effect_t    *effect  = video->conversion_effect;
-	gs_eparam_t    *image   = gs_effect_get_param_by_name(effect, "image");
 	gs_technique_t *tech    = gs_effect_get_technique(effect,
 			video->conversion_tech);
+	struct obs_conversion_params *params = &video->conversion_params;
 
 	if (!video->textures_output[prev_texture])
 		goto end;
 
-	set_eparam(effect, "u_plane_offset", (float)video->plane_offsets[1]);
-	set_eparam(effect, "v_plane_offset", (float)video->plane_offsets[2]);
-	set_eparam(effect, "width",  fwidth);
-	set_eparam(effect, "height", fheight);
-	set_eparam(effect, "width_i",  1.0f / fwidth);
-	set_eparam(effect, "height_i", 1.0f / fheight);
-	set_eparam(effect, "width_d2",  fwidth  * 0.5f);
-	set_eparam(effect, "height_d2", fheight * 0.5f);
-	set_eparam(effect, "width_d2_i",  1.0f / (fwidth  * 0.5f));
-	set_eparam(effect, "height_d2_i", 1.0f / (fheight * 0.5f));
-	set_eparam(effect, "input_height", (float)video->conversion_height);
-
-	gs_effect_set_texture(image, texture);
+	gs_effect_set_float(params->u_plane_offset,
+			(float)video->plane_offsets[1]);
+	gs_effect_set_float(params->v_plane_offset,
+			(float)video->plane_offsets[2]);
+	gs_effect_set_float(params->width,  fwidth);
+	gs_effect_set_float(params->height, fheight);
+	gs_effect_set_float(params->width_i,  1.0f / fwidth);
+	gs_effect_set_float(params->height_i, 1.0f / fheight);
+	gs_effect_set_float(params->width_d2,  fwidth  * 0.5f);
+	gs_effect_set_float(params->height_d2, fheight * 0.5f);
+	gs_effect_set_float(params->width_d2_i,  1.0f / (fwidth  * 0.5f));
+	gs_effect_set_float(params->height_d2_i, 1.0f / (fheight * 0.5f));
+	gs_effect_set_float(params->input_height,
+			(float)video->conversion_height);
+
+	gs_effect_set_texture(params->image, texture);
 
 	gs_set_render_target(target, NULL);
 	set_render_size(video->output_width, video->conversion_height);
@@ -577,6 +778,8 @@ static inline void output_frame(void)
 	gs_flush();
 	profile_end(output_frame_gs_flush_name);
 
+	free_async_upload_garbage();
+
 	gs_leave_context();
 	profile_end(output_frame_gs_context_name);
 
@@ -597,6 +800,38 @@ static inline void output_frame(void)
 
 #define NBSP "\xC2\xA0"
 
+static inline void add_draw_stats(struct gs_draw_stats *total)
+{
+	struct gs_draw_stats stats;
+
+	gs_enter_context(obs->video.graphics);
+	gs_get_draw_stats(&stats);
+	gs_reset_draw_stats();
+	gs_leave_context();
+
+	total->draws                 += stats.draws;
+	total->sprites               += stats.sprites;
+	total->batched_sprites       += stats.batched_sprites;
+	total->shader_changes        += stats.shader_changes;
+	total->param_uploads         += stats.param_uploads;
+	total->texture_changes       += stats.texture_changes;
+	total->blend_changes         += stats.blend_changes;
+	total->render_target_changes += stats.render_target_changes;
+}
+
+static inline void average_draw_stats(struct gs_draw_stats *avg,
+		const struct gs_draw_stats *total, uint64_t frames)
+{
+	avg->draws                 = total->draws / frames;
+	avg->sprites               = total->sprites / frames;
+	avg->batched_sprites       = total->batched_sprites / frames;
+	avg->shader_changes        = total->shader_changes / frames;
+	avg->param_uploads         = total->param_uploads / frames;
+	avg->texture_changes       = total->texture_changes / frames;
+	avg->blend_changes         = total->blend_changes / frames;
+	avg->render_target_changes = total->render_target_changes / frames;
+}
+
 static const char *tick_sources_name = "tick_sources";
 static const char *render_displays_name = "render_displays";
 static const char *output_frame_name = "output_frame";
@@ -607,6 +842,7 @@ void *obs_graphics_thread(void *param)
 	uint64_t frame_time_total_ns = 0;
 	uint64_t fps_total_ns = 0;
 	uint32_t fps_total_frames = 0;
+	struct gs_draw_stats draw_stats_total = {0};
 
 	obs->video.video_time = os_gettime_ns();
 
@@ -637,6 +873,8 @@ void *obs_graphics_thread(void *param)
 		render_displays();
 		profile_end(render_displays_name);
 
+		add_draw_stats(&draw_stats_total);
+
 		frame_time_ns = os_gettime_ns() - frame_start;
 
 		profile_end(video_thread_name);
@@ -654,6 +892,11 @@ void *obs_graphics_thread(void *param)
 				((double)fps_total_ns / 1000000000.0);
 			obs->video.video_avg_frame_time_ns =
 				frame_time_total_ns / (uint64_t)fps_total_frames;
+			average_draw_stats(&obs->video.video_avg_draw_stats,
+					&draw_stats_total,
+					(uint64_t)fps_total_frames);
+
+			memset(&draw_stats_total, 0, sizeof(draw_stats_total));
 
 			frame_time_total_ns = 0;
 			fps_total_ns = 0;
@@ -661,6 +904,8 @@ void *obs_graphics_thread(void *param)
 		}
 	}
 
+	tick_pool_free(&obs->video.tick_pool);
+
 	UNUSED_PARAMETER(param);
 	return NULL;
 }
@@ -226,6 +226,35 @@ gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file)
 	return *effect;
 }
 
+#define GET_CONVERSION_PARAM(name) \
+	params->name = gs_effect_get_param_by_name(effect, #name)
+
+static void get_conversion_params(struct obs_core_video *video)
+{
+	struct obs_conversion_params *params = &video->conversion_params;
+	gs_effect_t *effect = video->conversion_effect;
+
+	GET_CONVERSION_PARAM(image);
+	GET_CONVERSION_PARAM(u_plane_offset);
+	GET_CONVERSION_PARAM(v_plane_offset);
+	GET_CONVERSION_PARAM(width);
+	GET_CONVERSION_PARAM(height);
+	GET_CONVERSION_PARAM(width_i);
+	GET_CONVERSION_PARAM(height_i);
+	GET_CONVERSION_PARAM(width_d2);
+	GET_CONVERSION_PARAM(height_d2);
+	GET_CONVERSION_PARAM(width_d2_i);
+	GET_CONVERSION_PARAM(height_d2_i);
+	GET_CONVERSION_PARAM(input_height);
+	GET_CONVERSION_PARAM(input_width_i_d2);
+	GET_CONVERSION_PARAM(int_width);
+	GET_CONVERSION_PARAM(int_input_width);
+	GET_CONVERSION_PARAM(int_u_plane_offset);
+	GET_CONVERSION_PARAM(int_v_plane_offset);
+}
+
+#undef GET_CONVERSION_PARAM
+
 static int obs_init_graphics(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -248,8 +277,15 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 		}
 	}
 
+	pthread_mutex_init_value(&video->async_upload_mutex);
+	if (pthread_mutex_init(&video->async_upload_mutex, NULL) != 0)
+		return OBS_VIDEO_FAIL;
+
 	gs_enter_context(video->graphics);
 
+	video->async_uploads_available = gs_upload_buffers_available();
+	gs_set_shader_cache_path(obs->shader_cache_path);
+
 	char *filename = find_libobs_data_file("default.effect");
 	video->default_effect = gs_effect_create_from_file(filename,
 			NULL);
@@ -277,6 +313,8 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 			NULL);
 	bfree(filename);
 
+	get_conversion_params(video);
+
 	filename = find_libobs_data_file("bicubic_scale.effect");
 	video->bicubic_effect = gs_effect_create_from_file(filename,
 			NULL);
@@ -477,8 +515,13 @@ static void obs_free_graphics(void)
 		gs_effect_destroy(video->bilinear_lowres_effect);
 		video->default_effect = NULL;
 
+		free_async_upload_garbage();
+		da_free(video->async_upload_garbage);
+
 		gs_leave_context();
 
+		pthread_mutex_destroy(&video->async_upload_mutex);
+
 		gs_destroy(video->graphics);
 		video->graphics = NULL;
 	}
@@ -501,6 +544,7 @@ static bool obs_init_audio(struct audio_output_info *ai)
 		return false;
 
 	audio->user_volume    = 1.0f;
+	audio->min_headroom   = SIZE_MAX;
 
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
@@ -543,6 +587,7 @@ static bool obs_init_data(void)
 
 	pthread_mutex_init_value(&obs->data.displays_mutex);
 	pthread_mutex_init_value(&obs->data.draw_callbacks_mutex);
+	pthread_mutex_init_value(&obs->data.tick_sources_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -562,8 +607,12 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init(&obs->data.draw_callbacks_mutex, &attr) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->tick_sources_mutex, NULL) != 0)
+		goto fail;
 	if (!obs_view_init(&data->main_view))
 		goto fail;
+	if (!obs_frame_pool_init(&data->frame_pool))
+		goto fail;
 
 	data->valid = true;
 
@@ -618,8 +667,13 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
 	pthread_mutex_destroy(&data->draw_callbacks_mutex);
+	pthread_mutex_destroy(&data->tick_sources_mutex);
 	da_free(data->draw_callbacks);
 	da_free(data->tick_callbacks);
+	da_free(data->tick_sources);
+	da_free(data->ticking_sources);
+
+	obs_frame_pool_free(&data->frame_pool);
 }
 
 static const char *obs_signals[] = {
@@ -870,6 +924,7 @@ void obs_shutdown(void)
 		profiler_name_store_free(core->name_store);
 
 	bfree(core->module_config_path);
+	bfree(core->shader_cache_path);
 	bfree(core->locale);
 	bfree(core);
 
@@ -917,6 +972,21 @@ const char *obs_get_locale(void)
 	return obs ? obs->locale : NULL;
 }
 
+void obs_set_shader_cache_path(const char *path)
+{
+	if (!obs)
+		return;
+
+	bfree(obs->shader_cache_path);
+	obs->shader_cache_path = path && *path ? bstrdup(path) : NULL;
+
+	if (obs->video.graphics) {
+		gs_enter_context(obs->video.graphics);
+		gs_set_shader_cache_path(obs->shader_cache_path);
+		gs_leave_context();
+	}
+}
+
 #define OBS_SIZE_MIN 2
 #define OBS_SIZE_MAX (32 * 1024)
 
@@ -1913,6 +1983,15 @@ uint64_t obs_get_average_frame_time_ns(void)
 	return obs ? obs->video.video_avg_frame_time_ns : 0;
 }
 
+bool obs_get_average_draw_stats(struct gs_draw_stats *stats)
+{
+	if (!obs || !stats)
+		return false;
+
+	*stats = obs->video.video_avg_draw_stats;
+	return true;
+}
+
 enum obs_obj_type obs_obj_get_type(void *obj)
 {
 	struct obs_context_data *context = obj;
@@ -1978,6 +2057,31 @@ bool obs_set_audio_monitoring_device(const char *name, const char *id)
 #endif
 }
 
+void obs_set_audio_monitoring_latency(uint32_t latency_ms)
+{
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+
+	if (obs->audio.monitoring_latency_ms != latency_ms) {
+		obs->audio.monitoring_latency_ms = latency_ms;
+
+		for (size_t i = 0; i < obs->audio.monitors.num; i++) {
+			struct audio_monitor *monitor =
+				obs->audio.monitors.array[i];
+			audio_monitor_reset(monitor);
+		}
+	}
+
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+}
+
+uint32_t obs_get_audio_monitoring_latency(void)
+{
+	return obs ? obs->audio.monitoring_latency_ms : 0;
+}
+
 void obs_get_audio_monitoring_device(const char **name, const char **id)
 {
 	if (!obs)
@@ -2054,3 +2158,34 @@ uint32_t obs_get_lagged_frames(void)
 {
 	return obs ? obs->video.lagged_frames : 0;
 }
+
+static inline uint32_t audio_frames_to_ms(size_t frames)
+{
+	size_t sample_rate = audio_output_get_sample_rate(obs->audio.audio);
+	return sample_rate ? (uint32_t)(frames * 1000 / sample_rate) : 0;
+}
+
+void obs_get_audio_buffering_info(struct obs_audio_buffering_info *info)
+{
+	struct obs_core_audio *audio;
+	size_t headroom;
+
+	if (!info)
+		return;
+
+	memset(info, 0, sizeof(*info));
+	if (!obs)
+		return;
+
+	audio = &obs->audio;
+	headroom = audio->last_min_headroom;
+
+	info->buffering_ms = audio_frames_to_ms(
+			audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES);
+	info->max_buffering_ms = audio_frames_to_ms(
+			audio->max_buffering_ticks * AUDIO_OUTPUT_FRAMES);
+	info->increases = audio->buffering_increases;
+	info->decreases = audio->buffering_decreases;
+	info->headroom_ms = headroom == SIZE_MAX ? 0 :
+		audio_frames_to_ms(headroom);
+}
@@ -62,6 +62,7 @@ typedef struct obs_service    obs_service_t;
 typedef struct obs_module     obs_module_t;
 typedef struct obs_fader      obs_fader_t;
 typedef struct obs_volmeter   obs_volmeter_t;
+typedef struct obs_loudness   obs_loudness_t;
 
 typedef struct obs_weak_source  obs_weak_source_t;
 typedef struct obs_weak_output  obs_weak_output_t;
@@ -237,6 +238,9 @@ struct obs_source_frame {
 	/* used internally by libobs */
 	volatile long       refs;
 	bool                prev_frame;
+	bool                external;
+	bool                pooled;
+	gs_upload_buffer_t  *upload;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -276,6 +280,13 @@ EXPORT void obs_set_locale(const char *locale);
 /** @return the current locale */
 EXPORT const char *obs_get_locale(void);
 
+/**
+ * Sets the directory compiled shaders are cached in, so that they don't have
+ * to be recompiled on the next run.  Can be called before or after video is
+ * initialized.  NULL disables the cache.
+ */
+EXPORT void obs_set_shader_cache_path(const char *path);
+
 /**
  * Returns the profiler name store (see util/profiler.h) used by OBS, which is
  * either a name store passed to obs_startup, an internal name store, or NULL
@@ -610,6 +621,14 @@ EXPORT void obs_enum_audio_monitoring_devices(obs_enum_audio_device_cb cb,
 EXPORT bool obs_set_audio_monitoring_device(const char *name, const char *id);
 EXPORT void obs_get_audio_monitoring_device(const char **name, const char **id);
 
+/**
+ * Sets the output latency monitoring should aim for, in milliseconds.  0 uses
+ * the default latency of the audio backend.  Currently only used with
+ * PulseAudio.
+ */
+EXPORT void obs_set_audio_monitoring_latency(uint32_t latency_ms);
+EXPORT uint32_t obs_get_audio_monitoring_latency(void);
+
 EXPORT void obs_add_tick_callback(
 		void (*tick)(void *param, float seconds),
 		void *param);
@@ -655,9 +674,51 @@ EXPORT uint64_t obs_get_video_frame_time(void);
 EXPORT double obs_get_active_fps(void);
 EXPORT uint64_t obs_get_average_frame_time_ns(void);
 
+/** Gets the average number of draws and state changes per frame */
+EXPORT bool obs_get_average_draw_stats(struct gs_draw_stats *stats);
+
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+struct obs_audio_buffering_info {
+	uint32_t buffering_ms;      /**< audio buffering currently in use */
+	uint32_t max_buffering_ms;  /**< most audio buffering used */
+	uint32_t increases;         /**< times sources were late */
+	uint32_t decreases;         /**< times unneeded buffering was removed */
+
+	/** least audio sources had buffered ahead of output over the last
+	 * measurement window */
+	uint32_t headroom_ms;
+};
+
+/**
+ * Gets audio buffering statistics.  Buffering is added when audio sources
+ * are late, and removed again a tick at a time once sources have stayed
+ * ahead of output for a while.
+ */
+EXPORT void obs_get_audio_buffering_info(struct obs_audio_buffering_info *info);
+
+struct obs_frame_pool_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t failures;
+
+	uint64_t live_bytes;
+	uint64_t idle_bytes;
+	uint64_t limit;
+};
+
+/**
+ * Sets the maximum amount of memory async source frames can use, shared by
+ * all sources.  Unused frame memory is released first when the limit is
+ * reached, after which new frames are dropped.  0 means no limit (default).
+ */
+EXPORT void obs_set_frame_pool_limit(uint64_t bytes);
+EXPORT uint64_t obs_get_frame_pool_limit(void);
+
+/** Gets the hit/miss counts and memory usage of the async frame pool */
+EXPORT bool obs_get_frame_pool_stats(struct obs_frame_pool_stats *stats);
+
 
 /* ------------------------------------------------------------------------- */
 /* Display context */
@@ -777,6 +838,13 @@ EXPORT void obs_source_update(obs_source_t *source, obs_data_t *settings);
 /** Renders a video source. */
 EXPORT void obs_source_video_render(obs_source_t *source);
 
+/**
+ * Notifies libobs that the output of a source with OBS_SOURCE_STATIC_RENDER
+ * has changed, so that cached renders containing it are redrawn.  Updating
+ * the source's settings does this automatically.
+ */
+EXPORT void obs_source_mark_dirty(obs_source_t *source);
+
 /** Gets the width of a source (if it has video) */
 EXPORT uint32_t obs_source_get_width(obs_source_t *source);
 
@@ -845,6 +913,14 @@ EXPORT void obs_source_set_sync_offset(obs_source_t *source, int64_t offset);
 /** Gets the audio sync offset (in nanoseconds) for a source */
 EXPORT int64_t obs_source_get_sync_offset(const obs_source_t *source);
 
+/**
+ * Gets the latency (in nanoseconds) added to a source's audio by its enabled
+ * audio filters, or added by the filter itself when called on a filter.
+ * Audio timing is compensated for this latency automatically, it does not
+ * need to be added to the sync offset.
+ */
+EXPORT uint64_t obs_source_get_audio_latency(obs_source_t *source);
+
 /** Enumerates active child sources used by this source */
 EXPORT void obs_source_enum_active_sources(obs_source_t *source,
 		obs_source_enum_proc_t enum_callback,
@@ -976,6 +1052,20 @@ EXPORT void obs_source_set_monitoring_type(obs_source_t *source,
 EXPORT enum obs_monitoring_type obs_source_get_monitoring_type(
 		const obs_source_t *source);
 
+struct obs_audio_monitoring_stats {
+	uint64_t frames;          /**< frames played since monitoring started */
+	uint64_t dropped_frames;  /**< frames dropped to keep latency bounded */
+	uint32_t underruns;       /**< times the output ran out of audio */
+	uint64_t latency_ns;      /**< time until audio monitored now plays */
+};
+
+/**
+ * Gets playback statistics of the source's monitor.  Returns false if the
+ * source is not being monitored, or the audio backend has no statistics.
+ */
+EXPORT bool obs_source_get_audio_monitoring_stats(obs_source_t *source,
+		struct obs_audio_monitoring_stats *stats);
+
 /** Gets private front-end settings data.  This data is saved/loaded
  * automatically.  Returns an incremented reference. */
 EXPORT obs_data_t *obs_source_get_private_settings(obs_source_t *item);
@@ -1020,6 +1110,29 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y,
 EXPORT void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
 
+/**
+ * Outputs asynchronous video data without copying it.  The frame data stays
+ * owned by the caller, and libobs keeps using it until it calls
+ * release(param), at the latest once the frame has been uploaded.
+ *
+ *   release can be called from any thread, including from within this
+ * function, and while libobs holds the source's internal locks, so it must
+ * not call back into the source's video functions.  Formats that libobs has
+ * to convert on the CPU, and planar frames whose planes are not laid out
+ * like video_frame_init would lay them out, are copied and released
+ * immediately.
+ */
+EXPORT void obs_source_output_video2(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		void (*release)(void *param), void *param);
+
+/**
+ * Drops all queued asynchronous video frames, releasing frames that were
+ * output with obs_source_output_video2.  A frame that is being uploaded at
+ * the time is released once the upload finishes.
+ */
+EXPORT void obs_source_flush_async_video(obs_source_t *source);
+
 /** Preloads asynchronous video data to allow instantaneous playback */
 EXPORT void obs_source_preload_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
@@ -1080,6 +1193,15 @@ EXPORT void obs_source_process_filter_tech_end(obs_source_t *filter,
 /** Skips the filter if the filter is invalid and cannot be rendered */
 EXPORT void obs_source_skip_video_filter(obs_source_t *filter);
 
+/**
+ * Runs an audio filter directly on the given audio data, outside of any
+ * filter chain.  Used to process audio offline, for example to benchmark
+ * filters.  Returns the filtered audio, which may be owned by the filter, or
+ * NULL if the filter is holding the audio back.
+ */
+EXPORT struct obs_audio_data *obs_source_filter_audio(obs_source_t *filter,
+		struct obs_audio_data *audio);
+
 /**
  * Adds an active child source.  Must be called by parent sources on child
  * sources when the child is added and active.  This ensures that the source is
@@ -1260,6 +1382,14 @@ EXPORT obs_source_t *obs_scene_get_source(const obs_scene_t *scene);
 /** Gets the scene from its source, or NULL if not a scene */
 EXPORT obs_scene_t *obs_scene_from_source(const obs_source_t *source);
 
+/**
+ * Enables/disables caching the scene's render.  While enabled, the scene is
+ * rendered to a texture which is reused for as long as all of its items are
+ * unchanged sources with OBS_SOURCE_STATIC_RENDER.
+ */
+EXPORT void obs_scene_set_render_cache(obs_scene_t *scene, bool enable);
+EXPORT bool obs_scene_get_render_cache(const obs_scene_t *scene);
+
 /** Determines whether a source is within a scene */
 EXPORT obs_sceneitem_t *obs_scene_find_source(obs_scene_t *scene,
 		const char *name);
@@ -14,6 +14,15 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "base.h"
@@ -87,6 +96,408 @@ static void a_free(void *ptr)
 #endif
 }
 
+/* ------------------------------------------------------------------------- */
+/* Size-class pool allocator
+ *
+ *   Blocks up to POOL_MAX_BLOCK_SIZE are rounded up to a power of two size
+ * class and recycled through a per-thread cache, which is refilled from and
+ * spilled to a global per-class depot in batches.  Larger blocks go straight
+ * to the system with a properly aligned allocation.  Every block starts with
+ * an ALIGNMENT sized header holding its class, so the user pointer keeps the
+ * usual alignment. */
+
+#define POOL_MIN_BLOCK_SIZE   64
+#define POOL_MAX_BLOCK_SIZE   (64 * 1024)
+#define POOL_NUM_CLASSES      11
+#define POOL_LARGE_CLASS      POOL_NUM_CLASSES
+#define POOL_THREAD_CACHE_MAX (256 * 1024)
+#define POOL_DEPOT_MAX        (4 * 1024 * 1024)
+
+struct pool_header {
+	size_t class_idx;
+	size_t size;
+};
+
+struct pool_block {
+	struct pool_block *next;
+};
+
+/* updated by the owning thread only, but read by bmem_pool_get_stats from
+ * any thread */
+struct pool_class_stats {
+	volatile long allocs;
+	volatile long frees;
+	volatile long cache_hits;
+	volatile long depot_hits;
+	volatile long system_allocs;
+	volatile long system_frees;
+};
+
+struct pool_thread_cache {
+	struct pool_block *blocks[POOL_NUM_CLASSES];
+	size_t num_blocks[POOL_NUM_CLASSES];
+	struct pool_class_stats stats[POOL_NUM_CLASSES + 1];
+
+	struct pool_thread_cache *next;
+	struct pool_thread_cache **prev_next;
+};
+
+struct pool_depot {
+	pthread_mutex_t mutex;
+	struct pool_block *blocks;
+	size_t num_blocks;
+};
+
+static struct pool_depot pool_depots[POOL_NUM_CLASSES] = {
+#define DEPOT_INIT {PTHREAD_MUTEX_INITIALIZER, NULL, 0}
+	DEPOT_INIT, DEPOT_INIT, DEPOT_INIT, DEPOT_INIT,
+	DEPOT_INIT, DEPOT_INIT, DEPOT_INIT, DEPOT_INIT,
+	DEPOT_INIT, DEPOT_INIT, DEPOT_INIT
+#undef DEPOT_INIT
+};
+
+static pthread_mutex_t pool_caches_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct pool_thread_cache *pool_first_cache = NULL;
+static struct bmem_pool_stats pool_exited_stats[POOL_NUM_CLASSES + 1];
+
+static pthread_once_t pool_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t pool_key;
+
+static THREAD_LOCAL struct pool_thread_cache *pool_cache = NULL;
+
+static inline size_t pool_block_size(size_t class_idx)
+{
+	return (size_t)POOL_MIN_BLOCK_SIZE << class_idx;
+}
+
+static inline size_t pool_class_max_blocks(size_t class_idx, size_t max)
+{
+	size_t count = max / pool_block_size(class_idx);
+	return count < 8 ? 8 : count;
+}
+
+static inline size_t pool_get_class(size_t size)
+{
+	size_t class_idx = 0;
+
+	size += ALIGNMENT;
+	if (size > POOL_MAX_BLOCK_SIZE)
+		return POOL_LARGE_CLASS;
+
+	while (pool_block_size(class_idx) < size)
+		class_idx++;
+	return class_idx;
+}
+
+static void *pool_system_alloc(size_t size)
+{
+#ifdef _WIN32
+	return _aligned_malloc(size, ALIGNMENT);
+#else
+	void *ptr = NULL;
+	if (posix_memalign(&ptr, ALIGNMENT, size) != 0)
+		return NULL;
+	return ptr;
+#endif
+}
+
+static void pool_system_free(void *ptr)
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+static inline uint64_t pool_load_stat(const volatile long *val)
+{
+	return (uint64_t)(unsigned long)os_atomic_load_long(val);
+}
+
+static inline void pool_add_stats(struct bmem_pool_stats *dst,
+		const struct pool_class_stats *src)
+{
+	dst->allocs        += pool_load_stat(&src->allocs);
+	dst->frees         += pool_load_stat(&src->frees);
+	dst->cache_hits    += pool_load_stat(&src->cache_hits);
+	dst->depot_hits    += pool_load_stat(&src->depot_hits);
+	dst->system_allocs += pool_load_stat(&src->system_allocs);
+	dst->system_frees  += pool_load_stat(&src->system_frees);
+}
+
+/* returns blocks to the depot, releasing whatever the depot can't hold */
+static void pool_depot_push(size_t class_idx, struct pool_block *blocks,
+		struct pool_class_stats *stats)
+{
+	struct pool_depot *depot = &pool_depots[class_idx];
+	size_t max = pool_class_max_blocks(class_idx, POOL_DEPOT_MAX);
+
+	pthread_mutex_lock(&depot->mutex);
+	while (blocks && depot->num_blocks < max) {
+		struct pool_block *next = blocks->next;
+		blocks->next = depot->blocks;
+		depot->blocks = blocks;
+		depot->num_blocks++;
+		blocks = next;
+	}
+	pthread_mutex_unlock(&depot->mutex);
+
+	while (blocks) {
+		struct pool_block *next = blocks->next;
+		pool_system_free(blocks);
+		os_atomic_inc_long(&stats->system_frees);
+		blocks = next;
+	}
+}
+
+static void pool_thread_exit(void *data)
+{
+	struct pool_thread_cache *cache = data;
+
+	for (size_t i = 0; i < POOL_NUM_CLASSES; i++)
+		pool_depot_push(i, cache->blocks[i], &cache->stats[i]);
+
+	pthread_mutex_lock(&pool_caches_mutex);
+	*cache->prev_next = cache->next;
+	if (cache->next)
+		cache->next->prev_next = cache->prev_next;
+	for (size_t i = 0; i <= POOL_NUM_CLASSES; i++)
+		pool_add_stats(&pool_exited_stats[i], &cache->stats[i]);
+	pthread_mutex_unlock(&pool_caches_mutex);
+
+	pool_cache = NULL;
+	pool_system_free(cache);
+}
+
+static void pool_create_key(void)
+{
+	pthread_key_create(&pool_key, pool_thread_exit);
+}
+
+static struct pool_thread_cache *pool_get_cache(void)
+{
+	struct pool_thread_cache *cache = pool_cache;
+	if (cache)
+		return cache;
+
+	cache = pool_system_alloc(sizeof(struct pool_thread_cache));
+	if (!cache)
+		return NULL;
+
+	memset(cache, 0, sizeof(struct pool_thread_cache));
+
+	pthread_mutex_lock(&pool_caches_mutex);
+	cache->next = pool_first_cache;
+	cache->prev_next = &pool_first_cache;
+	if (pool_first_cache)
+		pool_first_cache->prev_next = &cache->next;
+	pool_first_cache = cache;
+	pthread_mutex_unlock(&pool_caches_mutex);
+
+	pthread_once(&pool_key_once, pool_create_key);
+	pthread_setspecific(pool_key, cache);
+
+	pool_cache = cache;
+	return cache;
+}
+
+static struct pool_block *pool_refill(struct pool_thread_cache *cache,
+		size_t class_idx)
+{
+	struct pool_depot *depot = &pool_depots[class_idx];
+	size_t batch = pool_class_max_blocks(class_idx,
+			POOL_THREAD_CACHE_MAX) / 2;
+	struct pool_block *block;
+
+	pthread_mutex_lock(&depot->mutex);
+	block = depot->blocks;
+	if (block) {
+		struct pool_block *last = block;
+		size_t count = 1;
+
+		while (count < batch && last->next) {
+			last = last->next;
+			count++;
+		}
+
+		depot->blocks = last->next;
+		depot->num_blocks -= count;
+		last->next = NULL;
+
+		cache->blocks[class_idx] = block->next;
+		cache->num_blocks[class_idx] = count - 1;
+	}
+	pthread_mutex_unlock(&depot->mutex);
+
+	if (block) {
+		os_atomic_inc_long(&cache->stats[class_idx].depot_hits);
+		return block;
+	}
+
+	os_atomic_inc_long(&cache->stats[class_idx].system_allocs);
+	return pool_system_alloc(pool_block_size(class_idx));
+}
+
+static void pool_spill(struct pool_thread_cache *cache, size_t class_idx)
+{
+	size_t keep = cache->num_blocks[class_idx] / 2;
+	struct pool_block *last = cache->blocks[class_idx];
+	struct pool_block *spilled;
+
+	for (size_t i = 1; i < keep; i++)
+		last = last->next;
+
+	spilled = last->next;
+	last->next = NULL;
+	cache->num_blocks[class_idx] = keep;
+
+	pool_depot_push(class_idx, spilled, &cache->stats[class_idx]);
+}
+
+static inline void *pool_finish_block(void *block, size_t class_idx,
+		size_t size)
+{
+	struct pool_header *header = block;
+
+	if (!block)
+		return NULL;
+
+	header->class_idx = class_idx;
+	header->size      = size;
+	return (char*)block + ALIGNMENT;
+}
+
+static void *pool_malloc(size_t size)
+{
+	size_t class_idx = pool_get_class(size);
+	struct pool_thread_cache *cache = pool_get_cache();
+	struct pool_block *block;
+
+	if (class_idx == POOL_LARGE_CLASS || !cache) {
+		if (cache) {
+			struct pool_class_stats *stats =
+				&cache->stats[POOL_LARGE_CLASS];
+
+			os_atomic_inc_long(&stats->allocs);
+			os_atomic_inc_long(&stats->system_allocs);
+		}
+
+		return pool_finish_block(pool_system_alloc(size + ALIGNMENT),
+				POOL_LARGE_CLASS, size);
+	}
+
+	os_atomic_inc_long(&cache->stats[class_idx].allocs);
+
+	block = cache->blocks[class_idx];
+	if (block) {
+		cache->blocks[class_idx] = block->next;
+		cache->num_blocks[class_idx]--;
+		os_atomic_inc_long(&cache->stats[class_idx].cache_hits);
+	} else {
+		block = pool_refill(cache, class_idx);
+	}
+
+	return pool_finish_block(block, class_idx,
+			pool_block_size(class_idx) - ALIGNMENT);
+}
+
+static void pool_free(void *ptr)
+{
+	struct pool_thread_cache *cache;
+	struct pool_header *header;
+	struct pool_block *block;
+	size_t class_idx;
+
+	if (!ptr)
+		return;
+
+	header = (struct pool_header*)((char*)ptr - ALIGNMENT);
+	class_idx = header->class_idx;
+	cache = pool_get_cache();
+
+	if (class_idx == POOL_LARGE_CLASS || !cache) {
+		if (cache) {
+			struct pool_class_stats *stats =
+				&cache->stats[class_idx];
+
+			os_atomic_inc_long(&stats->frees);
+			os_atomic_inc_long(&stats->system_frees);
+		}
+
+		pool_system_free(header);
+		return;
+	}
+
+	block = (struct pool_block*)header;
+	block->next = cache->blocks[class_idx];
+	cache->blocks[class_idx] = block;
+	cache->num_blocks[class_idx]++;
+	os_atomic_inc_long(&cache->stats[class_idx].frees);
+
+	if (cache->num_blocks[class_idx] >
+			pool_class_max_blocks(class_idx, POOL_THREAD_CACHE_MAX))
+		pool_spill(cache, class_idx);
+}
+
+static void *pool_realloc(void *ptr, size_t size)
+{
+	struct pool_header *header;
+	void *new_ptr;
+
+	if (!ptr)
+		return pool_malloc(size);
+
+	header = (struct pool_header*)((char*)ptr - ALIGNMENT);
+	if (header->class_idx != POOL_LARGE_CLASS &&
+	    header->class_idx == pool_get_class(size))
+		return ptr;
+
+	new_ptr = pool_malloc(size);
+	if (!new_ptr)
+		return NULL;
+
+	memcpy(new_ptr, ptr, header->size < size ? header->size : size);
+	pool_free(ptr);
+	return new_ptr;
+}
+
+void base_get_pool_allocator(struct base_allocator *defs)
+{
+	defs->malloc  = pool_malloc;
+	defs->realloc = pool_realloc;
+	defs->free    = pool_free;
+}
+
+size_t bmem_pool_num_classes(void)
+{
+	return POOL_NUM_CLASSES + 1;
+}
+
+bool bmem_pool_get_stats(size_t idx, struct bmem_pool_stats *stats)
+{
+	struct bmem_pool_stats total;
+
+	if (idx > POOL_NUM_CLASSES || !stats)
+		return false;
+
+	pthread_mutex_lock(&pool_caches_mutex);
+
+	total = pool_exited_stats[idx];
+	for (struct pool_thread_cache *cache = pool_first_cache; cache;
+			cache = cache->next)
+		pool_add_stats(&total, &cache->stats[idx]);
+
+	pthread_mutex_unlock(&pool_caches_mutex);
+
+	*stats = total;
+	stats->block_size = idx == POOL_LARGE_CLASS ?
+		0 : pool_block_size(idx) - ALIGNMENT;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static struct base_allocator alloc = {a_malloc, a_realloc, a_free};
 static long num_allocs = 0;
 
@@ -95,11 +506,372 @@ void base_set_allocator(struct base_allocator *defs)
 	memcpy(&alloc, defs, sizeof(struct base_allocator));
 }
 
-void *bmalloc(size_t size)
+bool bmem_enable_pool(void)
+{
+	struct base_allocator defs;
+
+	if (alloc.malloc == pool_malloc)
+		return true;
+
+	if (os_atomic_load_long(&num_allocs) != 0) {
+		blog(LOG_WARNING, "bmem_enable_pool: the pool allocator "
+				"must be enabled before anything is allocated");
+		return false;
+	}
+
+	base_get_pool_allocator(&defs);
+	base_set_allocator(&defs);
+	return true;
+}
+
+bool bmem_pool_enabled(void)
+{
+	return alloc.malloc == pool_malloc;
+}
+
+void bmem_pool_log_stats(int log_level)
+{
+	if (!bmem_pool_enabled())
+		return;
+
+	blog(log_level, "Pool allocator (block size: allocs, thread cache "
+			"hits, depot hits, system allocs/frees):");
+
+	for (size_t i = 0; i < bmem_pool_num_classes(); i++) {
+		struct bmem_pool_stats stats;
+
+		if (!bmem_pool_get_stats(i, &stats) || !stats.allocs)
+			continue;
+
+		blog(log_level, "\t%7llu: %llu, %llu, %llu, %llu/%llu",
+				(unsigned long long)stats.block_size,
+				(unsigned long long)stats.allocs,
+				(unsigned long long)stats.cache_hits,
+				(unsigned long long)stats.depot_hits,
+				(unsigned long long)stats.system_allocs,
+				(unsigned long long)stats.system_frees);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Allocation tracking
+ *
+ *   When enabled, every block gets an ALIGNMENT sized header with the
+ * address of the code that allocated it and its size, and live/total usage
+ * is accounted per call site.  Sites are kept in fixed-size tables split
+ * into independently locked stripes, so tracking never allocates. */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define RETURN_ADDRESS() _ReturnAddress()
+#else
+#define RETURN_ADDRESS() __builtin_return_address(0)
+#endif
+
+#define TRACK_STRIPES      64
+#define TRACK_STRIPE_SITES 128
+
+struct track_header {
+	const void *site;
+	size_t size;
+};
+
+struct track_stripe {
+	pthread_mutex_t mutex;
+	struct bmem_site_stats sites[TRACK_STRIPE_SITES];
+	struct bmem_site_stats other;
+};
+
+static bool tracking = false;
+static struct track_stripe track_stripes[TRACK_STRIPES];
+static pthread_mutex_t track_total_mutex;
+static struct bmem_tracking_stats track_total;
+
+static inline size_t track_hash(const void *site)
+{
+	size_t val = (size_t)(uintptr_t)site;
+	val ^= val >> 16;
+	val *= 0x45d9f3b;
+	val ^= val >> 16;
+	return val;
+}
+
+static struct bmem_site_stats *track_get_site(struct track_stripe *stripe,
+		const void *site, size_t hash)
+{
+	size_t start = (hash / TRACK_STRIPES) % TRACK_STRIPE_SITES;
+
+	for (size_t i = 0; i < TRACK_STRIPE_SITES; i++) {
+		struct bmem_site_stats *entry =
+			&stripe->sites[(start + i) % TRACK_STRIPE_SITES];
+
+		if (entry->site == site)
+			return entry;
+		if (!entry->site) {
+			entry->site = site;
+			return entry;
+		}
+	}
+
+	return &stripe->other;
+}
+
+static void track_update(const void *site, size_t size, bool add)
+{
+	size_t hash = track_hash(site);
+	struct track_stripe *stripe = &track_stripes[hash % TRACK_STRIPES];
+	struct bmem_site_stats *entry;
+
+	pthread_mutex_lock(&stripe->mutex);
+	entry = track_get_site(stripe, site, hash);
+	if (add) {
+		entry->live_bytes += size;
+		entry->live_allocs++;
+		entry->total_bytes += size;
+		entry->total_allocs++;
+		if (entry->live_bytes > entry->peak_bytes)
+			entry->peak_bytes = entry->live_bytes;
+	} else {
+		entry->live_bytes -= size;
+		entry->live_allocs--;
+	}
+	pthread_mutex_unlock(&stripe->mutex);
+
+	pthread_mutex_lock(&track_total_mutex);
+	if (add) {
+		track_total.live_bytes += size;
+		track_total.live_allocs++;
+		track_total.total_bytes += size;
+		track_total.total_allocs++;
+		if (track_total.live_bytes > track_total.peak_bytes)
+			track_total.peak_bytes = track_total.live_bytes;
+	} else {
+		track_total.live_bytes -= size;
+		track_total.live_allocs--;
+	}
+	pthread_mutex_unlock(&track_total_mutex);
+}
+
+static inline void *track_finish_block(void *block, const void *site,
+		size_t size)
+{
+	struct track_header *header = block;
+
+	header->site = site;
+	header->size = size;
+	track_update(site, size, true);
+	return (char*)block + ALIGNMENT;
+}
+
+static inline struct track_header *track_get_header(void *ptr)
+{
+	return (struct track_header*)((char*)ptr - ALIGNMENT);
+}
+
+bool bmem_enable_tracking(void)
+{
+	if (tracking)
+		return true;
+
+	if (os_atomic_load_long(&num_allocs) != 0) {
+		blog(LOG_WARNING, "bmem_enable_tracking: allocation tracking "
+				"must be enabled before anything is allocated");
+		return false;
+	}
+
+	for (size_t i = 0; i < TRACK_STRIPES; i++)
+		pthread_mutex_init(&track_stripes[i].mutex, NULL);
+	pthread_mutex_init(&track_total_mutex, NULL);
+
+	tracking = true;
+	return true;
+}
+
+bool bmem_tracking_enabled(void)
+{
+	return tracking;
+}
+
+void bmem_tracking_get_stats(struct bmem_tracking_stats *stats)
+{
+	if (!tracking) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	pthread_mutex_lock(&track_total_mutex);
+	*stats = track_total;
+	pthread_mutex_unlock(&track_total_mutex);
+}
+
+void bmem_tracking_enum_sites(bmem_site_enum_func func, void *param)
+{
+	struct bmem_site_stats site;
+
+	if (!tracking)
+		return;
+
+	for (size_t i = 0; i < TRACK_STRIPES; i++) {
+		struct track_stripe *stripe = &track_stripes[i];
+
+		for (size_t j = 0; j <= TRACK_STRIPE_SITES; j++) {
+			pthread_mutex_lock(&stripe->mutex);
+			site = j < TRACK_STRIPE_SITES ?
+				stripe->sites[j] : stripe->other;
+			pthread_mutex_unlock(&stripe->mutex);
+
+			if (!site.total_allocs)
+				continue;
+			if (!func(param, &site))
+				return;
+		}
+	}
+}
+
+struct top_sites {
+	struct bmem_site_stats *sites;
+	size_t num;
+	size_t capacity;
+};
+
+static bool add_top_site(void *param, const struct bmem_site_stats *site)
+{
+	struct top_sites *top = param;
+	size_t idx = top->num;
+
+	if (!site->live_allocs)
+		return true;
+
+	if (top->num == top->capacity) {
+		if (site->live_bytes <= top->sites[top->num - 1].live_bytes)
+			return true;
+		idx--;
+	} else {
+		top->num++;
+	}
+
+	while (idx > 0 && top->sites[idx - 1].live_bytes < site->live_bytes) {
+		top->sites[idx] = top->sites[idx - 1];
+		idx--;
+	}
+
+	top->sites[idx] = *site;
+	return true;
+}
+
+static const char *module_base_name(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+	const char *bslash = strrchr(path, '\\');
+	if (bslash > slash)
+		slash = bslash;
+#endif
+	return slash ? slash + 1 : path;
+}
+
+/* Formats a call site as module+offset, with the nearest exported symbol
+ * when one is known, so addresses stay meaningful across runs with ASLR. */
+static void describe_site(char *buf, size_t size, const void *site)
+{
+#ifdef _WIN32
+	HMODULE module;
+	char path[MAX_PATH];
+
+	if (site && GetModuleHandleExA(
+				GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+				GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+				(LPCSTR)site, &module) &&
+	    GetModuleFileNameA(module, path, MAX_PATH)) {
+		snprintf(buf, size, "%s+0x%llx", module_base_name(path),
+				(unsigned long long)((const char*)site -
+					(const char*)module));
+		return;
+	}
+#else
+	Dl_info info;
+
+	if (site && dladdr(site, &info) && info.dli_fname) {
+		if (info.dli_sname && info.dli_saddr)
+			snprintf(buf, size, "%s+0x%llx (%s+0x%llx)",
+					module_base_name(info.dli_fname),
+					(unsigned long long)((const char*)site -
+						(const char*)info.dli_fbase),
+					info.dli_sname,
+					(unsigned long long)((const char*)site -
+						(const char*)info.dli_saddr));
+		else
+			snprintf(buf, size, "%s+0x%llx",
+					module_base_name(info.dli_fname),
+					(unsigned long long)((const char*)site -
+						(const char*)info.dli_fbase));
+		return;
+	}
+#endif
+
+	if (site)
+		snprintf(buf, size, "%p", site);
+	else
+		snprintf(buf, size, "(other sites)");
+}
+
+void bmem_tracking_log_top_sites(int log_level, size_t max_sites)
 {
-	void *ptr = alloc.malloc(size);
-	if (!ptr && !size)
-		ptr = alloc.malloc(1);
+	struct bmem_tracking_stats stats;
+	struct top_sites top = {0};
+
+	if (!tracking || !max_sites)
+		return;
+
+	top.capacity = max_sites;
+	top.sites = a_malloc(sizeof(struct bmem_site_stats) * max_sites);
+	if (!top.sites)
+		return;
+
+	bmem_tracking_enum_sites(add_top_site, &top);
+	bmem_tracking_get_stats(&stats);
+
+	blog(log_level, "Memory: %llu bytes in %llu allocations live, "
+			"peak %llu bytes, %llu allocations (%llu bytes) total",
+			(unsigned long long)stats.live_bytes,
+			(unsigned long long)stats.live_allocs,
+			(unsigned long long)stats.peak_bytes,
+			(unsigned long long)stats.total_allocs,
+			(unsigned long long)stats.total_bytes);
+
+	for (size_t i = 0; i < top.num; i++) {
+		struct bmem_site_stats *site = &top.sites[i];
+		char name[512];
+
+		describe_site(name, sizeof(name), site->site);
+		blog(log_level, "\t%s: %llu bytes in %llu allocations live, "
+				"peak %llu bytes, %llu allocations total",
+				name,
+				(unsigned long long)site->live_bytes,
+				(unsigned long long)site->live_allocs,
+				(unsigned long long)site->peak_bytes,
+				(unsigned long long)site->total_allocs);
+	}
+
+	a_free(top.sites);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void *bmalloc_site(size_t size, const void *site)
+{
+	void *ptr;
+
+	if (tracking) {
+		ptr = alloc.malloc(size + ALIGNMENT);
+		if (ptr)
+			ptr = track_finish_block(ptr, site, size);
+	} else {
+		ptr = alloc.malloc(size);
+		if (!ptr && !size)
+			ptr = alloc.malloc(1);
+	}
+
 	if (!ptr) {
 		os_breakpoint();
 		bcrash("Out of memory while trying to allocate %lu bytes",
@@ -110,14 +882,43 @@ void *bmalloc(size_t size)
 	return ptr;
 }
 
+void *bmalloc(size_t size)
+{
+	return bmalloc_site(size, RETURN_ADDRESS());
+}
+
+static void *brealloc_tracked(void *ptr, size_t size, const void *site)
+{
+	struct track_header *header = NULL;
+
+	if (ptr) {
+		header = track_get_header(ptr);
+		track_update(header->site, header->size, false);
+	}
+
+	ptr = alloc.realloc(header, size + ALIGNMENT);
+	if (!ptr) {
+		if (header)
+			track_update(header->site, header->size, true);
+		return NULL;
+	}
+
+	return track_finish_block(ptr, site, size);
+}
+
 void *brealloc(void *ptr, size_t size)
 {
 	if (!ptr)
 		os_atomic_inc_long(&num_allocs);
 
-	ptr = alloc.realloc(ptr, size);
-	if (!ptr && !size)
-		ptr = alloc.realloc(ptr, 1);
+	if (tracking) {
+		ptr = brealloc_tracked(ptr, size, RETURN_ADDRESS());
+	} else {
+		ptr = alloc.realloc(ptr, size);
+		if (!ptr && !size)
+			ptr = alloc.realloc(ptr, 1);
+	}
+
 	if (!ptr) {
 		os_breakpoint();
 		bcrash("Out of memory while trying to allocate %lu bytes",
@@ -131,6 +932,13 @@ void bfree(void *ptr)
 {
 	if (ptr)
 		os_atomic_dec_long(&num_allocs);
+
+	if (tracking && ptr) {
+		struct track_header *header = track_get_header(ptr);
+		track_update(header->site, header->size, false);
+		ptr = header;
+	}
+
 	alloc.free(ptr);
 }
 
@@ -146,7 +954,7 @@ int base_get_alignment(void)
 
 void *bmemdup(const void *ptr, size_t size)
 {
-	void *out = bmalloc(size);
+	void *out = bmalloc_site(size, RETURN_ADDRESS());
 	if (size)
 		memcpy(out, ptr, size);
 
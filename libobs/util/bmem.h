@@ -33,6 +33,30 @@ struct base_allocator {
 
 EXPORT void base_set_allocator(struct base_allocator *defs);
 
+/*
+ * Thread-caching size-class allocator.  To use it, call bmem_enable_pool, or
+ * pass the functions from base_get_pool_allocator to base_set_allocator,
+ * before anything has been allocated.
+ */
+
+struct bmem_pool_stats {
+	size_t   block_size; /* 0 for blocks too large to be pooled */
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t cache_hits;
+	uint64_t depot_hits;
+	uint64_t system_allocs;
+	uint64_t system_frees;
+};
+
+EXPORT void base_get_pool_allocator(struct base_allocator *defs);
+EXPORT size_t bmem_pool_num_classes(void);
+EXPORT bool bmem_pool_get_stats(size_t idx, struct bmem_pool_stats *stats);
+
+EXPORT bool bmem_enable_pool(void);
+EXPORT bool bmem_pool_enabled(void);
+EXPORT void bmem_pool_log_stats(int log_level);
+
 EXPORT void *bmalloc(size_t size);
 EXPORT void *brealloc(void *ptr, size_t size);
 EXPORT void bfree(void *ptr);
@@ -43,6 +67,37 @@ EXPORT long bnum_allocs(void);
 
 EXPORT void *bmemdup(const void *ptr, size_t size);
 
+/*
+ * Allocation tracking.  Records live and total usage per allocating call
+ * site (return address).  Must be enabled before anything is allocated.
+ */
+
+struct bmem_tracking_stats {
+	uint64_t live_bytes;
+	uint64_t live_allocs;
+	uint64_t peak_bytes;
+	uint64_t total_bytes;
+	uint64_t total_allocs;
+};
+
+struct bmem_site_stats {
+	const void *site; /* NULL for sites that did not fit in the table */
+	uint64_t   live_bytes;
+	uint64_t   live_allocs;
+	uint64_t   peak_bytes;
+	uint64_t   total_bytes;
+	uint64_t   total_allocs;
+};
+
+typedef bool (*bmem_site_enum_func)(void *param,
+		const struct bmem_site_stats *site);
+
+EXPORT bool bmem_enable_tracking(void);
+EXPORT bool bmem_tracking_enabled(void);
+EXPORT void bmem_tracking_get_stats(struct bmem_tracking_stats *stats);
+EXPORT void bmem_tracking_enum_sites(bmem_site_enum_func func, void *param);
+EXPORT void bmem_tracking_log_top_sites(int log_level, size_t max_sites);
+
 static inline void *bzalloc(size_t size)
 {
 	void *mem = bmalloc(size);
@@ -256,7 +256,10 @@ static void merge_call(profile_entry *entry, profile_call *call,
 #endif
 }
 
-static bool enabled = false;
+static void free_call_context(profile_call *context);
+
+static volatile bool enabled = false;
+static bool buffered = false;
 static pthread_mutex_t root_mutex = PTHREAD_MUTEX_INITIALIZER;
 static DARRAY(profile_root_entry) root_entries;
 
@@ -266,15 +269,20 @@ static THREAD_LOCAL bool thread_enabled = true;
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
+	buffered = false;
 	enabled = true;
 	pthread_mutex_unlock(&root_mutex);
 }
 
+static void stop_merge_thread(void);
+
 void profiler_stop(void)
 {
 	pthread_mutex_lock(&root_mutex);
 	enabled = false;
 	pthread_mutex_unlock(&root_mutex);
+
+	stop_merge_thread();
 }
 
 void profile_reenable_thread(void)
@@ -334,8 +342,6 @@ void profile_register_root(const char *name,
 	pthread_mutex_unlock(&root_mutex);
 }
 
-static void free_call_context(profile_call *context);
-
 static void merge_context(profile_call *context)
 {
 	pthread_mutex_t *mutex = NULL;
@@ -365,17 +371,11 @@ static void merge_context(profile_call *context)
 	free_call_context(prev_call);
 }
 
-void profile_start(const char *name)
+static profile_call *push_call(profile_call *parent, const char *name)
 {
-	if (!thread_enabled)
-		return;
-
 	profile_call new_call = {
 		.name = name,
-#ifdef TRACK_OVERHEAD
-		.overhead_start = os_gettime_ns(),
-#endif
-		.parent = thread_context,
+		.parent = parent,
 	};
 
 	profile_call *call = NULL;
@@ -388,17 +388,12 @@ void profile_start(const char *name)
 		memcpy(call, &new_call, sizeof(profile_call));
 	}
 
-	thread_context = call;
-	call->start_time = os_gettime_ns();
+	return call;
 }
 
-void profile_end(const char *name)
+static void pop_call(profile_call **context, const char *name, uint64_t end)
 {
-	uint64_t end = os_gettime_ns();
-	if (!thread_enabled)
-		return;
-
-	profile_call *call = thread_context;
+	profile_call *call = *context;
 	if (!call) {
 		blog(LOG_ERROR, "Called profile end with no active profile");
 		return;
@@ -420,12 +415,12 @@ void profile_end(const char *name)
 			return;
 
 		while (call->name != name) {
-			profile_end(call->name);
+			pop_call(context, call->name, end);
 			call = call->parent;
 		}
 	}
 
-	thread_context = call->parent;
+	*context = call->parent;
 
 	call->end_time = end;
 #ifdef TRACK_OVERHEAD
@@ -438,6 +433,672 @@ void profile_end(const char *name)
 	merge_context(call);
 }
 
+static void buffer_start(const char *name);
+static void buffer_end(const char *name, uint64_t end);
+
+void profile_start(const char *name)
+{
+	if (!thread_enabled)
+		return;
+
+	if (buffered) {
+		buffer_start(name);
+		return;
+	}
+
+#ifdef TRACK_OVERHEAD
+	uint64_t overhead_start = os_gettime_ns();
+#endif
+	profile_call *call = push_call(thread_context, name);
+#ifdef TRACK_OVERHEAD
+	call->overhead_start = overhead_start;
+#endif
+
+	thread_context = call;
+	call->start_time = os_gettime_ns();
+}
+
+void profile_end(const char *name)
+{
+	uint64_t end = os_gettime_ns();
+	if (!thread_enabled)
+		return;
+
+	if (buffered) {
+		buffer_end(name, end);
+		return;
+	}
+
+	pop_call(&thread_context, name, end);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Buffered profiling
+ *
+ *   Instead of building and merging call trees on the profiled thread,
+ * profile_start/profile_end write fixed-size events into a per-thread
+ * single producer/single consumer ring buffer.  A merge thread drains the
+ * buffers periodically and does all allocation and merging, so the
+ * profiled threads never lock or allocate after their first event. */
+
+#define PROFILE_BUFFER_EVENTS 4096
+#define PROFILE_MERGE_INTERVAL_MS 20
+
+typedef struct profile_event profile_event;
+struct profile_event {
+	const char *name;
+	uint64_t time;
+	bool end;
+};
+
+typedef struct profile_thread_buffer profile_thread_buffer;
+struct profile_thread_buffer {
+	profile_event events[PROFILE_BUFFER_EVENTS];
+	volatile long head;
+	volatile long tail;
+	volatile long dropped;
+	volatile bool exited;
+
+	/* profiled thread only */
+	unsigned long depth;
+	unsigned long skip_depth;
+
+	/* merge thread only */
+	profile_call *context;
+	long id;
+	const char *thread_name;
+	unsigned long timeline_depth;
+
+	profile_thread_buffer *next;
+};
+
+static pthread_mutex_t buffers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static profile_thread_buffer *first_buffer = NULL;
+static volatile long buffer_generation = 0;
+static long next_buffer_id = 0;
+static uint64_t exited_dropped = 0;
+
+static bool buffer_key_created = false;
+static pthread_key_t buffer_key;
+
+static bool merge_thread_active = false;
+static pthread_t merge_thread;
+static os_event_t *merge_stop_event = NULL;
+
+static THREAD_LOCAL profile_thread_buffer *thread_buffer = NULL;
+static THREAD_LOCAL long thread_buffer_generation = 0;
+
+/* number of threads currently writing to their buffer, so profiler_free can
+ * wait for them before freeing the buffers */
+static volatile long buffer_writers = 0;
+
+static inline bool buffer_enter(void)
+{
+	os_atomic_inc_long(&buffer_writers);
+
+	if (!os_atomic_load_bool(&enabled)) {
+		os_atomic_dec_long(&buffer_writers);
+		thread_enabled = false;
+		return false;
+	}
+
+	return true;
+}
+
+static inline void buffer_leave(void)
+{
+	os_atomic_dec_long(&buffer_writers);
+}
+
+static void wait_for_buffer_writers(void)
+{
+	/* compare_swap is a full barrier, so after enabled has been cleared
+	 * any writer either shows up here or sees that it's disabled */
+	while (!os_atomic_compare_swap_long(&buffer_writers, 0, 0))
+		os_sleep_ms(1);
+}
+
+static void buffer_thread_exit(void *data)
+{
+	profile_thread_buffer *buf;
+
+	pthread_mutex_lock(&buffers_mutex);
+	for (buf = first_buffer; buf; buf = buf->next) {
+		if (buf == data) {
+			os_atomic_set_bool(&buf->exited, true);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&buffers_mutex);
+}
+
+static profile_thread_buffer *get_thread_buffer(void)
+{
+	long generation = os_atomic_load_long(&buffer_generation);
+	profile_thread_buffer *buf = thread_buffer;
+
+	if (buf && thread_buffer_generation == generation)
+		return buf;
+
+	buf = bzalloc(sizeof(profile_thread_buffer));
+
+	pthread_mutex_lock(&buffers_mutex);
+	buf->id = ++next_buffer_id;
+	buf->next = first_buffer;
+	first_buffer = buf;
+	pthread_mutex_unlock(&buffers_mutex);
+
+	pthread_setspecific(buffer_key, buf);
+
+	thread_buffer = buf;
+	thread_buffer_generation = generation;
+	return buf;
+}
+
+static inline unsigned long buffer_free_events(profile_thread_buffer *buf)
+{
+	unsigned long used = (unsigned long)os_atomic_load_long(&buf->head) -
+		(unsigned long)os_atomic_load_long(&buf->tail);
+	return PROFILE_BUFFER_EVENTS - used;
+}
+
+static inline void buffer_push(profile_thread_buffer *buf, const char *name,
+		uint64_t time, bool end)
+{
+	unsigned long head = (unsigned long)buf->head;
+	profile_event *event = &buf->events[head % PROFILE_BUFFER_EVENTS];
+
+	event->name = name;
+	event->time = time;
+	event->end  = end;
+
+	os_atomic_inc_long(&buf->head);
+}
+
+static void buffer_start(const char *name)
+{
+	if (!buffer_enter())
+		return;
+
+	profile_thread_buffer *buf = get_thread_buffer();
+
+	/* a start is only recorded if the ends of every open call still fit,
+	 * otherwise the whole subtree is dropped */
+	if (buf->skip_depth ||
+	    buffer_free_events(buf) < buf->depth + 2) {
+		buf->skip_depth++;
+		os_atomic_inc_long(&buf->dropped);
+	} else {
+		buf->depth++;
+		buffer_push(buf, name, os_gettime_ns(), false);
+	}
+
+	buffer_leave();
+}
+
+static void buffer_end(const char *name, uint64_t end)
+{
+	if (!buffer_enter())
+		return;
+
+	profile_thread_buffer *buf = get_thread_buffer();
+
+	if (buf->skip_depth) {
+		buf->skip_depth--;
+		os_atomic_inc_long(&buf->dropped);
+	} else if (!buffer_free_events(buf)) {
+		os_atomic_inc_long(&buf->dropped);
+	} else {
+		if (buf->depth)
+			buf->depth--;
+		buffer_push(buf, name, end, true);
+	}
+
+	buffer_leave();
+}
+
+static void free_buffer_context(profile_call *call)
+{
+	if (!call)
+		return;
+
+	while (call->parent)
+		call = call->parent;
+
+	free_call_context(call);
+}
+
+static void timeline_add_event(profile_thread_buffer *buf,
+		profile_event *event);
+
+static void drain_buffer(profile_thread_buffer *buf)
+{
+	long tail = buf->tail;
+	long head = os_atomic_load_long(&buf->head);
+
+	for (long i = tail; i != head; i++) {
+		unsigned long idx = (unsigned long)i % PROFILE_BUFFER_EVENTS;
+		profile_event *event = &buf->events[idx];
+
+		if (!buf->context && !event->end && !buf->thread_name)
+			buf->thread_name = event->name;
+
+		timeline_add_event(buf, event);
+
+		if (event->end) {
+			pop_call(&buf->context, event->name, event->time);
+		} else {
+			profile_call *call = push_call(buf->context,
+					event->name);
+			call->start_time = event->time;
+#ifdef TRACK_OVERHEAD
+			call->overhead_start = event->time;
+#endif
+			buf->context = call;
+		}
+	}
+
+	os_atomic_compare_swap_long(&buf->tail, tail, head);
+}
+
+static void merge_buffers(void)
+{
+	pthread_mutex_lock(&buffers_mutex);
+
+	profile_thread_buffer **prev_next = &first_buffer;
+	profile_thread_buffer *buf = first_buffer;
+
+	while (buf) {
+		profile_thread_buffer *next = buf->next;
+		bool exited = os_atomic_load_bool(&buf->exited);
+
+		drain_buffer(buf);
+
+		if (exited) {
+			exited_dropped += (uint64_t)buf->dropped;
+			free_buffer_context(buf->context);
+			bfree(buf);
+			*prev_next = next;
+		} else {
+			prev_next = &buf->next;
+		}
+
+		buf = next;
+	}
+
+	pthread_mutex_unlock(&buffers_mutex);
+}
+
+static void *profiler_merge_thread(void *unused)
+{
+	os_set_thread_name("profiler: merge buffered events");
+
+	while (os_event_timedwait(merge_stop_event,
+				PROFILE_MERGE_INTERVAL_MS) == ETIMEDOUT)
+		merge_buffers();
+
+	merge_buffers();
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+void profiler_start_buffered(void)
+{
+	pthread_mutex_lock(&root_mutex);
+
+	if (!buffer_key_created) {
+		if (pthread_key_create(&buffer_key, buffer_thread_exit) != 0) {
+			blog(LOG_ERROR, "Failed to create profiler buffer key");
+			pthread_mutex_unlock(&root_mutex);
+			return;
+		}
+		buffer_key_created = true;
+	}
+
+	if (!merge_thread_active) {
+		if (os_event_init(&merge_stop_event, OS_EVENT_TYPE_MANUAL)
+				!= 0) {
+			blog(LOG_ERROR, "Failed to create profiler merge event");
+			pthread_mutex_unlock(&root_mutex);
+			return;
+		}
+
+		if (pthread_create(&merge_thread, NULL, profiler_merge_thread,
+					NULL) != 0) {
+			blog(LOG_ERROR, "Failed to create profiler merge "
+					"thread");
+			os_event_destroy(merge_stop_event);
+			merge_stop_event = NULL;
+			pthread_mutex_unlock(&root_mutex);
+			return;
+		}
+
+		merge_thread_active = true;
+	}
+
+	buffered = true;
+	enabled = true;
+	pthread_mutex_unlock(&root_mutex);
+}
+
+static void stop_merge_thread(void)
+{
+	bool active;
+
+	pthread_mutex_lock(&root_mutex);
+	active = merge_thread_active;
+	merge_thread_active = false;
+	pthread_mutex_unlock(&root_mutex);
+
+	if (!active)
+		return;
+
+	os_event_signal(merge_stop_event);
+	pthread_join(merge_thread, NULL);
+
+	os_event_destroy(merge_stop_event);
+	merge_stop_event = NULL;
+}
+
+static void free_buffers(void)
+{
+	profile_thread_buffer *buf;
+
+	pthread_mutex_lock(&buffers_mutex);
+
+	buf = first_buffer;
+	first_buffer = NULL;
+	exited_dropped = 0;
+	os_atomic_inc_long(&buffer_generation);
+
+	while (buf) {
+		profile_thread_buffer *next = buf->next;
+		free_buffer_context(buf->context);
+		bfree(buf);
+		buf = next;
+	}
+
+	pthread_mutex_unlock(&buffers_mutex);
+}
+
+uint64_t profiler_buffered_dropped_events(void)
+{
+	uint64_t dropped;
+
+	pthread_mutex_lock(&buffers_mutex);
+
+	dropped = exited_dropped;
+	for (profile_thread_buffer *buf = first_buffer; buf; buf = buf->next)
+		dropped += (uint64_t)os_atomic_load_long(&buf->dropped);
+
+	pthread_mutex_unlock(&buffers_mutex);
+	return dropped;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Timeline capture
+ *
+ *   While a timeline capture is active, the merge thread additionally keeps
+ * every drained event with its timestamp and thread, so the capture can be
+ * exported in the Chrome trace event format (chrome://tracing, Perfetto).
+ * Only the most recent TIMELINE_MAX_EVENTS events are kept.  Only available
+ * in buffered mode. */
+
+#define TIMELINE_MAX_EVENTS (1 << 20)
+
+typedef struct timeline_event timeline_event;
+struct timeline_event {
+	const char *name;
+	uint64_t time;
+	long thread_id;
+	bool end;
+};
+
+typedef struct timeline_thread timeline_thread;
+struct timeline_thread {
+	long id;
+	const char *name;
+
+	/* open calls while dumping */
+	unsigned long depth;
+};
+
+static pthread_mutex_t timeline_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool timeline_active = false;
+static uint64_t timeline_start_time = 0;
+static uint64_t timeline_dropped = 0;
+
+/* ring buffer once full, timeline_head is the oldest event */
+static DARRAY(timeline_event) timeline_events;
+static size_t timeline_head = 0;
+static DARRAY(timeline_thread) timeline_threads;
+
+static void timeline_add_thread(profile_thread_buffer *buf)
+{
+	for (size_t i = 0; i < timeline_threads.num; i++) {
+		timeline_thread *thread = &timeline_threads.array[i];
+		if (thread->id != buf->id)
+			continue;
+
+		if (!thread->name)
+			thread->name = buf->thread_name;
+		return;
+	}
+
+	timeline_thread *thread = da_push_back_new(timeline_threads);
+	thread->id   = buf->id;
+	thread->name = buf->thread_name;
+}
+
+/* called on the merge thread with buffers_mutex held */
+static void timeline_add_event(profile_thread_buffer *buf,
+		profile_event *event)
+{
+	pthread_mutex_lock(&timeline_mutex);
+
+	if (!timeline_active || event->time < timeline_start_time) {
+		buf->timeline_depth = 0;
+		goto unlock;
+	}
+
+	/* ends of calls that started before the capture are skipped */
+	if (event->end && !buf->timeline_depth)
+		goto unlock;
+
+	if (event->end)
+		buf->timeline_depth--;
+	else
+		buf->timeline_depth++;
+
+	timeline_event *t_event;
+	if (timeline_events.num < TIMELINE_MAX_EVENTS) {
+		t_event = da_push_back_new(timeline_events);
+	} else {
+		t_event = &timeline_events.array[timeline_head];
+		timeline_head = (timeline_head + 1) % TIMELINE_MAX_EVENTS;
+		timeline_dropped++;
+	}
+
+	t_event->name      = event->name;
+	t_event->time      = event->time;
+	t_event->thread_id = buf->id;
+	t_event->end       = event->end;
+
+	timeline_add_thread(buf);
+
+unlock:
+	pthread_mutex_unlock(&timeline_mutex);
+}
+
+bool profiler_timeline_start(void)
+{
+	bool success;
+
+	pthread_mutex_lock(&root_mutex);
+	success = buffered && enabled;
+	pthread_mutex_unlock(&root_mutex);
+
+	if (!success) {
+		blog(LOG_WARNING, "profiler_timeline_start: the profiler must "
+				"be running in buffered mode");
+		return false;
+	}
+
+	pthread_mutex_lock(&timeline_mutex);
+	da_free(timeline_events);
+	da_free(timeline_threads);
+	timeline_head = 0;
+	timeline_dropped = 0;
+	timeline_start_time = os_gettime_ns();
+	timeline_active = true;
+	pthread_mutex_unlock(&timeline_mutex);
+
+	return true;
+}
+
+void profiler_timeline_stop(void)
+{
+	pthread_mutex_lock(&timeline_mutex);
+	timeline_active = false;
+	pthread_mutex_unlock(&timeline_mutex);
+}
+
+static void timeline_free(void)
+{
+	pthread_mutex_lock(&timeline_mutex);
+	timeline_active = false;
+	da_free(timeline_events);
+	da_free(timeline_threads);
+	timeline_head = 0;
+	pthread_mutex_unlock(&timeline_mutex);
+}
+
+static void dstr_cat_json_string(struct dstr *str, const char *val)
+{
+	dstr_cat_ch(str, '"');
+
+	for (; val && *val; val++) {
+		unsigned char ch = (unsigned char)*val;
+
+		if (ch == '"' || ch == '\\') {
+			dstr_cat_ch(str, '\\');
+			dstr_cat_ch(str, (char)ch);
+		} else if (ch < 0x20) {
+			dstr_catf(str, "\\u%04x", ch);
+		} else {
+			dstr_cat_ch(str, (char)ch);
+		}
+	}
+
+	dstr_cat_ch(str, '"');
+}
+
+static timeline_thread *timeline_find_thread(long id)
+{
+	for (size_t i = 0; i < timeline_threads.num; i++) {
+		if (timeline_threads.array[i].id == id)
+			return &timeline_threads.array[i];
+	}
+
+	return NULL;
+}
+
+static void timeline_dump_event(FILE *f, struct dstr *buffer, char phase,
+		long thread_id, uint64_t time, const char *name)
+{
+	uint64_t ts = time - timeline_start_time;
+
+	dstr_printf(buffer, "{\"ph\":\"%c\",\"pid\":1,\"tid\":%ld,"
+			"\"ts\":%"PRIu64".%03u", phase, thread_id,
+			ts / 1000, (unsigned)(ts % 1000));
+	if (name) {
+		dstr_cat(buffer, ",\"name\":");
+		dstr_cat_json_string(buffer, name);
+	}
+	dstr_cat(buffer, "},\n");
+
+	fwrite(buffer->array, 1, buffer->len, f);
+}
+
+bool profiler_timeline_dump_json(const char *filename)
+{
+	struct dstr buffer = {0};
+	uint64_t last_time;
+	FILE *f = os_fopen(filename, "wb+");
+	if (!f)
+		return false;
+
+	pthread_mutex_lock(&timeline_mutex);
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+
+	for (size_t i = 0; i < timeline_threads.num; i++) {
+		timeline_thread *thread = &timeline_threads.array[i];
+
+		dstr_printf(&buffer, "{\"ph\":\"M\",\"pid\":1,\"tid\":%ld,"
+				"\"name\":\"thread_name\",\"args\":{\"name\":",
+				thread->id);
+		if (thread->name)
+			dstr_cat_json_string(&buffer, thread->name);
+		else
+			dstr_catf(&buffer, "\"thread %ld\"", thread->id);
+		dstr_cat(&buffer, "}},\n");
+
+		fwrite(buffer.array, 1, buffer.len, f);
+	}
+
+	for (size_t i = 0; i < timeline_threads.num; i++)
+		timeline_threads.array[i].depth = 0;
+
+	/* ends whose begin was overwritten are skipped, and calls still open
+	 * at the end of the capture are closed at the last event */
+	last_time = timeline_start_time;
+
+	for (size_t i = 0; i < timeline_events.num; i++) {
+		size_t idx = (timeline_head + i) % timeline_events.num;
+		timeline_event *event = &timeline_events.array[idx];
+		timeline_thread *thread = timeline_find_thread(
+				event->thread_id);
+
+		if (event->end) {
+			if (!thread->depth)
+				continue;
+			thread->depth--;
+		} else {
+			thread->depth++;
+		}
+
+		if (event->time > last_time)
+			last_time = event->time;
+
+		timeline_dump_event(f, &buffer, event->end ? 'E' : 'B',
+				event->thread_id, event->time, event->name);
+	}
+
+	for (size_t i = 0; i < timeline_threads.num; i++) {
+		timeline_thread *thread = &timeline_threads.array[i];
+
+		while (thread->depth) {
+			timeline_dump_event(f, &buffer, 'E', thread->id,
+					last_time, NULL);
+			thread->depth--;
+		}
+	}
+
+	dstr_printf(&buffer, "{\"ph\":\"M\",\"pid\":1,\"name\":"
+			"\"process_name\",\"args\":{\"name\":\"libobs\","
+			"\"dropped_events\":%"PRIu64"}}\n]}\n",
+			timeline_dropped);
+	fwrite(buffer.array, 1, buffer.len, f);
+
+	pthread_mutex_unlock(&timeline_mutex);
+
+	dstr_free(&buffer);
+	fclose(f);
+	return true;
+}
+
 static int profiler_time_entry_compare(const void *first, const void *second)
 {
 	int64_t diff = ((profiler_time_entry*)second)->time_delta -
@@ -803,6 +1464,17 @@ void profiler_free(void)
 
 	pthread_mutex_lock(&root_mutex);
 	enabled = false;
+	pthread_mutex_unlock(&root_mutex);
+
+	/* threads can still be in the middle of recording an event */
+	wait_for_buffer_writers();
+
+	stop_merge_thread();
+	free_buffers();
+	timeline_free();
+
+	pthread_mutex_lock(&root_mutex);
+	buffered = false;
 	da_move(old_root_entries, root_entries);
 	pthread_mutex_unlock(&root_mutex);
 
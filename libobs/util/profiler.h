@@ -28,6 +28,19 @@ EXPORT void profile_reenable_thread(void);
 EXPORT void profiler_start(void);
 EXPORT void profiler_stop(void);
 
+/* Starts the profiler in buffered mode: profile_start/profile_end only record
+ * events into fixed-size per-thread ring buffers, and a background thread
+ * merges them.  Events that do not fit into a full buffer are dropped. */
+EXPORT void profiler_start_buffered(void);
+EXPORT uint64_t profiler_buffered_dropped_events(void);
+
+/* Timeline capture keeps the most recent begin/end events with their
+ * timestamps and threads so they can be exported in the Chrome trace event
+ * format.  Requires the profiler to be running in buffered mode. */
+EXPORT bool profiler_timeline_start(void);
+EXPORT void profiler_timeline_stop(void);
+EXPORT bool profiler_timeline_dump_json(const char *filename);
+
 EXPORT void profiler_print(profiler_snapshot_t *snap);
 EXPORT void profiler_print_time_between_calls(profiler_snapshot_t *snap);
 
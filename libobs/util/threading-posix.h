@@ -26,6 +26,11 @@ static inline long os_atomic_dec_long(volatile long *val)
 	return __sync_sub_and_fetch(val, 1);
 }
 
+static inline long os_atomic_add_long(volatile long *val, long add)
+{
+	return __sync_add_and_fetch(val, add);
+}
+
 static inline long os_atomic_set_long(volatile long *ptr, long val)
 {
 	return __sync_lock_test_and_set(ptr, val);
@@ -28,6 +28,11 @@ static inline long os_atomic_dec_long(volatile long *val)
 	return _InterlockedDecrement(val);
 }
 
+static inline long os_atomic_add_long(volatile long *val, long add)
+{
+	return _InterlockedExchangeAdd(val, add) + add;
+}
+
 static inline long os_atomic_set_long(volatile long *ptr, long val)
 {
 	return (long)_InterlockedExchange((volatile long*)ptr, (long)val);
@@ -17,13 +17,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
 #include <xcb/xinerama.h>
+#ifdef HAVE_XCB_DAMAGE
+#include <xcb/damage.h>
+#endif
 
 #include <obs-module.h>
 #include <util/dstr.h>
+#include <util/threading.h>
 #include "xcursor-xcb.h"
 #include "xhelpers.h"
 
@@ -31,12 +36,46 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* damaged areas beyond this are merged into their bounding box */
+#define XSHM_MAX_RECTS 16
+
+/**
+ * Area of the screen that was fetched into a shm segment
+ *
+ * The coordinates are relative to the captured area, the image data is
+ * stored tightly packed at the given offset.
+ */
+struct xshm_rect {
+	int_fast32_t x;
+	int_fast32_t y;
+	int_fast32_t w;
+	int_fast32_t h;
+	size_t       offset;
+};
+
+struct xshm_buffer {
+	xcb_shm_t        *shm;
+	struct xshm_rect rects[XSHM_MAX_RECTS];
+	size_t           num_rects;
+};
+
+/**
+ * Damage tracking state, only used by the capture thread
+ */
+struct xshm_damage {
+	bool                active;
+#ifdef HAVE_XCB_DAMAGE
+	uint8_t             notify_event;
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t region;
+#endif
+};
+
 struct xshm_data {
 	obs_source_t     *source;
 
 	xcb_connection_t *xcb;
 	xcb_screen_t     *xcb_screen;
-	xcb_shm_t        *xshm;
 	xcb_xcursor_t    *cursor;
 
 	char             *server;
@@ -48,6 +87,17 @@ struct xshm_data {
 
 	gs_texture_t     *texture;
 
+	/* the capture thread fills one buffer while the other one may be
+	 * uploaded by the graphics thread */
+	pthread_mutex_t  mutex;
+	pthread_t        thread;
+	os_event_t       *stop_event;
+	bool             thread_active;
+	struct xshm_buffer buffers[2];
+	int              ready;
+	int              reading;
+	xcb_xfixes_get_cursor_image_reply_t *cursor_image;
+
 	bool             show_cursor;
 	bool             use_xinerama;
 	bool             advanced;
@@ -138,11 +188,353 @@ static const char* xshm_getname(void *unused)
 	return obs_module_text("X11SharedMemoryScreenInput");
 }
 
+/**
+ * Set up damage tracking for the root window
+ *
+ * Without the damage extension every frame is captured in full.
+ */
+static void xshm_damage_init(struct xshm_data *data, struct xshm_damage *d)
+{
+#ifdef HAVE_XCB_DAMAGE
+	const xcb_query_extension_reply_t *ext;
+	xcb_damage_query_version_cookie_t ver_c;
+
+	memset(d, 0, sizeof(struct xshm_damage));
+
+	ext = xcb_get_extension_data(data->xcb, &xcb_damage_id);
+	if (!ext || !ext->present) {
+		blog(LOG_INFO, "Missing DAMAGE extension, capturing full frames");
+		return;
+	}
+
+	ver_c = xcb_damage_query_version_unchecked(data->xcb,
+			XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION);
+	free(xcb_damage_query_version_reply(data->xcb, ver_c, NULL));
+
+	d->notify_event = ext->first_event + XCB_DAMAGE_NOTIFY;
+	d->damage       = xcb_generate_id(data->xcb);
+	d->region       = xcb_generate_id(data->xcb);
+
+	xcb_damage_create(data->xcb, d->damage, data->xcb_screen->root,
+			XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+	xcb_xfixes_create_region(data->xcb, d->region, 0, NULL);
+	xcb_flush(data->xcb);
+
+	d->active = true;
+#else
+	memset(d, 0, sizeof(struct xshm_damage));
+
+	blog(LOG_INFO, "Built without DAMAGE support, capturing full frames");
+	UNUSED_PARAMETER(data);
+#endif
+}
+
+static void xshm_damage_free(struct xshm_data *data, struct xshm_damage *d)
+{
+#ifdef HAVE_XCB_DAMAGE
+	if (!d->active)
+		return;
+
+	xcb_damage_destroy(data->xcb, d->damage);
+	xcb_xfixes_destroy_region(data->xcb, d->region);
+	xcb_flush(data->xcb);
+#else
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(d);
+#endif
+}
+
+/**
+ * Drain pending events
+ *
+ * @return true if the screen was damaged since the damage was last
+ *         subtracted
+ */
+static bool xshm_damage_poll(struct xshm_data *data, struct xshm_damage *d)
+{
+	xcb_generic_event_t *ev;
+	bool damaged = false;
+
+	while ((ev = xcb_poll_for_event(data->xcb)) != NULL) {
+#ifdef HAVE_XCB_DAMAGE
+		if ((ev->response_type & ~0x80) == d->notify_event)
+			damaged = true;
+#else
+		UNUSED_PARAMETER(d);
+#endif
+		free(ev);
+	}
+
+	return damaged;
+}
+
+/**
+ * Add a rectangle in root window coordinates, clipped to the captured area
+ */
+static void xshm_buffer_add_rect(struct xshm_data *data,
+		struct xshm_buffer *buf, int_fast32_t x, int_fast32_t y,
+		int_fast32_t w, int_fast32_t h)
+{
+	struct xshm_rect *rect;
+	int_fast32_t x2 = x + w - data->x_org;
+	int_fast32_t y2 = y + h - data->y_org;
+
+	x -= data->x_org;
+	y -= data->y_org;
+
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+	if (x2 > data->width)  x2 = data->width;
+	if (y2 > data->height) y2 = data->height;
+
+	if (x >= x2 || y >= y2)
+		return;
+
+	if (buf->num_rects == XSHM_MAX_RECTS) {
+		for (size_t i = 0; i < buf->num_rects; i++) {
+			struct xshm_rect *r = &buf->rects[i];
+			if (r->x < x) x = r->x;
+			if (r->y < y) y = r->y;
+			if (r->x + r->w > x2) x2 = r->x + r->w;
+			if (r->y + r->h > y2) y2 = r->y + r->h;
+		}
+
+		rect = &buf->rects[0];
+		buf->num_rects = 1;
+	} else {
+		rect = &buf->rects[buf->num_rects++];
+	}
+
+	rect->x = x;
+	rect->y = y;
+	rect->w = x2 - x;
+	rect->h = y2 - y;
+}
+
+/**
+ * Compute the packed offsets of the rectangles
+ *
+ * The rectangles of a region never overlap, so they always fit into the
+ * segment unless they were merged, in which case the full frame is used.
+ */
+static void xshm_buffer_layout(struct xshm_data *data,
+		struct xshm_buffer *buf)
+{
+	size_t max_size = (size_t)data->width * data->height * 4;
+	size_t offset = 0;
+
+	for (size_t i = 0; i < buf->num_rects; i++) {
+		struct xshm_rect *rect = &buf->rects[i];
+		size_t size = (size_t)rect->w * rect->h * 4;
+
+		if (offset + size > max_size) {
+			buf->num_rects = 0;
+			xshm_buffer_add_rect(data, buf, data->x_org, data->y_org,
+					data->width, data->height);
+			buf->rects[0].offset = 0;
+			return;
+		}
+
+		rect->offset = offset;
+		offset += size;
+	}
+}
+
+/**
+ * Collect the damaged areas since the last capture
+ *
+ * @param full capture the whole area regardless of damage
+ */
+static void xshm_buffer_set_rects(struct xshm_data *data,
+		struct xshm_damage *d, struct xshm_buffer *buf, bool full)
+{
+	xcb_xfixes_fetch_region_reply_t *reg_r = NULL;
+
+	buf->num_rects = 0;
+
+#ifdef HAVE_XCB_DAMAGE
+	if (d->active) {
+		xcb_damage_subtract(data->xcb, d->damage, XCB_NONE, d->region);
+
+		if (!full) {
+			xcb_xfixes_fetch_region_cookie_t reg_c =
+				xcb_xfixes_fetch_region_unchecked(data->xcb,
+						d->region);
+			reg_r = xcb_xfixes_fetch_region_reply(data->xcb, reg_c,
+					NULL);
+		}
+	}
+#else
+	UNUSED_PARAMETER(d);
+	UNUSED_PARAMETER(full);
+#endif
+
+	if (reg_r) {
+		xcb_rectangle_t *rects =
+			xcb_xfixes_fetch_region_rectangles(reg_r);
+		int count = xcb_xfixes_fetch_region_rectangles_length(reg_r);
+
+		for (int i = 0; i < count; i++)
+			xshm_buffer_add_rect(data, buf,
+					rects[i].x, rects[i].y,
+					rects[i].width, rects[i].height);
+		free(reg_r);
+	} else {
+		xshm_buffer_add_rect(data, buf, data->x_org, data->y_org,
+				data->width, data->height);
+	}
+
+	xshm_buffer_layout(data, buf);
+}
+
+/**
+ * Fetch the image data of all rectangles of the buffer
+ */
+static bool xshm_buffer_get_images(struct xshm_data *data,
+		struct xshm_buffer *buf)
+{
+	xcb_shm_get_image_cookie_t img_c[XSHM_MAX_RECTS];
+	bool success = true;
+
+	for (size_t i = 0; i < buf->num_rects; i++) {
+		struct xshm_rect *rect = &buf->rects[i];
+
+		img_c[i] = xcb_shm_get_image_unchecked(data->xcb,
+				data->xcb_screen->root,
+				data->x_org + rect->x, data->y_org + rect->y,
+				rect->w, rect->h, ~0,
+				XCB_IMAGE_FORMAT_Z_PIXMAP, buf->shm->seg,
+				(uint32_t)rect->offset);
+	}
+
+	for (size_t i = 0; i < buf->num_rects; i++) {
+		xcb_shm_get_image_reply_t *img_r;
+
+		img_r = xcb_shm_get_image_reply(data->xcb, img_c[i], NULL);
+		if (!img_r)
+			success = false;
+		free(img_r);
+	}
+
+	return success;
+}
+
+/**
+ * Get a buffer the capture thread can write to
+ *
+ * @return -1 if the last capture has not been uploaded yet
+ */
+static int xshm_acquire_buffer(struct xshm_data *data)
+{
+	int idx = -1;
+
+	pthread_mutex_lock(&data->mutex);
+	if (data->ready == -1)
+		idx = (data->reading == 0) ? 1 : 0;
+	pthread_mutex_unlock(&data->mutex);
+
+	return idx;
+}
+
+static void xshm_fetch_cursor(struct xshm_data *data)
+{
+	xcb_xfixes_get_cursor_image_cookie_t cur_c;
+	xcb_xfixes_get_cursor_image_reply_t  *cur_r;
+
+	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
+	if (!cur_r)
+		return;
+
+	pthread_mutex_lock(&data->mutex);
+	free(data->cursor_image);
+	data->cursor_image = cur_r;
+	pthread_mutex_unlock(&data->mutex);
+}
+
+/**
+ * Capture thread
+ *
+ * Fetches the damaged parts of the screen once per frame so the graphics
+ * thread never has to wait for the x server.  Damage accumulates on the
+ * server while the source is not showing or the previous capture has not
+ * been uploaded yet.
+ */
+static void *xshm_thread(void *vptr)
+{
+	XSHM_DATA(vptr);
+	struct xshm_damage damage;
+	uint64_t frame_time = video_output_get_frame_time(obs_get_video());
+	unsigned long interval = (unsigned long)(frame_time / 1000000);
+	bool full = true;
+	bool damaged = false;
+
+	os_set_thread_name("xshm-input: capture thread");
+
+	if (!interval)
+		interval = 1;
+
+	xshm_damage_init(data, &damage);
+
+	while (os_event_timedwait(data->stop_event, interval) == ETIMEDOUT) {
+		struct xshm_buffer *buf;
+		int idx;
+
+		if (damage.active)
+			damaged |= xshm_damage_poll(data, &damage);
+		else
+			damaged = true;
+
+		if (!obs_source_showing(data->source))
+			continue;
+
+		if (data->show_cursor)
+			xshm_fetch_cursor(data);
+
+		if (!full && !damaged)
+			continue;
+
+		idx = xshm_acquire_buffer(data);
+		if (idx == -1)
+			continue;
+
+		buf = &data->buffers[idx];
+		xshm_buffer_set_rects(data, &damage, buf, full);
+		damaged = false;
+
+		if (!buf->num_rects)
+			continue;
+
+		if (!xshm_buffer_get_images(data, buf)) {
+			full = true;
+			continue;
+		}
+
+		full = false;
+
+		pthread_mutex_lock(&data->mutex);
+		data->ready = idx;
+		pthread_mutex_unlock(&data->mutex);
+	}
+
+	xshm_damage_free(data, &damage);
+	return NULL;
+}
+
 /**
  * Stop the capture
  */
 static void xshm_capture_stop(struct xshm_data *data)
 {
+	if (data->thread_active) {
+		os_event_signal(data->stop_event);
+		pthread_join(data->thread, NULL);
+		data->thread_active = false;
+	}
+
+	os_event_destroy(data->stop_event);
+	data->stop_event = NULL;
+
 	obs_enter_graphics();
 
 	if (data->texture) {
@@ -156,11 +548,16 @@ static void xshm_capture_stop(struct xshm_data *data)
 
 	obs_leave_graphics();
 
-	if (data->xshm) {
-		xshm_xcb_detach(data->xshm);
-		data->xshm = NULL;
+	for (size_t i = 0; i < 2; i++) {
+		if (data->buffers[i].shm) {
+			xshm_xcb_detach(data->buffers[i].shm);
+			data->buffers[i].shm = NULL;
+		}
 	}
 
+	free(data->cursor_image);
+	data->cursor_image = NULL;
+
 	if (data->xcb) {
 		xcb_disconnect(data->xcb);
 		data->xcb = NULL;
@@ -196,10 +593,13 @@ static void xshm_capture_start(struct xshm_data *data)
 		goto fail;
 	}
 
-	data->xshm = xshm_xcb_attach(data->xcb, data->width, data->height);
-	if (!data->xshm) {
-		blog(LOG_ERROR, "failed to attach shm !");
-		goto fail;
+	for (size_t i = 0; i < 2; i++) {
+		data->buffers[i].shm = xshm_xcb_attach(data->xcb,
+				data->width, data->height);
+		if (!data->buffers[i].shm) {
+			blog(LOG_ERROR, "failed to attach shm !");
+			goto fail;
+		}
 	}
 
 	data->cursor = xcb_xcursor_init(data->xcb);
@@ -211,6 +611,17 @@ static void xshm_capture_start(struct xshm_data *data)
 
 	obs_leave_graphics();
 
+	data->ready   = -1;
+	data->reading = -1;
+
+	if (os_event_init(&data->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&data->thread, NULL, xshm_thread, data) != 0) {
+		blog(LOG_ERROR, "failed to create capture thread !");
+		goto fail;
+	}
+	data->thread_active = true;
+
 	return;
 fail:
 	xshm_capture_stop(data);
@@ -367,6 +778,7 @@ static void xshm_destroy(void *vptr)
 
 	xshm_capture_stop(data);
 
+	pthread_mutex_destroy(&data->mutex);
 	bfree(data);
 }
 
@@ -378,11 +790,64 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 	struct xshm_data *data = bzalloc(sizeof(struct xshm_data));
 	data->source = source;
 
+	if (pthread_mutex_init(&data->mutex, NULL) != 0) {
+		bfree(data);
+		return NULL;
+	}
+
 	xshm_update(data, settings);
 
 	return data;
 }
 
+/**
+ * Upload the rectangles of a buffer to the texture
+ *
+ * Only the damaged rectangles are written, the rest of the texture keeps
+ * the previous frame.  If the graphics subsystem can't update parts of a
+ * texture, the rows are copied into the mapped texture instead, which then
+ * uploads it as a whole.
+ *
+ * @note requires to be called within the obs graphics context
+ */
+static void xshm_upload_buffer(struct xshm_data *data,
+		struct xshm_buffer *buf)
+{
+	uint8_t *ptr;
+	uint32_t linesize;
+	size_t i;
+
+	for (i = 0; i < buf->num_rects; i++) {
+		struct xshm_rect *rect = &buf->rects[i];
+
+		if (!gs_texture_set_image_rect(data->texture,
+				rect->x, rect->y, rect->w, rect->h,
+				buf->shm->data + rect->offset, rect->w * 4))
+			break;
+	}
+
+	if (i == buf->num_rects)
+		return;
+
+	if (!gs_texture_map(data->texture, &ptr, &linesize))
+		return;
+
+	for (i = 0; i < buf->num_rects; i++) {
+		struct xshm_rect *rect = &buf->rects[i];
+		const uint8_t *src = buf->shm->data + rect->offset;
+		uint8_t *dst = ptr + rect->y * linesize + rect->x * 4;
+		size_t row_size = rect->w * 4;
+
+		for (int_fast32_t y = 0; y < rect->h; y++) {
+			memcpy(dst, src, row_size);
+			dst += linesize;
+			src += row_size;
+		}
+	}
+
+	gs_texture_unmap(data->texture);
+}
+
 /**
  * Prepare the capture data
  */
@@ -391,38 +856,41 @@ static void xshm_video_tick(void *vptr, float seconds)
 	UNUSED_PARAMETER(seconds);
 	XSHM_DATA(vptr);
 
+	xcb_xfixes_get_cursor_image_reply_t *cur_r;
+	int idx;
+
 	if (!data->texture)
 		return;
 	if (!obs_source_showing(data->source))
 		return;
 
-	xcb_shm_get_image_cookie_t           img_c;
-	xcb_shm_get_image_reply_t            *img_r;
-	xcb_xfixes_get_cursor_image_cookie_t cur_c;
-	xcb_xfixes_get_cursor_image_reply_t  *cur_r;
-
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-			data->x_org, data->y_org, data->width, data->height,
-			~0, XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg, 0);
-	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
-
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
-	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
+	pthread_mutex_lock(&data->mutex);
+	idx = data->ready;
+	data->ready = -1;
+	data->reading = idx;
+	cur_r = data->cursor_image;
+	data->cursor_image = NULL;
+	pthread_mutex_unlock(&data->mutex);
 
-	if (!img_r)
-		goto exit;
+	if (idx == -1 && !cur_r)
+		return;
 
 	obs_enter_graphics();
 
-	gs_texture_set_image(data->texture, (void *) data->xshm->data,
-		data->width * 4, false);
-	xcb_xcursor_update(data->cursor, cur_r);
+	if (idx != -1)
+		xshm_upload_buffer(data, &data->buffers[idx]);
+	if (cur_r)
+		xcb_xcursor_update(data->cursor, cur_r);
 
 	obs_leave_graphics();
 
-exit:
-	free(img_r);
 	free(cur_r);
+
+	if (idx != -1) {
+		pthread_mutex_lock(&data->mutex);
+		data->reading = -1;
+		pthread_mutex_unlock(&data->mutex);
+	}
 }
 
 /**
@@ -49,6 +49,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define V4L2_DATA(voidptr) struct v4l2_data *data = voidptr;
 
+/* how long stopping the capture waits for libobs to release buffers */
+#define V4L2_RELEASE_TIMEOUT_MS 2000
+
 #define timeval2ns(tv) \
 	(((uint64_t) tv.tv_sec * 1000000000) + ((uint64_t) tv.tv_usec * 1000))
 
@@ -88,6 +91,34 @@ struct v4l2_data {
 	struct v4l2_buffer_data buffers;
 };
 
+struct v4l2_buffer_refs;
+
+/**
+ * Reference to a mapped buffer that was handed to libobs without copying
+ */
+struct v4l2_buffer_ref {
+	struct v4l2_buffer_refs *refs;
+	uint32_t index;
+};
+
+/**
+ * Buffers of one capture run that are held by libobs
+ *
+ * If libobs does not give all buffers back in time when the capture stops,
+ * the capture thread orphans them: it hands the mapping over to this
+ * structure, the device is closed without them, and the last release unmaps
+ * the buffers and frees the structure.
+ */
+struct v4l2_buffer_refs {
+	pthread_mutex_t mutex;
+	int_fast32_t dev;
+	volatile long outstanding;
+	bool orphaned;
+	os_event_t *released;
+	struct v4l2_buffer_data buffers;
+	struct v4l2_buffer_ref *ref;
+};
+
 /* forward declarations */
 static void v4l2_init(struct v4l2_data *data);
 static void v4l2_terminate(struct v4l2_data *data);
@@ -142,6 +173,122 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 	}
 }
 
+static struct v4l2_buffer_refs *v4l2_buffer_refs_create(int_fast32_t dev,
+		uint_fast32_t count)
+{
+	struct v4l2_buffer_refs *refs = bzalloc(sizeof(*refs));
+
+	if (pthread_mutex_init(&refs->mutex, NULL) != 0) {
+		bfree(refs);
+		return NULL;
+	}
+	if (os_event_init(&refs->released, OS_EVENT_TYPE_AUTO) != 0) {
+		pthread_mutex_destroy(&refs->mutex);
+		bfree(refs);
+		return NULL;
+	}
+
+	refs->dev = dev;
+	refs->ref = bzalloc(sizeof(struct v4l2_buffer_ref) * count);
+	for (uint_fast32_t i = 0; i < count; ++i) {
+		refs->ref[i].refs  = refs;
+		refs->ref[i].index = (uint32_t)i;
+	}
+
+	return refs;
+}
+
+static void v4l2_buffer_refs_destroy(struct v4l2_buffer_refs *refs)
+{
+	if (!refs)
+		return;
+
+	v4l2_destroy_mmap(&refs->buffers);
+	os_event_destroy(refs->released);
+	pthread_mutex_destroy(&refs->mutex);
+	bfree(refs->ref);
+	bfree(refs);
+}
+
+/**
+ * Give a buffer that libobs is done with back to the driver
+ *
+ * This is called by libobs, possibly from the graphics thread.
+ */
+static void v4l2_release_buffer(void *param)
+{
+	struct v4l2_buffer_ref *ref = param;
+	struct v4l2_buffer_refs *refs = ref->refs;
+	struct v4l2_buffer buf;
+	bool orphaned;
+	long outstanding;
+
+	pthread_mutex_lock(&refs->mutex);
+
+	orphaned = refs->orphaned;
+	if (!orphaned) {
+		memset(&buf, 0, sizeof(buf));
+		buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		buf.index  = ref->index;
+
+		if (v4l2_ioctl(refs->dev, VIDIOC_QBUF, &buf) < 0)
+			blog(LOG_DEBUG, "failed to enqueue buffer");
+	}
+
+	outstanding = os_atomic_dec_long(&refs->outstanding);
+
+	pthread_mutex_unlock(&refs->mutex);
+
+	if (outstanding == 0) {
+		if (orphaned)
+			v4l2_buffer_refs_destroy(refs);
+		else
+			os_event_signal(refs->released);
+	}
+}
+
+/**
+ * Wait for libobs to give back all buffers before the capture is stopped
+ *
+ * @return true if all buffers came back, false if they were orphaned and
+ *         refs must not be used anymore
+ */
+static bool v4l2_wait_for_buffers(struct v4l2_data *data,
+		struct v4l2_buffer_refs *refs)
+{
+	uint64_t deadline = os_gettime_ns() +
+		V4L2_RELEASE_TIMEOUT_MS * 1000000ULL;
+	long outstanding;
+
+	obs_source_flush_async_video(data->source);
+
+	while (os_atomic_load_long(&refs->outstanding) > 0) {
+		if (os_gettime_ns() >= deadline)
+			break;
+		os_event_timedwait(refs->released, 100);
+	}
+
+	pthread_mutex_lock(&refs->mutex);
+	outstanding = os_atomic_load_long(&refs->outstanding);
+	if (outstanding > 0) {
+		/* the device stops getting buffers back from here on */
+		refs->orphaned = true;
+		refs->buffers = data->buffers;
+		memset(&data->buffers, 0, sizeof(data->buffers));
+	}
+	pthread_mutex_unlock(&refs->mutex);
+
+	if (outstanding > 0) {
+		blog(LOG_WARNING, "%ld buffers were not released within "
+				"%d ms, orphaning them", outstanding,
+				V4L2_RELEASE_TIMEOUT_MS);
+		return false;
+	}
+
+	return true;
+}
+
 /*
  * Worker thread to get video data
  */
@@ -156,8 +303,13 @@ static void *v4l2_thread(void *vptr)
 	struct timeval tv;
 	struct v4l2_buffer buf;
 	struct obs_source_frame out;
+	struct v4l2_buffer_refs *refs;
 	size_t plane_offsets[MAX_AV_PLANES];
 
+	refs = v4l2_buffer_refs_create(data->dev, data->buffers.count);
+	if (!refs)
+		goto exit;
+
 	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
 		goto exit;
 
@@ -200,11 +352,22 @@ static void *v4l2_thread(void *vptr)
 		start = (uint8_t *) data->buffers.info[buf.index].start;
 		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
 			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
 
-		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
-			blog(LOG_DEBUG, "failed to enqueue buffer");
-			break;
+		/* hand the buffer to libobs directly as long as the driver
+		 * keeps enough buffers to capture into, otherwise copy it */
+		if (os_atomic_load_long(&refs->outstanding) + 2 <
+				(long)data->buffers.count) {
+			os_atomic_inc_long(&refs->outstanding);
+			obs_source_output_video2(data->source, &out,
+					v4l2_release_buffer,
+					&refs->ref[buf.index]);
+		} else {
+			obs_source_output_video(data->source, &out);
+
+			if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
+				blog(LOG_DEBUG, "failed to enqueue buffer");
+				break;
+			}
 		}
 
 		frames++;
@@ -212,8 +375,12 @@ static void *v4l2_thread(void *vptr)
 
 	blog(LOG_INFO, "Stopped capture after %"PRIu64" frames", frames);
 
-exit:
+	if (!v4l2_wait_for_buffers(data, refs))
+		refs = NULL;
 	v4l2_stop_capture(data->dev);
+
+exit:
+	v4l2_buffer_refs_destroy(refs);
 	return NULL;
 }
 
@@ -93,6 +93,7 @@ struct ffmpeg_output {
 	uint64_t           total_bytes;
 
 	uint64_t           audio_start_ts;
+	uint64_t           next_audio_ts;
 	uint64_t           video_start_ts;
 	uint64_t           stop_ts;
 	volatile bool      stopping;
@@ -848,6 +849,32 @@ static bool prepare_audio(struct ffmpeg_data *data,
 	return true;
 }
 
+/* audio output skips ahead when libobs removes audio buffering, so fill the
+ * skipped time with silence to keep audio in sync with video, the same way
+ * encoders do */
+static void fill_audio_gap(struct ffmpeg_output *output,
+		const struct audio_data *in)
+{
+	struct ffmpeg_data *data = &output->ff_data;
+	uint64_t gap_frames;
+
+	if (output->next_audio_ts && in->timestamp > output->next_audio_ts) {
+		gap_frames = (in->timestamp - output->next_audio_ts) *
+			(uint64_t)data->audio_samplerate / 1000000000ULL;
+
+		if (gap_frames * 2 >= in->frames)
+			for (size_t i = 0; i < data->audio_planes; i++)
+				circlebuf_push_back_zero(
+						&data->excess_frames[i],
+						(size_t)gap_frames *
+						data->audio_size);
+	}
+
+	output->next_audio_ts = in->timestamp +
+		(uint64_t)in->frames * 1000000000ULL /
+		(uint64_t)data->audio_samplerate;
+}
+
 static void receive_audio(void *param, struct audio_data *frame)
 {
 	struct ffmpeg_output *output = param;
@@ -871,6 +898,8 @@ static void receive_audio(void *param, struct audio_data *frame)
 
 	frame_size_bytes = (size_t)data->frame_size * data->audio_size;
 
+	fill_audio_gap(output, &in);
+
 	for (size_t i = 0; i < data->audio_planes; i++)
 		circlebuf_push_back(&data->excess_frames[i], in.data[i],
 				in.frames * data->audio_size);
@@ -1093,6 +1122,7 @@ static bool ffmpeg_output_start(void *data)
 
 	os_atomic_set_bool(&output->stopping, false);
 	output->audio_start_ts = 0;
+	output->next_audio_ts = 0;
 	output->video_start_ts = 0;
 	output->total_bytes = 0;
 
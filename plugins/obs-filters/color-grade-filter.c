@@ -11,6 +11,8 @@
 struct lut_filter_data {
 	obs_source_t                   *context;
 	gs_effect_t                    *effect;
+	gs_eparam_t                    *clut_param;
+	gs_eparam_t                    *clut_amount_param;
 	gs_texture_t                   *target;
 	gs_image_file_t                image;
 
@@ -55,6 +57,13 @@ static void color_grade_filter_update(void *data, obs_data_t *settings)
 	filter->effect = gs_effect_create_from_file(effect_path, NULL);
 	bfree(effect_path);
 
+	if (filter->effect) {
+		filter->clut_param = gs_effect_get_param_by_name(
+				filter->effect, "clut");
+		filter->clut_amount_param = gs_effect_get_param_by_name(
+				filter->effect, "clut_amount");
+	}
+
 	obs_leave_graphics();
 }
 
@@ -128,7 +137,6 @@ static void color_grade_filter_render(void *data, gs_effect_t *effect)
 {
 	struct lut_filter_data *filter = data;
 	obs_source_t *target = obs_filter_get_target(filter->context);
-	gs_eparam_t *param;
 
 	if (!target || !filter->target || !filter->effect) {
 		obs_source_skip_video_filter(filter->context);
@@ -139,11 +147,8 @@ static void color_grade_filter_render(void *data, gs_effect_t *effect)
 				OBS_ALLOW_DIRECT_RENDERING))
 		return;
 
-	param = gs_effect_get_param_by_name(filter->effect, "clut");
-	gs_effect_set_texture(param, filter->target);
-
-	param = gs_effect_get_param_by_name(filter->effect, "clut_amount");
-	gs_effect_set_float(param, filter->clut_amount);
+	gs_effect_set_texture(filter->clut_param, filter->target);
+	gs_effect_set_float(filter->clut_amount_param, filter->clut_amount);
 
 	obs_source_process_filter_end(filter->context, filter->effect, 0, 0);
 
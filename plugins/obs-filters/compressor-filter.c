@@ -31,6 +31,11 @@
 #define S_RELEASE_TIME                  "release_time"
 #define S_OUTPUT_GAIN                   "output_gain"
 #define S_SIDECHAIN_SOURCE              "sidechain_source"
+#define S_MODE                          "mode"
+#define S_LOOKAHEAD_TIME                "lookahead_time"
+
+#define MODE_COMPRESSOR                 "compressor"
+#define MODE_LIMITER                    "limiter"
 
 #define MT_ obs_module_text
 #define TEXT_RATIO                      MT_("Compressor.Ratio")
@@ -39,6 +44,10 @@
 #define TEXT_RELEASE_TIME               MT_("Compressor.ReleaseTime")
 #define TEXT_OUTPUT_GAIN                MT_("Compressor.OutputGain")
 #define TEXT_SIDECHAIN_SOURCE           MT_("Compressor.SidechainSource")
+#define TEXT_MODE                       MT_("Compressor.Mode")
+#define TEXT_MODE_COMPRESSOR            MT_("Compressor.Mode.Compressor")
+#define TEXT_MODE_LIMITER               MT_("Compressor.Mode.Limiter")
+#define TEXT_LOOKAHEAD_TIME             MT_("Compressor.LookaheadTime")
 
 #define MIN_RATIO                       1.0f
 #define MAX_RATIO                       32.0f
@@ -49,6 +58,7 @@
 #define MIN_ATK_RLS_MS                  1
 #define MAX_RLS_MS                      1000
 #define MAX_ATK_MS                      500
+#define MAX_LOOKAHEAD_MS                20
 #define DEFAULT_AUDIO_BUF_MS            10
 
 #define MS_IN_S                         1000
@@ -65,12 +75,13 @@ struct compressor_data {
 	float threshold;
 	float attack_gain;
 	float release_gain;
-	float output_gain;
+	float output_gain_db;
 
 	size_t num_channels;
 	size_t sample_rate;
 	float envelope;
 	float slope;
+	bool limiter;
 
 	pthread_mutex_t sidechain_update_mutex;
 	uint64_t sidechain_check_time;
@@ -81,6 +92,26 @@ struct compressor_data {
 	struct circlebuf sidechain_data[MAX_AUDIO_CHANNELS];
 	float *sidechain_buf[MAX_AUDIO_CHANNELS];
 	size_t max_sidechain_frames;
+
+	/* the signal is delayed by lookahead_frames so that gain reduction
+	 * starts before the peak that caused it.  the delay lines are sized
+	 * for MAX_LOOKAHEAD_MS on creation, so changing the setting never
+	 * reallocates on the audio thread */
+	float *lookahead_buf[MAX_AUDIO_CHANNELS];
+	size_t lookahead_max;
+	size_t lookahead_frames;
+	size_t lookahead_len;
+	size_t lookahead_pos;
+	volatile long lookahead_latency;
+
+	/* peaks of the last lookahead_len + 1 frames that are not smaller
+	 * than a later one, oldest first.  the first one is the largest peak
+	 * of the window */
+	float *peak_val;
+	uint64_t *peak_time;
+	size_t peak_head;
+	size_t peak_count;
+	uint64_t frame_time;
 };
 
 /* -------------------------------------------------------- */
@@ -198,6 +229,10 @@ static void compressor_update(void *data, obs_data_t *s)
 		(float)obs_data_get_double(s, S_OUTPUT_GAIN);
 	const char *sidechain_name =
 		obs_data_get_string(s, S_SIDECHAIN_SOURCE);
+	const char *mode = obs_data_get_string(s, S_MODE);
+	const size_t lookahead_ms =
+		(size_t)obs_data_get_int(s, S_LOOKAHEAD_TIME);
+	const bool limiter = strcmp(mode, MODE_LIMITER) == 0;
 
 	cd->ratio = (float)obs_data_get_double(s, S_RATIO);
 	cd->threshold = (float)obs_data_get_double(s, S_THRESHOLD);
@@ -205,10 +240,14 @@ static void compressor_update(void *data, obs_data_t *s)
 			attack_time_ms / MS_IN_S_F);
 	cd->release_gain = gain_coefficient(sample_rate,
 			release_time_ms / MS_IN_S_F);
-	cd->output_gain = db_to_mul(output_gain_db);
+	cd->output_gain_db = output_gain_db;
 	cd->num_channels = num_channels;
 	cd->sample_rate = sample_rate;
-	cd->slope = 1.0f - (1.0f / cd->ratio);
+	cd->slope = limiter ? 1.0f : 1.0f - (1.0f / cd->ratio);
+	cd->limiter = limiter;
+	cd->lookahead_frames = sample_rate *
+		(lookahead_ms < MAX_LOOKAHEAD_MS ?
+		 lookahead_ms : MAX_LOOKAHEAD_MS) / MS_IN_S;
 
 	bool valid_sidechain =
 		*sidechain_name && strcmp(sidechain_name, "none") != 0;
@@ -278,6 +317,14 @@ static void *compressor_create(obs_data_t *settings, obs_source_t *filter)
 	}
 
 	compressor_update(cd, settings);
+
+	cd->lookahead_max = cd->sample_rate * MAX_LOOKAHEAD_MS / MS_IN_S;
+	for (size_t i = 0; i < cd->num_channels; i++)
+		cd->lookahead_buf[i] = bzalloc(
+				cd->lookahead_max * sizeof(float));
+	cd->peak_val = bmalloc((cd->lookahead_max + 1) * sizeof(float));
+	cd->peak_time = bmalloc((cd->lookahead_max + 1) * sizeof(uint64_t));
+
 	return cd;
 }
 
@@ -299,22 +346,23 @@ static void compressor_destroy(void *data)
 	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
 		circlebuf_free(&cd->sidechain_data[i]);
 		bfree(cd->sidechain_buf[i]);
+		bfree(cd->lookahead_buf[i]);
 	}
 	pthread_mutex_destroy(&cd->sidechain_mutex);
 	pthread_mutex_destroy(&cd->sidechain_update_mutex);
 
 	bfree(cd->sidechain_name);
 	bfree(cd->envelope_buf);
+	bfree(cd->peak_val);
+	bfree(cd->peak_time);
 	bfree(cd);
 }
 
-static void analyze_envelope(struct compressor_data *cd,
+/* the follower itself is a recurrence and can't be vectorized, but it is
+ * kept free of branches so it compiles to a select */
+static void follow_envelope(struct compressor_data *cd,
 	float **samples, const uint32_t num_samples)
 {
-	if (cd->envelope_buf_len < num_samples) {
-		resize_env_buffer(cd, num_samples);
-	}
-
 	const float attack_gain = cd->attack_gain;
 	const float release_gain = cd->release_gain;
 
@@ -327,17 +375,89 @@ static void analyze_envelope(struct compressor_data *cd,
 		float env = cd->envelope;
 		for (uint32_t i = 0; i < num_samples; ++i) {
 			const float env_in = fabsf(samples[chan][i]);
-			if (env < env_in) {
-				env = env_in + attack_gain * (env - env_in);
-			} else {
-				env = env_in + release_gain * (env - env_in);
-			}
+			const float coef = env < env_in ?
+				attack_gain : release_gain;
+
+			env = env_in + coef * (env - env_in);
 			envelope_buf[i] = fmaxf(envelope_buf[i], env);
 		}
 	}
 	cd->envelope = cd->envelope_buf[num_samples - 1];
 }
 
+/* the gain applied to a delayed sample has to account for every sample that
+ * arrived after it, otherwise the peak that the lookahead was meant to catch
+ * gets through before the envelope rises.  so the envelope follows the
+ * largest peak of the window that the delay line holds, and for the limiter
+ * it never drops below that peak, which keeps the output under the threshold
+ * regardless of the attack time */
+static void follow_window_peak(struct compressor_data *cd,
+	float **samples, const uint32_t num_samples)
+{
+	const size_t cap = cd->lookahead_max + 1;
+	const uint64_t len = cd->lookahead_len;
+	const float attack_gain = cd->attack_gain;
+	const float release_gain = cd->release_gain;
+	float *envelope_buf = cd->envelope_buf;
+	float env = cd->envelope;
+
+	memset(envelope_buf, 0, num_samples * sizeof(envelope_buf[0]));
+	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
+		if (samples[chan])
+			audio_block_abs_max(envelope_buf, samples[chan],
+					num_samples);
+	}
+
+	for (uint32_t i = 0; i < num_samples; ++i) {
+		const float peak = envelope_buf[i];
+		const uint64_t t = cd->frame_time++;
+		size_t back;
+
+		if (cd->peak_count && cd->peak_time[cd->peak_head] + len < t) {
+			cd->peak_head = (cd->peak_head + 1) % cap;
+			cd->peak_count--;
+		}
+
+		while (cd->peak_count) {
+			back = (cd->peak_head + cd->peak_count - 1) % cap;
+			if (cd->peak_val[back] > peak)
+				break;
+			cd->peak_count--;
+		}
+
+		back = (cd->peak_head + cd->peak_count) % cap;
+		cd->peak_val[back] = peak;
+		cd->peak_time[back] = t;
+		cd->peak_count++;
+
+		const float env_in = cd->peak_val[cd->peak_head];
+		const float coef = env < env_in ? attack_gain : release_gain;
+
+		env = env_in + coef * (env - env_in);
+		envelope_buf[i] = cd->limiter ? fmaxf(env, env_in) : env;
+	}
+
+	cd->envelope = env;
+}
+
+static inline bool use_window_peak(const struct compressor_data *cd)
+{
+	return cd->limiter || cd->lookahead_len;
+}
+
+static void analyze_envelope(struct compressor_data *cd,
+	float **samples, const uint32_t num_samples)
+{
+	if (cd->envelope_buf_len < num_samples) {
+		resize_env_buffer(cd, num_samples);
+	}
+
+	if (use_window_peak(cd))
+		follow_window_peak(cd, samples, num_samples);
+	else
+		follow_envelope(cd, samples, num_samples);
+}
+
 static void analyze_sidechain(struct compressor_data *cd,
 	const uint32_t num_samples)
 {
@@ -347,44 +467,107 @@ static void analyze_sidechain(struct compressor_data *cd,
 
 	get_sidechain_data(cd, num_samples);
 
-	const float attack_gain = cd->attack_gain;
-	const float release_gain = cd->release_gain;
-	float **sidechain_buf = cd->sidechain_buf;
+	if (use_window_peak(cd))
+		follow_window_peak(cd, cd->sidechain_buf, num_samples);
+	else
+		follow_envelope(cd, cd->sidechain_buf, num_samples);
+}
 
-	memset(cd->envelope_buf, 0, num_samples * sizeof(cd->envelope_buf[0]));
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (!sidechain_buf[chan])
+static void update_lookahead(struct compressor_data *cd)
+{
+	size_t len = cd->lookahead_frames;
+
+	if (len > cd->lookahead_max)
+		len = cd->lookahead_max;
+	if (cd->lookahead_len == len)
+		return;
+
+	for (size_t c = 0; c < cd->num_channels; ++c) {
+		if (cd->lookahead_buf[c])
+			memset(cd->lookahead_buf[c], 0,
+				cd->lookahead_max * sizeof(float));
+	}
+
+	cd->lookahead_len = len;
+	cd->lookahead_pos = 0;
+	cd->peak_count = 0;
+	os_atomic_set_long(&cd->lookahead_latency, (long)len);
+}
+
+static void delay_samples(struct compressor_data *cd,
+	float **samples, const uint32_t num_samples)
+{
+	size_t len = cd->lookahead_len;
+
+	if (!len)
+		return;
+
+	for (size_t c = 0; c < cd->num_channels; ++c) {
+		float *buf = cd->lookahead_buf[c];
+		size_t pos = cd->lookahead_pos;
+
+		if (!samples[c] || !buf)
 			continue;
 
-		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
 		for (uint32_t i = 0; i < num_samples; ++i) {
-			const float env_in  = fabsf(sidechain_buf[chan][i]);
+			const float in = samples[c][i];
 
-			if (env < env_in) {
-				env = env_in + attack_gain * (env - env_in);
-			} else {
-				env = env_in + release_gain * (env - env_in);
-			}
-			envelope_buf[i] = fmaxf(envelope_buf[i], env);
+			samples[c][i] = buf[pos];
+			buf[pos] = in;
+			if (++pos == len)
+				pos = 0;
 		}
 	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
+
+	cd->lookahead_pos = (cd->lookahead_pos + num_samples) % len;
+}
+
+/* the limiter gain is computed in the linear domain, so that the peak times
+ * the gain can't round above the threshold the way the dB approximations
+ * could */
+static inline void process_limiting(const struct compressor_data *cd,
+	float **samples, uint32_t num_samples)
+{
+	const float threshold = db_to_mul(cd->threshold);
+	const float output_gain = db_to_mul(cd->output_gain_db);
+	float *gain_buf = cd->envelope_buf;
+
+	for (size_t i = 0; i < num_samples; ++i) {
+		const float env = gain_buf[i];
+		const float gain = env > threshold ? threshold / env : 1.0f;
+		gain_buf[i] = gain * output_gain;
+	}
+
+	for (size_t c = 0; c < cd->num_channels; ++c) {
+		if (samples[c])
+			audio_block_mul(samples[c], gain_buf, num_samples);
+	}
 }
 
+/* the envelope buffer is converted to gain in place, four samples at a time
+ * with the approximations from audio-math.h */
 static inline void process_compression(const struct compressor_data *cd,
 	float **samples, uint32_t num_samples)
 {
+	float *gain_buf = cd->envelope_buf;
+
+	if (cd->limiter) {
+		process_limiting(cd, samples, num_samples);
+		return;
+	}
+
+	audio_block_mul_to_db(gain_buf, gain_buf, num_samples);
+
 	for (size_t i = 0; i < num_samples; ++i) {
-		const float env_db = mul_to_db(cd->envelope_buf[i]);
-		float gain = cd->slope * (cd->threshold - env_db);
-		gain = db_to_mul(fminf(0, gain));
+		const float gain = cd->slope * (cd->threshold - gain_buf[i]);
+		gain_buf[i] = fminf(0, gain) + cd->output_gain_db;
+	}
 
-		for (size_t c = 0; c < cd->num_channels; ++c) {
-			if (samples[c]) {
-				samples[c][i] *= gain * cd->output_gain;
-			}
-		}
+	audio_block_db_to_mul(gain_buf, gain_buf, num_samples);
+
+	for (size_t c = 0; c < cd->num_channels; ++c) {
+		if (samples[c])
+			audio_block_mul(samples[c], gain_buf, num_samples);
 	}
 }
 
@@ -448,15 +631,30 @@ static struct obs_audio_data *compressor_filter_audio(void *data,
 	obs_weak_source_t *weak_sidechain = cd->weak_sidechain;
 	pthread_mutex_unlock(&cd->sidechain_update_mutex);
 
+	update_lookahead(cd);
+
 	if (weak_sidechain)
 		analyze_sidechain(cd, num_samples);
 	else
 		analyze_envelope(cd, samples, num_samples);
 
+	delay_samples(cd, samples, num_samples);
 	process_compression(cd, samples, num_samples);
 	return audio;
 }
 
+/* every sample leaves the delay line lookahead_len frames after it went in,
+ * so the audio that comes out is that much older than its timestamp */
+static uint64_t compressor_audio_latency(void *data)
+{
+	struct compressor_data *cd = data;
+	uint32_t sample_rate = audio_output_get_sample_rate(obs_get_audio());
+	long frames = os_atomic_load_long(&cd->lookahead_latency);
+
+	return sample_rate ?
+		(uint64_t)frames * 1000000000ULL / sample_rate : 0;
+}
+
 static void compressor_defaults(obs_data_t *s)
 {
 	obs_data_set_default_double(s, S_RATIO, 10.0f);
@@ -465,6 +663,20 @@ static void compressor_defaults(obs_data_t *s)
 	obs_data_set_default_int(s, S_RELEASE_TIME, 60);
 	obs_data_set_default_double(s, S_OUTPUT_GAIN, 0.0f);
 	obs_data_set_default_string(s, S_SIDECHAIN_SOURCE, "none");
+	obs_data_set_default_string(s, S_MODE, MODE_COMPRESSOR);
+	obs_data_set_default_int(s, S_LOOKAHEAD_TIME, 0);
+}
+
+static bool mode_modified(obs_properties_t *props, obs_property_t *p,
+		obs_data_t *settings)
+{
+	const char *mode = obs_data_get_string(settings, S_MODE);
+	bool limiter = strcmp(mode, MODE_LIMITER) == 0;
+
+	obs_property_set_visible(obs_properties_get(props, S_RATIO), !limiter);
+
+	UNUSED_PARAMETER(p);
+	return true;
 }
 
 struct sidechain_prop_info {
@@ -496,6 +708,14 @@ static obs_properties_t *compressor_properties(void *data)
 	if (cd)
 		parent = obs_filter_get_parent(cd->context);
 
+	obs_property_t *mode = obs_properties_add_list(props, S_MODE,
+			TEXT_MODE, OBS_COMBO_TYPE_LIST,
+			OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(mode, TEXT_MODE_COMPRESSOR,
+			MODE_COMPRESSOR);
+	obs_property_list_add_string(mode, TEXT_MODE_LIMITER, MODE_LIMITER);
+	obs_property_set_modified_callback(mode, mode_modified);
+
 	obs_properties_add_float_slider(props, S_RATIO,
 		TEXT_RATIO, MIN_RATIO, MAX_RATIO, 0.5f);
 	obs_properties_add_float_slider(props, S_THRESHOLD,
@@ -504,6 +724,8 @@ static obs_properties_t *compressor_properties(void *data)
 		TEXT_ATTACK_TIME, MIN_ATK_RLS_MS, MAX_ATK_MS, 1);
 	obs_properties_add_int_slider(props, S_RELEASE_TIME,
 		TEXT_RELEASE_TIME, MIN_ATK_RLS_MS, MAX_RLS_MS, 1);
+	obs_properties_add_int_slider(props, S_LOOKAHEAD_TIME,
+		TEXT_LOOKAHEAD_TIME, 0, MAX_LOOKAHEAD_MS, 1);
 	obs_properties_add_float_slider(props, S_OUTPUT_GAIN,
 		TEXT_OUTPUT_GAIN, MIN_OUTPUT_GAIN_DB, MAX_OUTPUT_GAIN_DB, 0.1f);
 
@@ -523,7 +745,7 @@ static obs_properties_t *compressor_properties(void *data)
 struct obs_source_info compressor_filter = {
 	.id = "compressor_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_AUDIO,
+	.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_ALWAYS_TICK,
 	.get_name = compressor_name,
 	.create = compressor_create,
 	.destroy = compressor_destroy,
@@ -532,4 +754,5 @@ struct obs_source_info compressor_filter = {
 	.video_tick = compressor_tick,
 	.get_defaults = compressor_defaults,
 	.get_properties = compressor_properties,
+	.get_audio_latency = compressor_audio_latency,
 };
@@ -23,6 +23,10 @@ struct mask_filter_data {
 
 	obs_source_t                   *context;
 	gs_effect_t                    *effect;
+	gs_eparam_t                    *target_param;
+	gs_eparam_t                    *color_param;
+	gs_eparam_t                    *mul_val_param;
+	gs_eparam_t                    *add_val_param;
 
 	gs_texture_t                   *target;
 	gs_image_file_t                image;
@@ -68,6 +72,17 @@ static void mask_filter_update(void *data, obs_data_t *settings)
 	filter->effect = gs_effect_create_from_file(effect_path, NULL);
 	bfree(effect_path);
 
+	if (filter->effect) {
+		filter->target_param = gs_effect_get_param_by_name(
+				filter->effect, "target");
+		filter->color_param = gs_effect_get_param_by_name(
+				filter->effect, "color");
+		filter->mul_val_param = gs_effect_get_param_by_name(
+				filter->effect, "mul_val");
+		filter->add_val_param = gs_effect_get_param_by_name(
+				filter->effect, "add_val");
+	}
+
 	obs_leave_graphics();
 }
 
@@ -170,7 +185,6 @@ static void mask_filter_render(void *data, gs_effect_t *effect)
 {
 	struct mask_filter_data *filter = data;
 	obs_source_t *target = obs_filter_get_target(filter->context);
-	gs_eparam_t *param;
 	struct vec2 add_val = {0};
 	struct vec2 mul_val = {1.0f, 1.0f};
 
@@ -214,17 +228,10 @@ static void mask_filter_render(void *data, gs_effect_t *effect)
 				OBS_ALLOW_DIRECT_RENDERING))
 		return;
 
-	param = gs_effect_get_param_by_name(filter->effect, "target");
-	gs_effect_set_texture(param, filter->target);
-
-	param = gs_effect_get_param_by_name(filter->effect, "color");
-	gs_effect_set_vec4(param, &filter->color);
-
-	param = gs_effect_get_param_by_name(filter->effect, "mul_val");
-	gs_effect_set_vec2(param, &mul_val);
-
-	param = gs_effect_get_param_by_name(filter->effect, "add_val");
-	gs_effect_set_vec2(param, &add_val);
+	gs_effect_set_texture(filter->target_param, filter->target);
+	gs_effect_set_vec4(filter->color_param, &filter->color);
+	gs_effect_set_vec2(filter->mul_val_param, &mul_val);
+	gs_effect_set_vec2(filter->add_val_param, &add_val);
 
 	obs_source_process_filter_end(filter->context, filter->effect, 0, 0);
 
@@ -22,6 +22,10 @@
 #define TEXT_HOLD_TIME                 MT_("NoiseGate.HoldTime")
 #define TEXT_RELEASE_TIME              MT_("NoiseGate.ReleaseTime")
 
+/* audio is processed in sub-blocks of this many frames: peak levels and
+ * gains for a sub-block are computed first, then applied to each channel */
+#define GATE_BLOCK_FRAMES              256
+
 struct noise_gate_data {
 	obs_source_t *context;
 
@@ -39,6 +43,9 @@ struct noise_gate_data {
 	float attenuation;
 	float level;
 	float held_time;
+
+	float peak_buf[GATE_BLOCK_FRAMES];
+	float gain_buf[GATE_BLOCK_FRAMES];
 };
 
 #define VOL_MIN -96.0f
@@ -104,12 +111,30 @@ static void *noise_gate_create(obs_data_t *settings, obs_source_t *filter)
 	return ng;
 }
 
-static struct obs_audio_data *noise_gate_filter_audio(void *data,
-		struct obs_audio_data *audio)
+enum gate_block_gain {
+	GATE_GAIN_MIXED,
+	GATE_GAIN_OPEN,
+	GATE_GAIN_CLOSED,
+};
+
+static inline float max_f(float a, float b)
 {
-	struct noise_gate_data *ng = data;
+	return a > b ? a : b;
+}
 
-	float **adata = (float**)audio->data;
+static inline float min_f(float a, float b)
+{
+	return a < b ? a : b;
+}
+
+/* runs the gate state for each frame of a sub-block using the peak levels in
+ * peak_buf, writing the resulting attenuation to gain_buf.  the state still
+ * advances per frame so that timing is identical to processing one frame at
+ * a time, but it no longer touches the channels.  fmaxf/fminf are avoided
+ * here as they are library calls unless NaN handling is relaxed */
+static enum gate_block_gain update_gate(struct noise_gate_data *ng,
+		size_t frames)
+{
 	const float close_threshold = ng->close_threshold;
 	const float open_threshold = ng->open_threshold;
 	const float sample_rate_i = ng->sample_rate_i;
@@ -117,13 +142,11 @@ static struct obs_audio_data *noise_gate_filter_audio(void *data,
 	const float attack_rate = ng->attack_rate;
 	const float decay_rate = ng->decay_rate;
 	const float hold_time = ng->hold_time;
-	const size_t channels = ng->channels;
+	bool all_open = true;
+	bool all_closed = true;
 
-	for (size_t i = 0; i < audio->frames; i++) {
-		float cur_level = fabsf(adata[0][i]);
-		for (size_t j = 0; j < channels; j++) {
-			cur_level = fmaxf(cur_level, fabsf(adata[j][i]));
-		}
+	for (size_t i = 0; i < frames; i++) {
+		const float cur_level = ng->peak_buf[i];
 
 		if (cur_level > open_threshold && !ng->is_open) {
 			ng->is_open = true;
@@ -133,21 +156,62 @@ static struct obs_audio_data *noise_gate_filter_audio(void *data,
 			ng->is_open = false;
 		}
 
-		ng->level = fmaxf(ng->level, cur_level) - decay_rate;
+		ng->level = max_f(ng->level, cur_level) - decay_rate;
 
 		if (ng->is_open) {
-			ng->attenuation = fminf(1.0f,
-					ng->attenuation + attack_rate);
+			ng->attenuation = min_f(ng->attenuation + attack_rate,
+					1.0f);
 		} else {
 			ng->held_time += sample_rate_i;
 			if (ng->held_time > hold_time) {
-				ng->attenuation = fmaxf(0.0f,
-						ng->attenuation - release_rate);
+				ng->attenuation = max_f(
+						ng->attenuation - release_rate,
+						0.0f);
 			}
 		}
 
+		ng->gain_buf[i] = ng->attenuation;
+		all_open   = all_open   && ng->attenuation == 1.0f;
+		all_closed = all_closed && ng->attenuation == 0.0f;
+	}
+
+	if (all_open)
+		return GATE_GAIN_OPEN;
+	if (all_closed)
+		return GATE_GAIN_CLOSED;
+	return GATE_GAIN_MIXED;
+}
+
+static struct obs_audio_data *noise_gate_filter_audio(void *data,
+		struct obs_audio_data *audio)
+{
+	struct noise_gate_data *ng = data;
+
+	float **adata = (float**)audio->data;
+	const size_t channels = ng->channels;
+
+	for (size_t pos = 0; pos < audio->frames; pos += GATE_BLOCK_FRAMES) {
+		size_t frames = audio->frames - pos;
+		enum gate_block_gain gain;
+
+		if (frames > GATE_BLOCK_FRAMES)
+			frames = GATE_BLOCK_FRAMES;
+
+		memset(ng->peak_buf, 0, frames * sizeof(float));
 		for (size_t c = 0; c < channels; c++)
-			adata[c][i] *= ng->attenuation;
+			audio_block_abs_max(ng->peak_buf, adata[c] + pos,
+					frames);
+
+		gain = update_gate(ng, frames);
+
+		for (size_t c = 0; c < channels; c++) {
+			float *samples = adata[c] + pos;
+
+			if (gain == GATE_GAIN_CLOSED)
+				memset(samples, 0, frames * sizeof(float));
+			else if (gain == GATE_GAIN_MIXED)
+				audio_block_mul(samples, ng->gain_buf, frames);
+		}
 	}
 
 	return audio;
@@ -1,7 +1,9 @@
 #include <stdint.h>
 #include <inttypes.h>
+#include <emmintrin.h>
 
 #include <util/circlebuf.h>
+#include <util/threading.h>
 #include <obs-module.h>
 #include <speex/speex_preprocess.h>
 
@@ -41,6 +43,7 @@ struct noise_suppress_data {
 	size_t channels;
 
 	struct circlebuf info_buffer;
+	volatile long info_frames;
 	struct circlebuf input_buffers[MAX_PREPROC_CHANNELS];
 	struct circlebuf output_buffers[MAX_PREPROC_CHANNELS];
 
@@ -54,6 +57,16 @@ struct noise_suppress_data {
 	/* output data */
 	struct obs_audio_data output_audio;
 	DARRAY(float) output_data;
+
+	/* with more than two channels, channels from worker_channel on are
+	 * processed by a worker thread while the audio thread processes the
+	 * rest */
+	pthread_t worker;
+	bool worker_active;
+	volatile bool worker_exit;
+	os_sem_t *worker_start;
+	os_sem_t *worker_done;
+	size_t worker_channel;
 };
 
 /* -------------------------------------------------------- */
@@ -61,6 +74,11 @@ struct noise_suppress_data {
 #define SUP_MIN -60
 #define SUP_MAX 0
 
+struct ng_audio_info {
+	uint32_t frames;
+	uint64_t timestamp;
+};
+
 static const float c_32_to_16 = (float)INT16_MAX;
 static const float c_16_to_32 = ((float)INT16_MAX + 1.0f);
 
@@ -76,6 +94,14 @@ static void noise_suppress_destroy(void *data)
 {
 	struct noise_suppress_data *ng = data;
 
+	if (ng->worker_active) {
+		ng->worker_exit = true;
+		os_sem_post(ng->worker_start);
+		pthread_join(ng->worker, NULL);
+	}
+	os_sem_destroy(ng->worker_start);
+	os_sem_destroy(ng->worker_done);
+
 	for (size_t i = 0; i < ng->channels; i++) {
 		speex_preprocess_state_destroy(ng->states[i]);
 		circlebuf_free(&ng->input_buffers[i]);
@@ -89,14 +115,54 @@ static void noise_suppress_destroy(void *data)
 	bfree(ng);
 }
 
+/* the ring buffers are sized for a full segment plus a maximum size output
+ * packet up front, so they don't grow while audio is being processed */
 static inline void alloc_channel(struct noise_suppress_data *ng,
 		uint32_t sample_rate, size_t channel, size_t frames)
 {
+	size_t buffer_size = (frames + AUDIO_OUTPUT_FRAMES) * sizeof(float);
+
 	ng->states[channel] = speex_preprocess_state_init((int)frames,
 			sample_rate);
 
-	circlebuf_reserve(&ng->input_buffers[channel],  frames * sizeof(float));
-	circlebuf_reserve(&ng->output_buffers[channel], frames * sizeof(float));
+	circlebuf_reserve(&ng->input_buffers[channel],  buffer_size);
+	circlebuf_reserve(&ng->output_buffers[channel], buffer_size);
+}
+
+static void process_channels(struct noise_suppress_data *ng,
+		size_t first, size_t last);
+
+static void *noise_suppress_worker(void *data)
+{
+	struct noise_suppress_data *ng = data;
+
+	os_set_thread_name("noise suppress worker");
+
+	for (;;) {
+		os_sem_wait(ng->worker_start);
+		if (ng->worker_exit)
+			break;
+
+		process_channels(ng, ng->worker_channel, ng->channels);
+		os_sem_post(ng->worker_done);
+	}
+
+	return NULL;
+}
+
+static void start_worker(struct noise_suppress_data *ng)
+{
+	if (os_sem_init(&ng->worker_start, 0) != 0)
+		return;
+	if (os_sem_init(&ng->worker_done, 0) != 0)
+		return;
+
+	ng->worker_channel = ng->channels / 2;
+	ng->worker_active = pthread_create(&ng->worker, NULL,
+			noise_suppress_worker, ng) == 0;
+	if (!ng->worker_active)
+		warn("Failed to create worker thread, processing all "
+		     "channels on the audio thread");
 }
 
 static void noise_suppress_update(void *data, obs_data_t *s)
@@ -128,6 +194,15 @@ static void noise_suppress_update(void *data, obs_data_t *s)
 
 	for (size_t i = 0; i < channels; i++)
 		alloc_channel(ng, sample_rate, i, frames);
+
+	/* every queued packet holds back at least one frame, and no more than
+	 * frames + AUDIO_OUTPUT_FRAMES are ever held back, see alloc_channel */
+	circlebuf_reserve(&ng->info_buffer, (frames + AUDIO_OUTPUT_FRAMES) *
+			sizeof(struct ng_audio_info));
+	da_reserve(ng->output_data, AUDIO_OUTPUT_FRAMES * channels);
+
+	if (channels > 2)
+		start_worker(ng);
 }
 
 static void *noise_suppress_create(obs_data_t *settings, obs_source_t *filter)
@@ -140,38 +215,85 @@ static void *noise_suppress_create(obs_data_t *settings, obs_source_t *filter)
 	return ng;
 }
 
-static inline void process(struct noise_suppress_data *ng)
+static inline void convert_to_int16(spx_int16_t *dst, const float *src,
+		size_t frames)
 {
-	/* Pop from input circlebuf */
-	for (size_t i = 0; i < ng->channels; i++)
-		circlebuf_pop_front(&ng->input_buffers[i], ng->copy_buffers[i],
-				ng->frames * sizeof(float));
+	const __m128 min   = _mm_set1_ps(-1.0f);
+	const __m128 max   = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(c_32_to_16);
+	size_t i = 0;
 
-	/* Set args */
-	for (size_t i = 0; i < ng->channels; i++)
+	for (; i + 8 <= frames; i += 8) {
+		__m128 lo = _mm_loadu_ps(src + i);
+		__m128 hi = _mm_loadu_ps(src + i + 4);
+
+		lo = _mm_mul_ps(_mm_min_ps(_mm_max_ps(lo, min), max), scale);
+		hi = _mm_mul_ps(_mm_min_ps(_mm_max_ps(hi, min), max), scale);
+
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(
+				_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi)));
+	}
+
+	for (; i < frames; i++) {
+		float s = src[i];
+		if (s > 1.0f) s = 1.0f;
+		else if (s < -1.0f) s = -1.0f;
+		dst[i] = (spx_int16_t)(s * c_32_to_16);
+	}
+}
+
+static inline void convert_to_float(float *dst, const spx_int16_t *src,
+		size_t frames)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / c_16_to_32);
+	size_t i = 0;
+
+	for (; i + 8 <= frames; i += 8) {
+		__m128i v  = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+		_mm_storeu_ps(dst + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo),
+					scale));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi),
+					scale));
+	}
+
+	for (; i < frames; i++)
+		dst[i] = (float)src[i] / c_16_to_32;
+}
+
+static void process_channels(struct noise_suppress_data *ng,
+		size_t first, size_t last)
+{
+	for (size_t i = first; i < last; i++) {
 		speex_preprocess_ctl(ng->states[i],
 				SPEEX_PREPROCESS_SET_NOISE_SUPPRESS,
 				&ng->suppress_level);
 
-	/* Convert to 16bit */
-	for (size_t i = 0; i < ng->channels; i++)
-		for (size_t j = 0; j < ng->frames; j++) {
-			float s = ng->copy_buffers[i][j];
-			if (s > 1.0f) s = 1.0f;
-			else if (s < -1.0f) s = -1.0f;
-			ng->segment_buffers[i][j] = (spx_int16_t)
-				(s * c_32_to_16);
-		}
-
-	/* Execute */
-	for (size_t i = 0; i < ng->channels; i++)
+		convert_to_int16(ng->segment_buffers[i], ng->copy_buffers[i],
+				ng->frames);
 		speex_preprocess_run(ng->states[i], ng->segment_buffers[i]);
+		convert_to_float(ng->copy_buffers[i], ng->segment_buffers[i],
+				ng->frames);
+	}
+}
 
-	/* Convert back to 32bit */
+static inline void process(struct noise_suppress_data *ng)
+{
+	/* Pop from input circlebuf */
 	for (size_t i = 0; i < ng->channels; i++)
-		for (size_t j = 0; j < ng->frames; j++)
-			ng->copy_buffers[i][j] =
-				(float)ng->segment_buffers[i][j] / c_16_to_32;
+		circlebuf_pop_front(&ng->input_buffers[i], ng->copy_buffers[i],
+				ng->frames * sizeof(float));
+
+	/* Execute */
+	if (ng->worker_active) {
+		os_sem_post(ng->worker_start);
+		process_channels(ng, 0, ng->worker_channel);
+		os_sem_wait(ng->worker_done);
+	} else {
+		process_channels(ng, 0, ng->channels);
+	}
 
 	/* Push to output circlebuf */
 	for (size_t i = 0; i < ng->channels; i++)
@@ -179,11 +301,6 @@ static inline void process(struct noise_suppress_data *ng)
 				ng->frames * sizeof(float));
 }
 
-struct ng_audio_info {
-	uint32_t frames;
-	uint64_t timestamp;
-};
-
 static inline void clear_circlebuf(struct circlebuf *buf)
 {
 	circlebuf_pop_front(buf, NULL, buf->size);
@@ -197,6 +314,7 @@ static void reset_data(struct noise_suppress_data *ng)
 	}
 
 	clear_circlebuf(&ng->info_buffer);
+	os_atomic_set_long(&ng->info_frames, 0);
 }
 
 static struct obs_audio_data *noise_suppress_filter_audio(void *data,
@@ -229,6 +347,7 @@ static struct obs_audio_data *noise_suppress_filter_audio(void *data,
 	info.frames = audio->frames;
 	info.timestamp = audio->timestamp;
 	circlebuf_push_back(&ng->info_buffer, &info, sizeof(info));
+	os_atomic_add_long(&ng->info_frames, (long)info.frames);
 
 	/* -----------------------------------------------
 	 * push back current audio data to input circlebuf */
@@ -255,11 +374,12 @@ static struct obs_audio_data *noise_suppress_filter_audio(void *data,
 	 * if there's enough audio data buffered in the output circlebuf,
 	 * pop and return a packet */
 	circlebuf_pop_front(&ng->info_buffer, NULL, sizeof(info));
-	da_resize(ng->output_data, out_size * ng->channels);
+	os_atomic_add_long(&ng->info_frames, -(long)info.frames);
+	da_resize(ng->output_data, info.frames * ng->channels);
 
 	for (size_t i = 0; i < ng->channels; i++) {
 		ng->output_audio.data[i] =
-			(uint8_t*)&ng->output_data.array[i * out_size];
+			(uint8_t*)&ng->output_data.array[i * info.frames];
 
 		circlebuf_pop_front(&ng->output_buffers[i],
 				ng->output_audio.data[i],
@@ -271,6 +391,20 @@ static struct obs_audio_data *noise_suppress_filter_audio(void *data,
 	return &ng->output_audio;
 }
 
+/* the packet returned next is the oldest one in the info buffer, so it is
+ * held back by every packet that is still queued there.  depending on how
+ * packets line up with the 10 millisecond segments this varies from packet
+ * to packet */
+static uint64_t noise_suppress_audio_latency(void *data)
+{
+	struct noise_suppress_data *ng = data;
+	uint32_t sample_rate = audio_output_get_sample_rate(obs_get_audio());
+	long frames = os_atomic_load_long(&ng->info_frames);
+
+	return sample_rate ?
+		(uint64_t)frames * 1000000000ULL / sample_rate : 0;
+}
+
 static void noise_suppress_defaults(obs_data_t *s)
 {
 	obs_data_set_default_int(s, S_SUPPRESS_LEVEL, -30);
@@ -298,4 +432,5 @@ struct obs_source_info noise_suppress_filter = {
 	.filter_audio = noise_suppress_filter_audio,
 	.get_defaults = noise_suppress_defaults,
 	.get_properties = noise_suppress_properties,
+	.get_audio_latency = noise_suppress_audio_latency,
 };
@@ -441,6 +441,8 @@ static void set_output_error(struct rtmp_stream *stream)
 	obs_output_set_last_error(stream->output, msg);
 }
 
+static const char *send_packet_name = "rtmp_stream_send_packet";
+
 static void *send_thread(void *data)
 {
 	struct rtmp_stream *stream = data;
@@ -471,7 +473,12 @@ static void *send_thread(void *data)
 			}
 		}
 
-		if (send_packet(stream, &packet, false, packet.track_idx) < 0) {
+		profile_start(send_packet_name);
+		int ret = send_packet(stream, &packet, false, packet.track_idx);
+		profile_end(send_packet_name);
+		profile_reenable_thread();
+
+		if (ret < 0) {
 			os_atomic_set_bool(&stream->disconnected, true);
 			break;
 		}
@@ -38,7 +38,9 @@ static struct obs_source_info freetype2_source_info = {
 #ifdef _WIN32
 	                OBS_SOURCE_DEPRECATED |
 #endif
-	                OBS_SOURCE_CUSTOM_DRAW,
+	                OBS_SOURCE_CUSTOM_DRAW |
+	                OBS_SOURCE_PARALLEL_TICK |
+	                OBS_SOURCE_STATIC_RENDER,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create,
 	.destroy = ft2_source_destroy,
@@ -246,6 +248,7 @@ static void ft2_video_tick(void *data, float seconds)
 					srcdata->text_file);
 			cache_glyphs(srcdata, srcdata->text);
 			set_up_vertex_buffer(srcdata);
+			obs_source_mark_dirty(srcdata->src);
 			srcdata->update_file = false;
 		}
 
@@ -0,0 +1,885 @@
+/*
+ * Offline audio filter benchmark.
+ *
+ * Creates a single audio filter by id and runs it as fast as possible over a
+ * synthetic signal or a WAV file, packet by packet, the same way the audio
+ * thread would.  Reports the time spent in the filter per sample, the number
+ * of allocations made while filtering, the output peak, and a checksum of the
+ * filtered output.  The checksum only matches output of the same build, which
+ * makes it useful for comparing changes locally.  To catch regressions across
+ * platforms the output can be written to or checked against a golden file,
+ * which holds the peak and RMS level of every 100 ms of output.  Levels are
+ * compared with a tolerance, so that rounding differences between compilers
+ * and instruction sets don't count as a change, and a mismatch can be
+ * located.
+ *
+ * usage: audio-filter-bench [options] <filter id>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <util/bmem.h>
+#include <util/crc32.h>
+#include <util/platform.h>
+#include <media-io/audio-math.h>
+#include <obs.h>
+
+#define DEFAULT_SAMPLE_RATE 48000
+#define DEFAULT_CHANNELS    2
+#define DEFAULT_SECONDS     10
+#define DEFAULT_ITERATIONS  1
+
+#define GOLDEN_SEGMENT_FRAMES 4800
+#define GOLDEN_FLOOR_DB       -120.0
+#define DEFAULT_TOLERANCE_DB  0.05
+
+enum bench_signal {
+	SIGNAL_SWEEP,
+	SIGNAL_STEP,
+	SIGNAL_IMPULSE,
+	SIGNAL_BURSTS
+};
+
+struct bench_options {
+	const char *filter_id;
+	const char *wav_file;
+	const char *settings_json;
+	const char *module_bin_path;
+	const char *module_data_path;
+	const char *golden_file;
+	const char *golden_out_file;
+	uint32_t   sample_rate;
+	uint32_t   channels;
+	uint32_t   seconds;
+	uint32_t   iterations;
+	uint32_t   packet_frames;
+	uint32_t   expected_crc;
+	bool       check_crc;
+	float      max_peak_db;
+	bool       check_peak;
+	double     tolerance_db;
+	enum bench_signal signal;
+	bool       verbose;
+};
+
+struct bench_input {
+	float      *planes[MAX_AV_PLANES];
+	size_t     frames;
+	uint32_t   sample_rate;
+	uint32_t   channels;
+};
+
+struct bench_results {
+	uint64_t   filter_ns;
+	uint64_t   frames_in;
+	uint64_t   frames_out;
+	uint64_t   packets_held;
+	uint64_t   allocs;
+	uint64_t   alloc_bytes;
+	float      peak;
+	uint32_t   crc;
+
+	/* output of the first iteration, kept for golden file checks */
+	float      *output[MAX_AV_PLANES];
+	size_t     output_frames;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static bool verbose = false;
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (verbose || log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fputc('\n', stderr);
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+/* ------------------------------------------------------------------------- */
+/* input generation                                                          */
+
+static void free_input(struct bench_input *input)
+{
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		bfree(input->planes[i]);
+	memset(input, 0, sizeof(*input));
+}
+
+static void alloc_input(struct bench_input *input, uint32_t sample_rate,
+		uint32_t channels, size_t frames)
+{
+	input->sample_rate = sample_rate;
+	input->channels = channels;
+	input->frames = frames;
+
+	for (uint32_t i = 0; i < channels; i++)
+		input->planes[i] = bzalloc(frames * sizeof(float));
+}
+
+/* a deterministic test signal: a slow sine sweep with an amplitude envelope
+ * that goes from near silence to full scale, plus low level noise, so that
+ * dynamics filters go through all of their states */
+static void generate_sweep(struct bench_input *input, uint32_t sample_rate,
+		uint32_t channels, uint32_t seconds)
+{
+	size_t frames = (size_t)sample_rate * seconds;
+	uint32_t seed = 0x12345678;
+	double phase = 0.0;
+
+	alloc_input(input, sample_rate, channels, frames);
+
+	for (size_t i = 0; i < frames; i++) {
+		double t = (double)i / (double)sample_rate;
+		double freq = 50.0 + 4000.0 * fmod(t, 2.0) / 2.0;
+		double env = 0.5 - 0.5 * cos(2.0 * M_PI * t / 3.0);
+		float noise;
+
+		phase += 2.0 * M_PI * freq / (double)sample_rate;
+		if (phase > 2.0 * M_PI)
+			phase -= 2.0 * M_PI;
+
+		for (uint32_t c = 0; c < channels; c++) {
+			seed = seed * 1664525 + 1013904223;
+			noise = (float)(int32_t)seed / 2147483648.0f * 0.01f;
+
+			input->planes[c][i] = (float)(sin(phase + c) * env) +
+				noise;
+		}
+	}
+}
+
+/* silence followed by full scale, the worst case for a limiter's attack */
+static void generate_step(struct bench_input *input, uint32_t sample_rate,
+		uint32_t channels, uint32_t seconds)
+{
+	size_t frames = (size_t)sample_rate * seconds;
+
+	alloc_input(input, sample_rate, channels, frames);
+
+	for (size_t i = frames / 4; i < frames; i++) {
+		for (uint32_t c = 0; c < channels; c++)
+			input->planes[c][i] = (c & 1) ? -1.0f : 1.0f;
+	}
+}
+
+/* one full scale sample every 100 ms, alternating in sign, and otherwise
+ * silence */
+static void generate_impulses(struct bench_input *input, uint32_t sample_rate,
+		uint32_t channels, uint32_t seconds)
+{
+	size_t frames = (size_t)sample_rate * seconds;
+	size_t interval = sample_rate / 10;
+	float val = 1.0f;
+
+	alloc_input(input, sample_rate, channels, frames);
+
+	for (size_t i = interval / 2; i < frames; i += interval) {
+		for (uint32_t c = 0; c < channels; c++)
+			input->planes[c][i] = val;
+		val = -val;
+	}
+}
+
+/* tones at levels from silence to full scale, changing every 200 ms, so
+ * that gates and compressors open and close.  only integer math and exact
+ * conversions are used, which makes the signal the same on every platform
+ * and keeps golden files portable */
+static void generate_bursts(struct bench_input *input, uint32_t sample_rate,
+		uint32_t channels, uint32_t seconds)
+{
+	static const float levels[] = {
+		0.0f, 0.25f, 0.03125f, 0.0078125f, 1.0f, 0.0390625f,
+		0.00390625f, 0.5f
+	};
+	size_t frames = (size_t)sample_rate * seconds;
+	size_t burst_frames = sample_rate / 5;
+	uint32_t seed = 0x12345678;
+
+	alloc_input(input, sample_rate, channels, frames);
+
+	for (size_t i = 0; i < frames; i++) {
+		size_t level = (i / burst_frames) % (sizeof(levels) /
+				sizeof(levels[0]));
+		int32_t phase = (int32_t)(i % 96);
+		int32_t triangle = phase < 48 ? phase - 24 : 72 - phase;
+
+		for (uint32_t c = 0; c < channels; c++) {
+			seed = seed * 1664525 + 1013904223;
+
+			input->planes[c][i] =
+				(float)triangle / 24.0f * levels[level] +
+				(float)(int32_t)seed / 2147483648.0f *
+				0.001953125f;
+		}
+	}
+}
+
+static void generate_input(struct bench_input *input,
+		const struct bench_options *opts)
+{
+	switch (opts->signal) {
+	case SIGNAL_SWEEP:
+		generate_sweep(input, opts->sample_rate, opts->channels,
+				opts->seconds);
+		break;
+	case SIGNAL_STEP:
+		generate_step(input, opts->sample_rate, opts->channels,
+				opts->seconds);
+		break;
+	case SIGNAL_IMPULSE:
+		generate_impulses(input, opts->sample_rate, opts->channels,
+				opts->seconds);
+		break;
+	case SIGNAL_BURSTS:
+		generate_bursts(input, opts->sample_rate, opts->channels,
+				opts->seconds);
+		break;
+	}
+}
+
+static inline uint16_t read_u16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	       ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* reads 16 bit PCM or 32 bit float WAV files */
+static bool load_wav(struct bench_input *input, const char *file)
+{
+	uint16_t format = 0, channels = 0, bits = 0;
+	uint32_t sample_rate = 0;
+	uint8_t *data = NULL;
+	uint32_t data_size = 0;
+	uint8_t header[12];
+	uint8_t chunk[8];
+	bool success = false;
+	size_t frames;
+	FILE *f;
+
+	f = os_fopen(file, "rb");
+	if (!f) {
+		blog(LOG_ERROR, "Could not open '%s'", file);
+		return false;
+	}
+
+	if (fread(header, 1, sizeof(header), f) != sizeof(header) ||
+	    memcmp(header, "RIFF", 4) != 0 ||
+	    memcmp(header + 8, "WAVE", 4) != 0) {
+		blog(LOG_ERROR, "'%s' is not a WAV file", file);
+		goto exit;
+	}
+
+	while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+		uint32_t size = read_u32(chunk + 4);
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+			uint8_t fmt[16];
+
+			if (fread(fmt, 1, sizeof(fmt), f) != sizeof(fmt))
+				goto exit;
+
+			format      = read_u16(fmt);
+			channels    = read_u16(fmt + 2);
+			sample_rate = read_u32(fmt + 4);
+			bits        = read_u16(fmt + 14);
+			size       -= sizeof(fmt);
+
+		} else if (memcmp(chunk, "data", 4) == 0) {
+			data = bmalloc(size);
+			data_size = (uint32_t)fread(data, 1, size, f);
+			break;
+		}
+
+		fseek(f, (long)(size + (size & 1)), SEEK_CUR);
+	}
+
+	if (!data || !channels || channels > MAX_AV_PLANES || !sample_rate) {
+		blog(LOG_ERROR, "'%s' has no usable audio", file);
+		goto exit;
+	}
+
+	if (format == 1 && bits == 16) {
+		frames = data_size / (channels * sizeof(int16_t));
+		alloc_input(input, sample_rate, channels, frames);
+
+		for (size_t i = 0; i < frames; i++) {
+			for (uint16_t c = 0; c < channels; c++) {
+				const uint8_t *p = data +
+					(i * channels + c) * sizeof(int16_t);
+				input->planes[c][i] =
+					(float)(int16_t)read_u16(p) / 32768.0f;
+			}
+		}
+
+	} else if (format == 3 && bits == 32) {
+		frames = data_size / (channels * sizeof(float));
+		alloc_input(input, sample_rate, channels, frames);
+
+		for (size_t i = 0; i < frames; i++) {
+			for (uint16_t c = 0; c < channels; c++) {
+				const uint8_t *p = data +
+					(i * channels + c) * sizeof(float);
+				memcpy(&input->planes[c][i], p, sizeof(float));
+			}
+		}
+
+	} else {
+		blog(LOG_ERROR, "'%s': only 16 bit PCM and 32 bit float WAV "
+		                "files are supported", file);
+		goto exit;
+	}
+
+	success = true;
+
+exit:
+	bfree(data);
+	fclose(f);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* benchmark                                                                 */
+
+static enum speaker_layout channels_to_speakers(uint32_t channels)
+{
+	switch (channels) {
+	case 1: return SPEAKERS_MONO;
+	case 2: return SPEAKERS_STEREO;
+	case 3: return SPEAKERS_2POINT1;
+	case 4: return SPEAKERS_4POINT0;
+	case 5: return SPEAKERS_4POINT1;
+	case 6: return SPEAKERS_5POINT1;
+	case 8: return SPEAKERS_7POINT1;
+	}
+
+	return SPEAKERS_UNKNOWN;
+}
+
+static void save_output(struct bench_results *results,
+		const struct bench_input *input,
+		const struct obs_audio_data *out)
+{
+	size_t frames = out->frames;
+
+	if (frames > input->frames - results->output_frames)
+		frames = input->frames - results->output_frames;
+
+	for (uint32_t c = 0; c < input->channels; c++)
+		memcpy(results->output[c] + results->output_frames,
+				out->data[c], frames * sizeof(float));
+
+	results->output_frames += frames;
+}
+
+static void run_filter(obs_source_t *filter, const struct bench_input *input,
+		const struct bench_options *opts,
+		struct bench_results *results)
+{
+	struct bmem_tracking_stats start_stats = {0};
+	struct bmem_tracking_stats end_stats = {0};
+	float *packet[MAX_AV_PLANES] = {0};
+	const size_t packet_frames = opts->packet_frames;
+	const bool keep_output = opts->golden_file || opts->golden_out_file;
+	uint64_t timestamp = 0;
+
+	for (uint32_t c = 0; c < input->channels; c++) {
+		packet[c] = bmalloc(packet_frames * sizeof(float));
+		if (keep_output)
+			results->output[c] = bzalloc(input->frames *
+					sizeof(float));
+	}
+
+	bmem_tracking_get_stats(&start_stats);
+
+	for (uint32_t it = 0; it < opts->iterations; it++) {
+		for (size_t pos = 0; pos < input->frames;
+				pos += packet_frames) {
+			struct obs_audio_data audio = {0};
+			struct obs_audio_data *out;
+			size_t frames = input->frames - pos;
+			uint64_t start;
+
+			if (frames > packet_frames)
+				frames = packet_frames;
+
+			/* filters process in place, so give them a fresh
+			 * copy of the input each time */
+			for (uint32_t c = 0; c < input->channels; c++) {
+				memcpy(packet[c], input->planes[c] + pos,
+						frames * sizeof(float));
+				audio.data[c] = (uint8_t*)packet[c];
+			}
+
+			audio.frames = (uint32_t)frames;
+			audio.timestamp = timestamp;
+
+			start = os_gettime_ns();
+			out = obs_source_filter_audio(filter, &audio);
+			results->filter_ns += os_gettime_ns() - start;
+
+			results->frames_in += frames;
+			timestamp += audio_frames_to_ns(input->sample_rate,
+					frames);
+
+			if (!out) {
+				results->packets_held++;
+				continue;
+			}
+
+			for (uint32_t c = 0; c < input->channels; c++) {
+				const float *data = (const float*)out->data[c];
+				float sum_sq;
+				float peak = audio_block_peak_sum_sq(data,
+						out->frames, &sum_sq);
+
+				if (results->peak < peak)
+					results->peak = peak;
+
+				results->crc = calc_crc32(results->crc,
+						out->data[c],
+						out->frames * sizeof(float));
+			}
+
+			results->frames_out += out->frames;
+
+			if (keep_output && it == 0)
+				save_output(results, input, out);
+		}
+	}
+
+	bmem_tracking_get_stats(&end_stats);
+
+	results->allocs = end_stats.total_allocs - start_stats.total_allocs;
+	results->alloc_bytes = end_stats.total_bytes - start_stats.total_bytes;
+
+	for (uint32_t c = 0; c < input->channels; c++)
+		bfree(packet[c]);
+}
+
+static void print_results(const struct bench_options *opts,
+		const struct bench_input *input,
+		const struct bench_results *results)
+{
+	uint64_t samples = results->frames_in * input->channels;
+	double seconds = (double)results->frames_in /
+		(double)input->sample_rate;
+	double filter_seconds = (double)results->filter_ns / 1000000000.0;
+
+	printf("filter:          %s\n", opts->filter_id);
+	printf("input:           %s, %u Hz, %u channel(s), %.2f seconds\n",
+			opts->wav_file ? opts->wav_file : "synthetic",
+			input->sample_rate, input->channels,
+			(double)input->frames / (double)input->sample_rate);
+	printf("iterations:      %u\n", opts->iterations);
+	printf("ns/sample:       %.3f\n",
+			samples ? (double)results->filter_ns / samples : 0.0);
+	printf("realtime factor: %.1fx\n",
+			filter_seconds > 0.0 ? seconds / filter_seconds : 0.0);
+	printf("frames out:      %"PRIu64" (%"PRIu64" packet(s) held)\n",
+			results->frames_out, results->packets_held);
+	printf("allocations:     %"PRIu64" (%"PRIu64" bytes)\n",
+			results->allocs, results->alloc_bytes);
+	printf("peak:            %.3f dB\n", mul_to_db(results->peak));
+	printf("checksum:        %08X\n", results->crc);
+}
+
+/* ------------------------------------------------------------------------- */
+/* golden files                                                              */
+
+struct segment_level {
+	double     peak_db;
+	double     rms_db;
+};
+
+static inline double level_to_db(double level)
+{
+	double db = level > 0.0 ? 20.0 * log10(level) : GOLDEN_FLOOR_DB;
+	return db > GOLDEN_FLOOR_DB ? db : GOLDEN_FLOOR_DB;
+}
+
+static size_t calc_segment_levels(const struct bench_input *input,
+		const struct bench_results *results,
+		struct segment_level **levels)
+{
+	size_t count = (results->output_frames + GOLDEN_SEGMENT_FRAMES - 1) /
+		GOLDEN_SEGMENT_FRAMES;
+
+	*levels = bzalloc(count * sizeof(struct segment_level));
+
+	for (size_t i = 0; i < count; i++) {
+		size_t pos = i * GOLDEN_SEGMENT_FRAMES;
+		size_t frames = results->output_frames - pos;
+		double peak = 0.0;
+		double sum_sq = 0.0;
+
+		if (frames > GOLDEN_SEGMENT_FRAMES)
+			frames = GOLDEN_SEGMENT_FRAMES;
+
+		for (uint32_t c = 0; c < input->channels; c++) {
+			const float *data = results->output[c] + pos;
+
+			for (size_t j = 0; j < frames; j++) {
+				double val = fabs((double)data[j]);
+
+				if (peak < val)
+					peak = val;
+				sum_sq += val * val;
+			}
+		}
+
+		(*levels)[i].peak_db = level_to_db(peak);
+		(*levels)[i].rms_db = level_to_db(sqrt(sum_sq /
+				(double)(frames * input->channels)));
+	}
+
+	return count;
+}
+
+static bool write_golden(const char *file, const struct segment_level *levels,
+		size_t count)
+{
+	FILE *f = os_fopen(file, "w");
+
+	if (!f) {
+		blog(LOG_ERROR, "Could not create '%s'", file);
+		return false;
+	}
+
+	fprintf(f, "# audio-filter-bench output peak and RMS dB, one line per "
+			"%d frames\n", GOLDEN_SEGMENT_FRAMES);
+	for (size_t i = 0; i < count; i++)
+		fprintf(f, "%.3f %.3f\n", levels[i].peak_db,
+				levels[i].rms_db);
+
+	fclose(f);
+	return true;
+}
+
+static inline bool level_matches(double val, double expected,
+		double tolerance)
+{
+	return fabs(val - expected) <= tolerance;
+}
+
+static bool check_golden(const char *file, const struct segment_level *levels,
+		size_t count, uint32_t sample_rate, double tolerance)
+{
+	FILE *f = os_fopen(file, "r");
+	size_t mismatches = 0;
+	size_t segment = 0;
+	char line[256];
+
+	if (!f) {
+		blog(LOG_ERROR, "Could not open '%s'", file);
+		return false;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		struct segment_level expected;
+		const struct segment_level *level;
+
+		if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+			continue;
+
+		if (sscanf(line, "%lf %lf", &expected.peak_db,
+					&expected.rms_db) != 2) {
+			fprintf(stderr, "invalid golden file line: %s", line);
+			fclose(f);
+			return false;
+		}
+
+		level = levels + segment;
+		if (segment < count &&
+		    (!level_matches(level->peak_db, expected.peak_db,
+				    tolerance) ||
+		     !level_matches(level->rms_db, expected.rms_db,
+				    tolerance)) &&
+		    mismatches++ < 8)
+			fprintf(stderr, "output at %.1f s differs from the "
+					"golden file: peak %.3f dB, rms "
+					"%.3f dB, expected %.3f dB, "
+					"%.3f dB\n",
+					(double)(segment *
+					GOLDEN_SEGMENT_FRAMES) /
+					(double)sample_rate,
+					level->peak_db, level->rms_db,
+					expected.peak_db, expected.rms_db);
+		segment++;
+	}
+
+	fclose(f);
+
+	if (segment != count) {
+		fprintf(stderr, "golden file has %zu segments, output has "
+				"%zu\n", segment, count);
+		return false;
+	}
+
+	return mismatches == 0;
+}
+
+static bool process_golden(const struct bench_options *opts,
+		const struct bench_input *input,
+		const struct bench_results *results)
+{
+	struct segment_level *levels;
+	size_t count = calc_segment_levels(input, results, &levels);
+	bool success = true;
+
+	if (opts->golden_out_file)
+		success = write_golden(opts->golden_out_file, levels, count);
+	if (success && opts->golden_file)
+		success = check_golden(opts->golden_file, levels, count,
+				input->sample_rate, opts->tolerance_db);
+
+	bfree(levels);
+	return success;
+}
+
+static int run_bench(const struct bench_options *opts)
+{
+	struct bench_results results = {0};
+	struct bench_input input = {0};
+	struct obs_audio_info oai;
+	obs_source_t *filter = NULL;
+	obs_data_t *settings = NULL;
+	uint32_t flags;
+	int ret = EXIT_FAILURE;
+
+	if (opts->wav_file) {
+		if (!load_wav(&input, opts->wav_file))
+			return EXIT_FAILURE;
+	} else {
+		generate_input(&input, opts);
+	}
+
+	oai.samples_per_sec = input.sample_rate;
+	oai.speakers = channels_to_speakers(input.channels);
+	if (oai.speakers == SPEAKERS_UNKNOWN) {
+		blog(LOG_ERROR, "Unsupported channel count: %u",
+				input.channels);
+		goto exit;
+	}
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		blog(LOG_ERROR, "Could not start libobs");
+		goto exit;
+	}
+
+	if (!obs_reset_audio(&oai)) {
+		blog(LOG_ERROR, "Could not initialize audio");
+		goto shutdown;
+	}
+
+	if (opts->module_bin_path)
+		obs_add_module_path(opts->module_bin_path,
+				opts->module_data_path ?
+				opts->module_data_path : "");
+	obs_load_all_modules();
+	obs_post_load_modules();
+
+	flags = obs_get_source_output_flags(opts->filter_id);
+	if (obs_source_get_display_name(opts->filter_id) == NULL) {
+		blog(LOG_ERROR, "No source type with id '%s'", opts->filter_id);
+		goto shutdown;
+	}
+	if ((flags & OBS_SOURCE_AUDIO) == 0) {
+		blog(LOG_ERROR, "'%s' is not an audio filter", opts->filter_id);
+		goto shutdown;
+	}
+
+	if (opts->settings_json) {
+		settings = obs_data_create_from_json(opts->settings_json);
+		if (!settings) {
+			blog(LOG_ERROR, "Invalid settings JSON");
+			goto shutdown;
+		}
+	}
+
+	filter = obs_source_create(opts->filter_id, "bench", settings, NULL);
+	if (!filter || obs_source_get_type(filter) != OBS_SOURCE_TYPE_FILTER) {
+		blog(LOG_ERROR, "Could not create filter '%s'",
+				opts->filter_id);
+		goto shutdown;
+	}
+
+	run_filter(filter, &input, opts, &results);
+	print_results(opts, &input, &results);
+
+	ret = EXIT_SUCCESS;
+	if (opts->check_crc && results.crc != opts->expected_crc) {
+		fprintf(stderr, "checksum mismatch: expected %08X, got %08X\n",
+				opts->expected_crc, results.crc);
+		ret = EXIT_FAILURE;
+	}
+
+	/* allows for the rounding of the final multiply */
+	if (opts->check_peak &&
+	    results.peak > db_to_mul(opts->max_peak_db) * 1.000001f) {
+		fprintf(stderr, "output peak of %.6f dB exceeds %.6f dB\n",
+				mul_to_db(results.peak), opts->max_peak_db);
+		ret = EXIT_FAILURE;
+	}
+
+	if ((opts->golden_file || opts->golden_out_file) &&
+	    !process_golden(opts, &input, &results))
+		ret = EXIT_FAILURE;
+
+shutdown:
+	obs_source_release(filter);
+	obs_data_release(settings);
+	obs_shutdown();
+
+exit:
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		bfree(results.output[i]);
+	free_input(&input);
+	return ret;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *exe)
+{
+	fprintf(stderr,
+		"usage: %s [options] <filter id>\n"
+		"\n"
+		"  -i <file.wav>     use a 16 bit PCM or 32 bit float WAV file\n"
+		"                    as input instead of a synthetic signal\n"
+		"  -r <rate>         synthetic input sample rate (default %d)\n"
+		"  -c <channels>     synthetic input channels (default %d)\n"
+		"  -t <seconds>      synthetic input length (default %d)\n"
+		"  -g <signal>       synthetic input signal: sweep (default),\n"
+		"                    step, impulse or bursts\n"
+		"  -k <frames>       frames per packet (default %d)\n"
+		"  -n <iterations>   times to run through the input "
+		"(default %d)\n"
+		"  -s <json>         filter settings as a JSON object\n"
+		"  -m <path>         module binary search path\n"
+		"  -d <path>         module data search path\n"
+		"  -e <checksum>     fail unless the output checksum matches\n"
+		"  -p <dB>           fail if the output peak exceeds this level\n"
+		"  -x <file>         fail unless the output levels match a "
+		"golden file\n"
+		"  -l <dB>           golden file level tolerance "
+		"(default %.2f)\n"
+		"  -o <file>         write the output levels to a golden "
+		"file\n"
+		"  -v                print libobs log output\n",
+		exe, DEFAULT_SAMPLE_RATE, DEFAULT_CHANNELS, DEFAULT_SECONDS,
+		AUDIO_OUTPUT_FRAMES, DEFAULT_ITERATIONS,
+		DEFAULT_TOLERANCE_DB);
+}
+
+static bool parse_options(struct bench_options *opts, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (arg[0] != '-') {
+			if (opts->filter_id)
+				return false;
+			opts->filter_id = arg;
+			continue;
+		}
+
+		if (strcmp(arg, "-v") == 0) {
+			opts->verbose = true;
+			continue;
+		}
+
+		if (!val)
+			return false;
+		i++;
+
+		if (strcmp(arg, "-i") == 0) {
+			opts->wav_file = val;
+		} else if (strcmp(arg, "-r") == 0) {
+			opts->sample_rate = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "-c") == 0) {
+			opts->channels = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "-t") == 0) {
+			opts->seconds = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "-n") == 0) {
+			opts->iterations = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "-s") == 0) {
+			opts->settings_json = val;
+		} else if (strcmp(arg, "-e") == 0) {
+			opts->expected_crc = (uint32_t)strtoul(val, NULL, 16);
+			opts->check_crc = true;
+		} else if (strcmp(arg, "-p") == 0) {
+			opts->max_peak_db = (float)strtod(val, NULL);
+			opts->check_peak = true;
+		} else if (strcmp(arg, "-g") == 0) {
+			if (strcmp(val, "sweep") == 0)
+				opts->signal = SIGNAL_SWEEP;
+			else if (strcmp(val, "step") == 0)
+				opts->signal = SIGNAL_STEP;
+			else if (strcmp(val, "impulse") == 0)
+				opts->signal = SIGNAL_IMPULSE;
+			else if (strcmp(val, "bursts") == 0)
+				opts->signal = SIGNAL_BURSTS;
+			else
+				return false;
+		} else if (strcmp(arg, "-k") == 0) {
+			opts->packet_frames = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "-x") == 0) {
+			opts->golden_file = val;
+		} else if (strcmp(arg, "-l") == 0) {
+			opts->tolerance_db = strtod(val, NULL);
+		} else if (strcmp(arg, "-o") == 0) {
+			opts->golden_out_file = val;
+		} else if (strcmp(arg, "-m") == 0) {
+			opts->module_bin_path = val;
+		} else if (strcmp(arg, "-d") == 0) {
+			opts->module_data_path = val;
+		} else {
+			return false;
+		}
+	}
+
+	return opts->filter_id && opts->sample_rate && opts->channels &&
+		opts->seconds && opts->iterations && opts->packet_frames;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_options opts = {
+		.sample_rate   = DEFAULT_SAMPLE_RATE,
+		.channels      = DEFAULT_CHANNELS,
+		.seconds       = DEFAULT_SECONDS,
+		.iterations    = DEFAULT_ITERATIONS,
+		.packet_frames = AUDIO_OUTPUT_FRAMES,
+		.tolerance_db  = DEFAULT_TOLERANCE_DB
+	};
+	int ret;
+
+	if (!parse_options(&opts, argc, argv)) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	verbose = opts.verbose;
+	base_set_log_handler(do_log, NULL);
+
+	/* must happen before anything is allocated */
+	bmem_enable_tracking();
+
+	ret = run_bench(&opts);
+
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	return ret;
+}
@@ -0,0 +1,323 @@
+/*
+ * Audio monitoring latency benchmark.
+ *
+ * Feeds a sine wave in real time to a source that is monitored on a
+ * PulseAudio sink, and periodically samples the monitor's playback
+ * statistics.  Played frames and latency are measured from the stream's
+ * timing info, i.e. from the position the sink has actually played up to.
+ * Reports the minimum, average and maximum output latency along with
+ * underruns and dropped frames, so that target latencies can be compared
+ * without audible testing.  A null sink keeps the results independent of the
+ * sound card:
+ *
+ *   pactl load-module module-null-sink sink_name=obs_bench
+ *   audio-monitor-latency -d obs_bench -l 20
+ *
+ * usage: audio-monitor-latency [options]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <obs.h>
+
+#define DEFAULT_SAMPLE_RATE 48000
+#define DEFAULT_SECONDS     10
+#define DEFAULT_PACKET_MS   10
+#define SAMPLE_INTERVAL_NS  100000000ULL
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+struct bench_options {
+	const char *device;
+	uint32_t   latency_ms;
+	uint32_t   sample_rate;
+	uint32_t   seconds;
+	uint32_t   packet_ms;
+	bool       verbose;
+};
+
+struct bench_results {
+	struct obs_audio_monitoring_stats stats;
+	uint64_t   min_latency_ns;
+	uint64_t   max_latency_ns;
+	uint64_t   total_latency_ns;
+	uint64_t   samples;
+	uint64_t   late_packets;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static bool verbose = false;
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (verbose || log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fputc('\n', stderr);
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+/* ------------------------------------------------------------------------- */
+/* audio source                                                              */
+
+static const char *bench_source_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Monitor Latency Source";
+}
+
+static void *bench_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void bench_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info bench_source = {
+	.id           = "audio_monitor_latency_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name     = bench_source_name,
+	.create       = bench_source_create,
+	.destroy      = bench_source_destroy
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void sample_stats(obs_source_t *source, struct bench_results *results)
+{
+	struct obs_audio_monitoring_stats stats;
+
+	if (!obs_source_get_audio_monitoring_stats(source, &stats))
+		return;
+
+	/* nothing has been played yet */
+	if (!stats.frames)
+		return;
+
+	if (!results->samples || stats.latency_ns < results->min_latency_ns)
+		results->min_latency_ns = stats.latency_ns;
+	if (stats.latency_ns > results->max_latency_ns)
+		results->max_latency_ns = stats.latency_ns;
+
+	results->total_latency_ns += stats.latency_ns;
+	results->samples++;
+	results->stats = stats;
+}
+
+static void run_source(obs_source_t *source, const struct bench_options *opts,
+		struct bench_results *results)
+{
+	uint32_t frames = opts->sample_rate * opts->packet_ms / 1000;
+	uint64_t packet_ns = (uint64_t)opts->packet_ms * 1000000ULL;
+	uint64_t start_time = os_gettime_ns();
+	uint64_t end_time = start_time +
+		(uint64_t)opts->seconds * 1000000000ULL;
+	uint64_t next_sample = start_time + SAMPLE_INTERVAL_NS;
+	uint64_t ts = start_time;
+	double phase = 0.0;
+	double step = 2.0 * M_PI * 440.0 / (double)opts->sample_rate;
+	float *samples = malloc(frames * sizeof(float));
+
+	while (ts < end_time) {
+		struct obs_source_audio data = {0};
+
+		for (uint32_t i = 0; i < frames; i++) {
+			samples[i] = (float)(sin(phase) * 0.25);
+			phase += step;
+			if (phase > 2.0 * M_PI)
+				phase -= 2.0 * M_PI;
+		}
+
+		data.data[0] = (const uint8_t *)samples;
+		data.frames = frames;
+		data.speakers = SPEAKERS_MONO;
+		data.samples_per_sec = opts->sample_rate;
+		data.format = AUDIO_FORMAT_FLOAT;
+		data.timestamp = ts;
+		obs_source_output_audio(source, &data);
+
+		ts += packet_ns;
+		if (!os_sleepto_ns(ts))
+			results->late_packets++;
+
+		if (os_gettime_ns() >= next_sample) {
+			sample_stats(source, results);
+			next_sample += SAMPLE_INTERVAL_NS;
+		}
+	}
+
+	free(samples);
+}
+
+static void print_results(const struct bench_options *opts,
+		const struct bench_results *results)
+{
+	const struct obs_audio_monitoring_stats *stats = &results->stats;
+	double avg = results->samples ?
+		(double)results->total_latency_ns /
+		(double)results->samples : 0.0;
+
+	printf("device:           %s\n", opts->device);
+	if (opts->latency_ms)
+		printf("target latency:   %u ms\n", opts->latency_ms);
+	else
+		printf("target latency:   default\n");
+	printf("latency:          %.2f ms min, %.2f ms avg, %.2f ms max\n",
+			(double)results->min_latency_ns / 1000000.0,
+			avg / 1000000.0,
+			(double)results->max_latency_ns / 1000000.0);
+	printf("frames played:    %"PRIu64"\n", stats->frames);
+	printf("frames dropped:   %"PRIu64"\n", stats->dropped_frames);
+	printf("underruns:        %u\n", stats->underruns);
+	printf("late packets:     %"PRIu64"\n", results->late_packets);
+}
+
+static int run_bench(const struct bench_options *opts)
+{
+	struct obs_audio_info oai = {
+		.samples_per_sec = opts->sample_rate,
+		.speakers        = SPEAKERS_STEREO
+	};
+	struct bench_results results = {0};
+	obs_source_t *source = NULL;
+	int ret = EXIT_FAILURE;
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		blog(LOG_ERROR, "Could not start libobs");
+		return EXIT_FAILURE;
+	}
+
+	if (!obs_reset_audio(&oai)) {
+		blog(LOG_ERROR, "Could not initialize audio");
+		goto shutdown;
+	}
+
+	if (!obs_set_audio_monitoring_device(opts->device, opts->device)) {
+		blog(LOG_ERROR, "Audio monitoring is not supported");
+		goto shutdown;
+	}
+	obs_set_audio_monitoring_latency(opts->latency_ms);
+
+	obs_register_source(&bench_source);
+	source = obs_source_create(bench_source.id, "bench", NULL, NULL);
+	if (!source) {
+		blog(LOG_ERROR, "Could not create source");
+		goto shutdown;
+	}
+
+	obs_source_set_monitoring_type(source,
+			OBS_MONITORING_TYPE_MONITOR_ONLY);
+	obs_set_output_source(0, source);
+
+	run_source(source, opts, &results);
+
+	obs_set_output_source(0, NULL);
+
+	if (!results.samples) {
+		blog(LOG_ERROR, "No monitoring statistics available for '%s'",
+				opts->device);
+		goto shutdown;
+	}
+
+	print_results(opts, &results);
+	ret = EXIT_SUCCESS;
+
+shutdown:
+	if (source)
+		obs_source_set_monitoring_type(source,
+				OBS_MONITORING_TYPE_NONE);
+	obs_source_release(source);
+	obs_shutdown();
+	return ret;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *exe)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"\n"
+		"  -d <sink>         PulseAudio sink to monitor on "
+		"(default: default)\n"
+		"  -l <ms>           target monitoring latency, 0 for the "
+		"default (default 0)\n"
+		"  -r <rate>         source sample rate (default %d)\n"
+		"  -t <seconds>      length of the run (default %d)\n"
+		"  -p <ms>           source packet length (default %d)\n"
+		"  -v                print libobs log output\n",
+		exe, DEFAULT_SAMPLE_RATE, DEFAULT_SECONDS, DEFAULT_PACKET_MS);
+}
+
+static bool parse_options(struct bench_options *opts, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "-v") == 0) {
+			opts->verbose = true;
+			continue;
+		}
+
+		if (!val)
+			return false;
+		i++;
+
+		if (strcmp(arg, "-d") == 0) {
+			opts->device = val;
+		} else if (strcmp(arg, "-l") == 0) {
+			opts->latency_ms = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "-r") == 0) {
+			opts->sample_rate = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "-t") == 0) {
+			opts->seconds = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "-p") == 0) {
+			opts->packet_ms = (uint32_t)strtoul(val, NULL, 10);
+		} else {
+			return false;
+		}
+	}
+
+	return *opts->device && opts->sample_rate && opts->seconds &&
+		opts->packet_ms && opts->sample_rate * opts->packet_ms >= 1000;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_options opts = {
+		.device      = "default",
+		.sample_rate = DEFAULT_SAMPLE_RATE,
+		.seconds     = DEFAULT_SECONDS,
+		.packet_ms   = DEFAULT_PACKET_MS
+	};
+	int ret;
+
+	if (!parse_options(&opts, argc, argv)) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	verbose = opts.verbose;
+	base_set_log_handler(do_log, NULL);
+
+	ret = run_bench(&opts);
+
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	return ret;
+}
@@ -0,0 +1,248 @@
+/*
+ * Outputs async audio with timestamps unrelated to the system clock through
+ * a filter that holds back a fixed amount of audio, once for each of two
+ * packet sizes.  The filter reports what it holds back through
+ * get_audio_latency, so the timing libobs derives for the source must match
+ * the time the audio left the filter would have arrived without it.
+ *
+ * The derived timing isn't exposed through the API, so this reads it from
+ * the source internals.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include <obs-internal.h>
+
+#define SAMPLE_RATE   48000
+#define DELAY_FRAMES  1000
+#define MAX_FRAMES    1024
+#define TEST_PACKETS  32
+
+/* ------------------------------------------------------------------------- */
+/* filter that delays audio by at least DELAY_FRAMES                         */
+
+struct delay_filter {
+	struct circlebuf       buf[2];
+	float                  out[2][MAX_FRAMES];
+	struct obs_audio_data  out_data;
+	uint64_t               first_ts;
+	uint64_t               frames_out;
+	bool                   started;
+};
+
+static const char *delay_filter_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Delay Filter";
+}
+
+static void *delay_filter_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(source);
+	return bzalloc(sizeof(struct delay_filter));
+}
+
+static void delay_filter_destroy(void *data)
+{
+	struct delay_filter *df = data;
+
+	for (size_t i = 0; i < 2; i++)
+		circlebuf_free(&df->buf[i]);
+	bfree(df);
+}
+
+static inline size_t buffered_frames(struct delay_filter *df)
+{
+	return df->buf[0].size / sizeof(float);
+}
+
+static struct obs_audio_data *delay_filter_audio(void *data,
+		struct obs_audio_data *audio)
+{
+	struct delay_filter *df = data;
+	size_t frames = audio->frames;
+
+	if (!df->started) {
+		df->first_ts = audio->timestamp;
+		df->started = true;
+	}
+
+	for (size_t i = 0; i < 2; i++)
+		circlebuf_push_back(&df->buf[i], audio->data[i],
+				frames * sizeof(float));
+
+	if (buffered_frames(df) < DELAY_FRAMES + frames)
+		return NULL;
+
+	for (size_t i = 0; i < 2; i++) {
+		circlebuf_pop_front(&df->buf[i], df->out[i],
+				frames * sizeof(float));
+		df->out_data.data[i] = (uint8_t*)df->out[i];
+	}
+
+	/* output keeps the timestamps of the audio that went in */
+	df->out_data.frames = (uint32_t)frames;
+	df->out_data.timestamp = df->first_ts +
+		audio_frames_to_ns(SAMPLE_RATE, df->frames_out);
+	df->frames_out += frames;
+	return &df->out_data;
+}
+
+static uint64_t delay_filter_latency(void *data)
+{
+	struct delay_filter *df = data;
+	return audio_frames_to_ns(SAMPLE_RATE, buffered_frames(df));
+}
+
+static struct obs_source_info delay_filter = {
+	.id                = "delay_test_filter",
+	.type              = OBS_SOURCE_TYPE_FILTER,
+	.output_flags      = OBS_SOURCE_AUDIO,
+	.get_name          = delay_filter_name,
+	.create            = delay_filter_create,
+	.destroy           = delay_filter_destroy,
+	.filter_audio      = delay_filter_audio,
+	.get_audio_latency = delay_filter_latency
+};
+
+/* ------------------------------------------------------------------------- */
+/* async audio source                                                        */
+
+static const char *audio_source_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Async Audio Source";
+}
+
+static void *audio_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void audio_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info audio_source = {
+	.id           = "async_audio_test_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name     = audio_source_name,
+	.create       = audio_source_create,
+	.destroy      = audio_source_destroy
+};
+
+/* ------------------------------------------------------------------------- */
+
+static int run_test(uint32_t packet_frames)
+{
+	static float silence[MAX_FRAMES];
+	obs_source_t *source = obs_source_create(audio_source.id, "source",
+			NULL, NULL);
+	obs_source_t *filter = obs_source_create(delay_filter.id, "filter",
+			NULL, NULL);
+	struct obs_source_audio audio = {
+		.data            = {(uint8_t*)silence, (uint8_t*)silence},
+		.frames          = packet_frames,
+		.speakers        = SPEAKERS_STEREO,
+		.format          = AUDIO_FORMAT_FLOAT_PLANAR,
+		.samples_per_sec = SAMPLE_RATE
+	};
+	uint64_t held_frames = (DELAY_FRAMES + packet_frames - 1) /
+		packet_frames * packet_frames;
+	uint64_t expected_latency = audio_frames_to_ns(SAMPLE_RATE,
+			held_frames);
+	uint64_t timing_adjust = 0;
+	int failures = 0;
+
+	obs_source_filter_add(source, filter);
+
+	for (uint64_t i = 0; i < TEST_PACKETS; i++) {
+		struct delay_filter *df = filter->context.data;
+		bool first_output = !df->frames_out;
+		uint64_t before, after, arrival;
+
+		audio.timestamp = audio_frames_to_ns(SAMPLE_RATE,
+				i * packet_frames);
+
+		before = os_gettime_ns();
+		obs_source_output_audio(source, &audio);
+		after = os_gettime_ns();
+
+		if (!df->frames_out)
+			continue;
+
+		if (first_output) {
+			/* the audio that just went in arrived now, so its
+			 * timestamp must map to the time of the call */
+			timing_adjust = source->timing_adjust;
+			arrival = audio.timestamp + timing_adjust;
+
+			if (arrival < before || arrival > after) {
+				fprintf(stderr, "%"PRIu32" frame packets: "
+						"arrival off by %"PRId64" ns\n",
+						packet_frames,
+						(int64_t)(arrival - before));
+				failures++;
+			}
+
+		} else if (source->timing_adjust != timing_adjust) {
+			fprintf(stderr, "%"PRIu32" frame packets: timing "
+					"changed at packet %"PRIu64"\n",
+					packet_frames, i);
+			failures++;
+		}
+
+		if (obs_source_get_audio_latency(source) != expected_latency) {
+			fprintf(stderr, "%"PRIu32" frame packets: latency "
+					"%"PRIu64" ns, expected %"PRIu64" ns\n",
+					packet_frames,
+					obs_source_get_audio_latency(source),
+					expected_latency);
+			failures++;
+		}
+	}
+
+	if (!timing_adjust) {
+		fprintf(stderr, "%"PRIu32" frame packets: filter never "
+				"output audio\n", packet_frames);
+		failures++;
+	}
+
+	obs_source_filter_remove(source, filter);
+	obs_source_release(filter);
+	obs_source_release(source);
+	return failures;
+}
+
+int main(void)
+{
+	struct obs_audio_info oai = {
+		.samples_per_sec = SAMPLE_RATE,
+		.speakers        = SPEAKERS_STEREO
+	};
+	int failures = 0;
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return EXIT_FAILURE;
+
+	if (!obs_reset_audio(&oai)) {
+		obs_shutdown();
+		return EXIT_FAILURE;
+	}
+
+	obs_register_source(&audio_source);
+	obs_register_source(&delay_filter);
+
+	/* one packet size that divides the delay, one that doesn't */
+	failures += run_test(1000);
+	failures += run_test(1024);
+
+	obs_shutdown();
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
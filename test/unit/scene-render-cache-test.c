@@ -0,0 +1,234 @@
+/*
+ * Renders a scene with two overlapping, partially transparent items over an
+ * opaque background, once directly and once through the scene's render
+ * cache, and checks that both give the same pixels.
+ *
+ * Needs a graphics subsystem and the libobs data files, the test is skipped
+ * if video can't be initialized.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <obs.h>
+
+#define TEST_SKIPPED 77
+
+#define BASE_SIZE    64
+#define SOURCE_SIZE  32
+#define TOLERANCE    2
+
+#ifdef _WIN32
+#define GRAPHICS_MODULE DL_D3D11
+#else
+#define GRAPHICS_MODULE DL_OPENGL
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* partially transparent source                                              */
+
+struct alpha_source {
+	gs_texture_t *tex;
+};
+
+static const char *alpha_source_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Partial Alpha Source";
+}
+
+static void *alpha_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct alpha_source *context = bzalloc(sizeof(struct alpha_source));
+	uint32_t pixels[SOURCE_SIZE * SOURCE_SIZE];
+	const uint8_t *data = (const uint8_t*)pixels;
+
+	/* RGBA 255, 128, 0, 128 */
+	for (size_t i = 0; i < SOURCE_SIZE * SOURCE_SIZE; i++)
+		pixels[i] = 0x800080FF;
+
+	obs_enter_graphics();
+	context->tex = gs_texture_create(SOURCE_SIZE, SOURCE_SIZE, GS_RGBA, 1,
+			&data, 0);
+	obs_leave_graphics();
+
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(source);
+	return context;
+}
+
+static void alpha_source_destroy(void *data)
+{
+	struct alpha_source *context = data;
+
+	obs_enter_graphics();
+	gs_texture_destroy(context->tex);
+	obs_leave_graphics();
+
+	bfree(context);
+}
+
+static uint32_t alpha_source_size(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return SOURCE_SIZE;
+}
+
+static void alpha_source_render(void *data, gs_effect_t *effect)
+{
+	struct alpha_source *context = data;
+
+	obs_source_draw(context->tex, 0, 0, 0, 0, false);
+	UNUSED_PARAMETER(effect);
+}
+
+static struct obs_source_info alpha_source = {
+	.id           = "partial_alpha_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_STATIC_RENDER,
+	.get_name     = alpha_source_name,
+	.create       = alpha_source_create,
+	.destroy      = alpha_source_destroy,
+	.get_width    = alpha_source_size,
+	.get_height   = alpha_source_size,
+	.video_render = alpha_source_render
+};
+
+/* ------------------------------------------------------------------------- */
+
+static bool render_scene(obs_source_t *scene, uint8_t *pixels)
+{
+	gs_texrender_t *texrender;
+	gs_stagesurf_t *stagesurf;
+	struct vec4 background;
+	uint8_t *data;
+	uint32_t linesize;
+	bool success = false;
+
+	obs_enter_graphics();
+
+	texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	stagesurf = gs_stagesurface_create(BASE_SIZE, BASE_SIZE, GS_RGBA);
+
+	if (gs_texrender_begin(texrender, BASE_SIZE, BASE_SIZE)) {
+		vec4_set(&background, 0.0f, 0.25f, 1.0f, 1.0f);
+		gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+		gs_ortho(0.0f, (float)BASE_SIZE, 0.0f, (float)BASE_SIZE,
+				-100.0f, 100.0f);
+
+		obs_source_video_render(scene);
+		gs_texrender_end(texrender);
+
+		gs_stage_texture(stagesurf,
+				gs_texrender_get_texture(texrender));
+
+		if (gs_stagesurface_map(stagesurf, &data, &linesize)) {
+			for (uint32_t y = 0; y < BASE_SIZE; y++)
+				memcpy(pixels + y * BASE_SIZE * 4,
+						data + y * linesize,
+						BASE_SIZE * 4);
+			gs_stagesurface_unmap(stagesurf);
+			success = true;
+		}
+	}
+
+	gs_stagesurface_destroy(stagesurf);
+	gs_texrender_destroy(texrender);
+
+	obs_leave_graphics();
+	return success;
+}
+
+static int compare_pixels(const uint8_t *direct, const uint8_t *cached)
+{
+	int failures = 0;
+
+	for (size_t i = 0; i < BASE_SIZE * BASE_SIZE * 4; i++) {
+		int diff = abs((int)direct[i] - (int)cached[i]);
+
+		if (diff > TOLERANCE && failures++ < 8)
+			fprintf(stderr, "pixel %d,%d channel %d: direct %d, "
+					"cached %d\n",
+					(int)(i / 4 % BASE_SIZE),
+					(int)(i / 4 / BASE_SIZE),
+					(int)(i % 4),
+					direct[i], cached[i]);
+	}
+
+	return failures;
+}
+
+static int run_test(void)
+{
+	static uint8_t direct[BASE_SIZE * BASE_SIZE * 4];
+	static uint8_t cached[BASE_SIZE * BASE_SIZE * 4];
+	obs_scene_t *scene = obs_scene_create("scene");
+	obs_source_t *source = obs_source_create(alpha_source.id, "alpha",
+			NULL, NULL);
+	obs_source_t *scene_source = obs_scene_get_source(scene);
+	struct vec2 pos;
+	int ret = EXIT_FAILURE;
+
+	vec2_set(&pos, 8.0f, 8.0f);
+	obs_sceneitem_set_pos(obs_scene_add(scene, source), &pos);
+	vec2_set(&pos, 24.0f, 24.0f);
+	obs_sceneitem_set_pos(obs_scene_add(scene, source), &pos);
+
+	obs_scene_set_render_cache(scene, false);
+	if (!render_scene(scene_source, direct))
+		goto fail;
+
+	/* the first render fills the cache, the second one only draws it */
+	obs_scene_set_render_cache(scene, true);
+	if (!render_scene(scene_source, cached) ||
+	    !render_scene(scene_source, cached))
+		goto fail;
+
+	if (compare_pixels(direct, cached) == 0)
+		ret = EXIT_SUCCESS;
+
+fail:
+	if (ret != EXIT_SUCCESS)
+		fprintf(stderr, "cached scene output differs from direct "
+				"output\n");
+
+	obs_source_release(source);
+	obs_scene_release(scene);
+	return ret;
+}
+
+int main(void)
+{
+	struct obs_video_info ovi = {
+		.graphics_module = GRAPHICS_MODULE,
+		.fps_num         = 30,
+		.fps_den         = 1,
+		.base_width      = BASE_SIZE,
+		.base_height     = BASE_SIZE,
+		.output_width    = BASE_SIZE,
+		.output_height   = BASE_SIZE,
+		.output_format   = VIDEO_FORMAT_RGBA,
+		.gpu_conversion  = true,
+		.colorspace      = VIDEO_CS_DEFAULT,
+		.range           = VIDEO_RANGE_DEFAULT,
+		.scale_type      = OBS_SCALE_BILINEAR
+	};
+	int ret;
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return EXIT_FAILURE;
+
+	if (!*ovi.graphics_module ||
+	    obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS) {
+		fprintf(stderr, "skipped: video could not be initialized\n");
+		obs_shutdown();
+		return TEST_SKIPPED;
+	}
+
+	obs_register_source(&alpha_source);
+	ret = run_test();
+
+	obs_shutdown();
+	return ret;
+}
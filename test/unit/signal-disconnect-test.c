@@ -0,0 +1,191 @@
+/*
+ * Two threads dispatch the same signal at the same time, and each one
+ * disconnects the other thread's callback from inside its own callback.
+ * Neither disconnect may wait for the other callback to return, otherwise
+ * both threads wait on each other forever.
+ *
+ * Disconnecting from inside a callback must still wait for other threads
+ * that are running the callback being removed, because the caller may free
+ * its data as soon as the disconnect returns.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <util/threading.h>
+#include <util/platform.h>
+#include <callback/signal.h>
+
+#define TIMEOUT_MS 5000
+#define SLOW_CALLBACK_MS 100
+
+struct thread_data {
+	signal_handler_t   *handler;
+	pthread_t          thread;
+	os_event_t         *start;
+	os_event_t         *entered;
+	struct thread_data *other;
+};
+
+static os_event_t *finished = NULL;
+static volatile long threads_done = 0;
+
+static void test_callback(void *data, calldata_t *params)
+{
+	struct thread_data *td = data;
+
+	/* only act on the callback that belongs to the emitting thread */
+	if (!pthread_equal(pthread_self(), td->thread))
+		return;
+
+	/* make sure both threads are inside their callbacks */
+	os_event_signal(td->entered);
+	if (os_event_timedwait(td->other->entered, TIMEOUT_MS) != 0)
+		return;
+
+	signal_handler_disconnect(td->handler, "test", test_callback,
+			td->other);
+
+	UNUSED_PARAMETER(params);
+}
+
+static void *emit_thread(void *data)
+{
+	struct thread_data *td = data;
+	calldata_t params = {0};
+
+	/* td->thread is read by the callbacks, so wait until it's set */
+	os_event_wait(td->start);
+	signal_handler_signal(td->handler, "test", &params);
+
+	if (os_atomic_inc_long(&threads_done) == 2)
+		os_event_signal(finished);
+	return NULL;
+}
+
+static bool test_mutual_disconnect(void)
+{
+	struct thread_data td[2] = {{0}};
+	signal_handler_t *handler = signal_handler_create();
+
+	if (!handler || !signal_handler_add(handler, "void test()"))
+		return false;
+
+	os_event_init(&finished, OS_EVENT_TYPE_MANUAL);
+
+	for (size_t i = 0; i < 2; i++) {
+		td[i].handler = handler;
+		td[i].other   = &td[1 - i];
+		os_event_init(&td[i].start, OS_EVENT_TYPE_AUTO);
+		os_event_init(&td[i].entered, OS_EVENT_TYPE_MANUAL);
+		signal_handler_connect(handler, "test", test_callback, &td[i]);
+	}
+
+	for (size_t i = 0; i < 2; i++)
+		pthread_create(&td[i].thread, NULL, emit_thread, &td[i]);
+
+	/* each thread has its own event, signaling only wakes one waiter */
+	for (size_t i = 0; i < 2; i++)
+		os_event_signal(td[i].start);
+
+	if (os_event_timedwait(finished, TIMEOUT_MS) != 0) {
+		fprintf(stderr, "deadlock: threads disconnecting each other's "
+				"callbacks did not return\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < 2; i++) {
+		pthread_join(td[i].thread, NULL);
+		os_event_destroy(td[i].start);
+		os_event_destroy(td[i].entered);
+	}
+
+	os_event_destroy(finished);
+	signal_handler_destroy(handler);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct slow_data {
+	signal_handler_t   *handler;
+	os_event_t         *entered;
+	volatile bool      running;
+	bool               still_running;
+};
+
+static void slow_callback(void *data, calldata_t *params)
+{
+	struct slow_data *sd = data;
+
+	os_atomic_set_bool(&sd->running, true);
+	os_event_signal(sd->entered);
+	os_sleep_ms(SLOW_CALLBACK_MS);
+	os_atomic_set_bool(&sd->running, false);
+
+	UNUSED_PARAMETER(params);
+}
+
+static void disconnect_callback(void *data, calldata_t *params)
+{
+	struct slow_data *sd = data;
+
+	signal_handler_disconnect(sd->handler, "test", slow_callback, sd);
+	sd->still_running = os_atomic_load_bool(&sd->running);
+
+	UNUSED_PARAMETER(params);
+}
+
+static void *slow_emit_thread(void *data)
+{
+	struct slow_data *sd = data;
+	calldata_t params = {0};
+
+	signal_handler_signal(sd->handler, "test", &params);
+	return NULL;
+}
+
+static bool test_disconnect_waits_in_emit(void)
+{
+	struct slow_data sd = {0};
+	calldata_t params = {0};
+	pthread_t thread;
+
+	sd.handler = signal_handler_create();
+	if (!sd.handler ||
+	    !signal_handler_add(sd.handler, "void test()") ||
+	    !signal_handler_add(sd.handler, "void other()"))
+		return false;
+
+	os_event_init(&sd.entered, OS_EVENT_TYPE_MANUAL);
+	signal_handler_connect(sd.handler, "test", slow_callback, &sd);
+	signal_handler_connect(sd.handler, "other", disconnect_callback, &sd);
+
+	pthread_create(&thread, NULL, slow_emit_thread, &sd);
+	if (os_event_timedwait(sd.entered, TIMEOUT_MS) != 0) {
+		fprintf(stderr, "slow callback was never called\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* disconnect from inside an emit of the same handler */
+	signal_handler_signal(sd.handler, "other", &params);
+	pthread_join(thread, NULL);
+
+	os_event_destroy(sd.entered);
+	signal_handler_destroy(sd.handler);
+
+	if (sd.still_running)
+		fprintf(stderr, "disconnect returned while another thread "
+				"was still running the callback\n");
+	return !sd.still_running;
+}
+
+int main(void)
+{
+	if (!test_mutual_disconnect())
+		return EXIT_FAILURE;
+	if (!test_disconnect_waits_in_emit())
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}